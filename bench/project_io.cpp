@@ -0,0 +1,128 @@
+// local
+#include "config.hpp"
+#include "node_tree.hpp"
+#include "animation/animation.hpp"
+#include "animation/easings.hpp"
+#include "utils/serialization.hpp"
+
+// builtin
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+
+
+
+static const size_t DEFAULT_NODE_COUNT = 1000;
+static const size_t CHILDREN_PER_GROUP = 25;
+static const size_t KEYS_PER_TRACK = 200;
+static const double LENGTH = 60;
+
+
+
+// a flat hierarchy of groups like a rigged scene, every track animated
+static void make_project(size_t node_count)
+{
+    unload_project();
+
+    config.current_project.header.name = "bench";
+    config.current_project.header.last_access = boost::posix_time::second_clock::local_time();
+    anim_data.length = LENGTH;
+
+    auto& root = node_tree->get_root_node();
+
+    for (size_t i = 0; i < node_count; ++i)
+    {
+        if (i % CHILDREN_PER_GROUP == 0)
+            root.add_child("group", false);
+
+        auto& group = root.get_child(root.get_child_count() - 1);
+        group.add_child("part", false);
+
+        auto& node = group.get_child(group.get_child_count() - 1);
+        node.texture_path = "parts/part_" + std::to_string(i % 64) + ".png";
+
+        for (size_t k = 0; k < KEYS_PER_TRACK; ++k)
+        {
+            auto time = LENGTH * k / KEYS_PER_TRACK;
+            auto easing = easing_ids[k % easing_ids.size()];
+
+            node.keyframe.insert_instant<Track::POSITION>(Vector2Instant{time, glm::vec2(std::rand() % 1000, std::rand() % 1000), easing});
+            node.keyframe.insert_instant<Track::SCALE>(Vector2Instant{time, glm::vec2(1 + k * 0.01, 1 - k * 0.001), easing});
+            node.keyframe.insert_instant<Track::PIVOT>(Vector2Instant{time, glm::vec2(k * 0.5, k * 0.25), easing});
+            node.keyframe.insert_instant<Track::ROTATION>(DoubleInstant{time, std::rand() / (double)RAND_MAX * 360, easing});
+        }
+    }
+}
+
+// compared after loading, so a format that drops or garbles values doesn't look fast
+static double get_checksum()
+{
+    double checksum = 0;
+
+    node_tree->run_on_nodes([&checksum](Node& node)
+    {
+        for (auto& instant: node.keyframe.get_track<Track::POSITION>())
+            checksum += instant.time + instant.vector.x + instant.vector.y + (double)(size_t)instant.easing;
+
+        for (auto& instant: node.keyframe.get_track<Track::ROTATION>())
+            checksum += instant.time + instant.value;
+    });
+
+    return checksum;
+}
+
+static double measure_milliseconds(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+// saves and loads the same project in both formats
+int main(int argc, char** argv)
+{
+    size_t node_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : DEFAULT_NODE_COUNT;
+
+    make_project(node_count);
+    const auto checksum = get_checksum();
+
+    std::printf("%zu nodes, %zu keys per track\n", node_count, KEYS_PER_TRACK);
+
+    for (auto format: {ProjectFormat::TEXT, ProjectFormat::BINARY})
+    {
+        auto path = std::filesystem::temp_directory_path() / "leaf_project_bench.leafproject";
+
+        auto save_start = std::chrono::steady_clock::now();
+        if (auto error = serialize_project(path, format); error.has_value())
+        {
+            std::fprintf(stderr, "%s\n", error->c_str());
+            return 1;
+        }
+        auto save_time = measure_milliseconds(save_start);
+
+        auto size = std::filesystem::file_size(path);
+
+        auto load_start = std::chrono::steady_clock::now();
+        if (auto error = load_project(path); error.has_value())
+        {
+            std::fprintf(stderr, "%s\n", error->c_str());
+            return 1;
+        }
+        auto load_time = measure_milliseconds(load_start);
+
+        // binary projects only read their tracks here, when they're first used
+        auto access_start = std::chrono::steady_clock::now();
+        auto loaded_checksum = get_checksum();
+        auto access_time = measure_milliseconds(access_start);
+
+        std::printf("%-6s  save %9.1f ms  load %9.1f ms  first access %9.1f ms  %8.2f MB%s\n",
+            format == ProjectFormat::TEXT ? "text" : "binary", save_time, load_time, access_time, size / 1e6,
+            loaded_checksum == checksum ? "" : "  (loaded project differs)"
+        );
+
+        std::filesystem::remove(path);
+    }
+
+    return 0;
+}
@@ -0,0 +1,158 @@
+// local
+#include "graphical/graphics.hpp"
+#include "graphical/image.hpp"
+#include "graphical/sprite.hpp"
+#include "graphical/opengl/framebuffer.hpp"
+#include "graphical/opengl/render.hpp"
+#include "graphical/software/framebuffer.hpp"
+#include "graphical/software/render.hpp"
+
+// builtin
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+
+
+static const glm::u64vec2 FRAME_SIZE = {160, 120};
+static const glm::u8vec4 BACKGROUND = {0, 0, 0, 255};
+
+// channel difference still counted as the same pixel, blending rounds differently
+static const int TOLERANCE = 2;
+
+
+// one quad drawn by both backends, "pivot" is in framebuffer coordinates like in render()
+struct ParityCase
+{
+    const char* name;
+
+    glm::vec2 position;
+    glm::vec2 size;
+    double angle;
+    glm::vec2 pivot;
+
+    bool textured;
+    glm::u8vec4 color;
+};
+
+// long and thin so a rotation in the wrong direction misses most of its pixels
+static const std::vector<ParityCase> CASES = {
+    {"unrotated",            {80, 60},     {120, 16}, 0,    {80, 60},     false, {255, 64, 32, 255}},
+    {"half pixel centre",    {80.5, 60.5}, {121, 17}, 0,    {80.5, 60.5}, false, {255, 64, 32, 255}},
+    {"clockwise",            {80, 60},     {120, 16}, 30,   {80, 60},     false, {32, 200, 64, 255}},
+    {"counterclockwise",     {80, 60},     {120, 16}, -30,  {80, 60},     false, {32, 200, 64, 255}},
+    {"right angle",          {80, 60},     {100, 20}, 90,   {80, 60},     false, {64, 64, 255, 255}},
+    {"corner pivot",         {80, 60},     {100, 16}, 45,   {30, 52},     false, {200, 200, 32, 255}},
+    {"pivot off the quad",   {60, 40},     {80, 12},  200,  {90, 70},     false, {200, 32, 200, 255}},
+    {"translucent",          {80, 60},     {120, 40}, 15,   {80, 60},     false, {255, 255, 255, 128}},
+    {"texture",              {80, 60},     {96, 48},  0,    {80, 60},     true,  {255, 255, 255, 255}},
+    {"rotated texture",      {80, 60},     {96, 48},  37,   {56, 36},     true,  {255, 255, 255, 255}},
+    {"half pixel texture",   {80.5, 60.5}, {96, 48},  -120, {80.5, 60.5}, true,  {255, 255, 255, 255}},
+};
+
+
+// a different colour in each quadrant, a flipped or mirrored texture doesn't match
+static Image make_image()
+{
+    const glm::u8vec4 QUADRANTS[4] = {{255, 0, 0, 255}, {0, 255, 0, 255}, {0, 0, 255, 255}, {255, 255, 0, 128}};
+
+    auto image = Image::allocate({8, 4});
+    auto pixels = image.pixels.get();
+
+    for (uint64_t y = 0; y < image.size.y; ++y)
+        for (uint64_t x = 0; x < image.size.x; ++x)
+        {
+            auto color = QUADRANTS[(y >= image.size.y / 2) * 2 + (x >= image.size.x / 2)];
+            auto pixel = pixels + (y * image.size.x + x) * Image::CHANNELS;
+
+            pixel[0] = color.r;
+            pixel[1] = color.g;
+            pixel[2] = color.b;
+            pixel[3] = color.a;
+        }
+
+    return image;
+}
+
+static std::vector<uint8_t> render_opengl(const ParityCase& parity_case, const Texture& texture)
+{
+    auto framebuffer = Framebuffer{FRAME_SIZE.x, FRAME_SIZE.y};
+    framebuffer.clear(BACKGROUND);
+
+    if (parity_case.textured)
+        render_texture(texture.id, parity_case.position, parity_case.size, parity_case.angle, parity_case.pivot, framebuffer);
+    else
+        render_color(parity_case.color, parity_case.position, parity_case.size, parity_case.angle, parity_case.pivot, framebuffer);
+
+    auto pixels = std::vector<uint8_t>(FRAME_SIZE.x * FRAME_SIZE.y * Image::CHANNELS, 0);
+
+    framebuffer.bind();
+    glReadPixels(0, 0, FRAME_SIZE.x, FRAME_SIZE.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    return pixels;
+}
+
+static std::vector<uint8_t> render_software(const ParityCase& parity_case, const Image& image)
+{
+    auto framebuffer = SoftwareFramebuffer{FRAME_SIZE.x, FRAME_SIZE.y};
+    framebuffer.clear(BACKGROUND);
+
+    if (parity_case.textured)
+        render_image(image, parity_case.position, parity_case.size, parity_case.angle, parity_case.pivot, framebuffer);
+    else
+        render_color(parity_case.color, parity_case.position, parity_case.size, parity_case.angle, parity_case.pivot, framebuffer);
+
+    auto pixels = framebuffer.get_pixels();
+    return std::vector<uint8_t>(pixels, pixels + FRAME_SIZE.x * FRAME_SIZE.y * Image::CHANNELS);
+}
+
+
+// draws every case with the opengl and the software renderer and compares the frames,
+// exits with 1 when they differ by more than the pixels an edge may round either way
+int main()
+{
+    graphic_context.init_headless();
+
+    bool passed = true;
+
+    {
+        auto image = make_image();
+        auto texture = Texture{image, 0};
+
+        std::printf("%-20s  %8s  %10s  %8s\n", "case", "max diff", "mismatched", "allowed");
+
+        for (auto& parity_case: CASES)
+        {
+            auto expected = render_opengl(parity_case, texture);
+            auto actual = render_software(parity_case, image);
+
+            int max_difference = 0;
+            uint64_t mismatched = 0;
+
+            for (size_t i = 0; i < expected.size(); i += Image::CHANNELS)
+            {
+                int difference = 0;
+                for (size_t channel = 0; channel < Image::CHANNELS; ++channel)
+                    difference = std::max(difference, std::abs((int)expected[i + channel] - (int)actual[i + channel]));
+
+                max_difference = std::max(max_difference, difference);
+                mismatched += difference > TOLERANCE;
+            }
+
+            // pixel centres lying exactly on an edge, about one per pixel of half the outline
+            auto allowed = (uint64_t)(parity_case.size.x + parity_case.size.y);
+            auto case_passed = mismatched <= allowed;
+
+            std::printf("%-20s  %8d  %10llu  %8llu%s\n", parity_case.name, max_difference,
+                (unsigned long long)mismatched, (unsigned long long)allowed, case_passed ? "" : "  FAILED");
+
+            passed = passed && case_passed;
+        }
+    }
+
+    graphic_context.destroy();
+
+    return passed ? 0 : 1;
+}
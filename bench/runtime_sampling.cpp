@@ -0,0 +1,148 @@
+// local
+#include "leaf_runtime.hpp"
+
+// builtin
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+
+
+namespace format = leaf_runtime::format;
+
+
+static const uint32_t NODES_PER_RIG = 24;
+static const uint32_t KEYS_PER_TRACK = 16;
+static const float LENGTH = 10;
+
+static const size_t DEFAULT_RIG_COUNT = 10000;
+static const size_t FRAME_COUNT = 600;
+static const double FPS = 60;
+
+
+
+// a made up rig shaped like a typical character, every track animated
+static std::vector<uint8_t> make_animation()
+{
+    std::vector<format::Node> nodes(NODES_PER_RIG);
+    std::vector<format::Key> keys;
+    std::string strings;
+
+    for (uint32_t i = 0; i < NODES_PER_RIG; ++i)
+    {
+        auto sprite = "parts/part_" + std::to_string(i) + ".png";
+
+        auto& node = nodes[i];
+        node.sprite_offset = (uint32_t)strings.size();
+        node.sprite_length = (uint32_t)sprite.size();
+        node.scale[0] = 1;
+        node.scale[1] = 1;
+        strings += sprite;
+
+        for (auto& track: node.tracks)
+        {
+            track.first_key = (uint32_t)keys.size();
+            track.key_count = KEYS_PER_TRACK;
+            track.start_time = 0;
+            track.time_range = LENGTH;
+            track.minimum[0] = -100;
+            track.minimum[1] = -100;
+            track.range[0] = 200;
+            track.range[1] = 200;
+
+            for (uint32_t k = 0; k < KEYS_PER_TRACK; ++k)
+            {
+                format::Key key{};
+                key.time = (uint16_t)(k * format::QUANTIZATION_STEPS / (KEYS_PER_TRACK - 1));
+                key.easing = (uint8_t)(k % (uint8_t)leaf_runtime::Easing::COUNT);
+                key.value[0] = (uint16_t)std::rand();
+                key.value[1] = (uint16_t)std::rand();
+                keys.push_back(key);
+            }
+        }
+    }
+
+    format::Header header{};
+    std::memcpy(header.magic, format::MAGIC, sizeof(format::MAGIC));
+    header.version = format::VERSION;
+    header.node_count = NODES_PER_RIG;
+    header.key_count = (uint32_t)keys.size();
+    header.string_bytes = (uint32_t)strings.size();
+    header.length = LENGTH;
+
+    std::vector<uint8_t> output(sizeof(header) + nodes.size() * sizeof(format::Node) + keys.size() * sizeof(format::Key) + strings.size());
+    auto cursor = output.data();
+
+    std::memcpy(cursor, &header, sizeof(header));
+    cursor += sizeof(header);
+    std::memcpy(cursor, nodes.data(), nodes.size() * sizeof(format::Node));
+    cursor += nodes.size() * sizeof(format::Node);
+    std::memcpy(cursor, keys.data(), keys.size() * sizeof(format::Key));
+    cursor += keys.size() * sizeof(format::Key);
+    std::memcpy(cursor, strings.data(), strings.size());
+
+    return output;
+}
+
+
+// samples every rig once per frame, each at its own point of the animation, like a
+// crowd of characters that started playing at different times
+int main(int argc, char** argv)
+{
+    size_t rig_count = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : DEFAULT_RIG_COUNT;
+
+    auto path = std::filesystem::temp_directory_path() / "leaf_runtime_bench.leafanim";
+    {
+        auto bytes = make_animation();
+        std::ofstream{path, std::ios::binary}.write((const char*)bytes.data(), bytes.size());
+    }
+
+    leaf_runtime::Animation animation;
+    if (animation.open(path.string().c_str()) == false)
+    {
+        std::fprintf(stderr, "could not open '%s'\n", path.string().c_str());
+        return 1;
+    }
+
+    std::vector<double> offsets(rig_count);
+    for (size_t i = 0; i < rig_count; ++i)
+        offsets[i] = LENGTH * i / rig_count;
+
+    std::vector<leaf_runtime::Pose> poses(rig_count * animation.get_node_count());
+
+    // read back so the sampling can't be optimized away
+    double checksum = 0;
+    double slowest_frame = 0;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (size_t frame = 0; frame < FRAME_COUNT; ++frame)
+    {
+        auto frame_start = std::chrono::steady_clock::now();
+
+        for (size_t rig = 0; rig < rig_count; ++rig)
+            animation.sample(std::fmod(frame / FPS + offsets[rig], LENGTH), poses.data() + rig * animation.get_node_count());
+
+        slowest_frame = std::max(slowest_frame, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count());
+        checksum += poses[frame % poses.size()].position[0];
+    }
+
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    auto nodes_sampled = (double)FRAME_COUNT * rig_count * animation.get_node_count();
+
+    std::printf("%zu rigs of %u nodes, %zu frames\n", rig_count, animation.get_node_count(), FRAME_COUNT);
+    std::printf("%.3f ms per frame on average, %.3f ms at worst\n", elapsed / FRAME_COUNT, slowest_frame);
+    std::printf("%.1f ns per node (checksum %.1f)\n", elapsed * 1e6 / nodes_sampled, checksum);
+
+    animation.close();
+    std::filesystem::remove(path);
+
+    return 0;
+}
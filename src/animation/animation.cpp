@@ -120,19 +120,24 @@ void transform(P& property, const std::vector<T>& keyframe, double current_time,
 }
 
 
-void animate(Node& node, double time)
+void animate(KeyFrame& keyframe, glm::vec2& position, double& rotation, glm::vec2& scale, glm::vec2& rotation_pivot, double time)
 {
     // position transformation
-    transform(node.position, node.keyframe.get_track<Track::POSITION>(), time, Animation::vector2_transformation);
+    transform(position, keyframe.get_track<Track::POSITION>(), time, Animation::vector2_transformation);
 
     // rotation transformation
-    transform(node.rotation, node.keyframe.get_track<Track::ROTATION>(), time, Animation::double_transformation);
+    transform(rotation, keyframe.get_track<Track::ROTATION>(), time, Animation::double_transformation);
 
     // scale transformation
-    transform(node.scale, node.keyframe.get_track<Track::SCALE>(), time, Animation::vector2_transformation);
+    transform(scale, keyframe.get_track<Track::SCALE>(), time, Animation::vector2_transformation);
 
     //Pivot transformation
-    transform(node.rotation_pivot, node.keyframe.get_track<Track::PIVOT>(), time, Animation::vector2_transformation);
+    transform(rotation_pivot, keyframe.get_track<Track::PIVOT>(), time, Animation::vector2_transformation);
+}
+
+void animate(Node& node, double time)
+{
+    animate(node.keyframe, node.position, node.rotation, node.scale, node.rotation_pivot, time);
 }
 
 
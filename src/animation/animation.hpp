@@ -15,6 +15,9 @@ namespace Animation
 
 void animate(Node& node, double time);
 
+// same as above for properties that aren't stored in a node, like the export's copy of the scene
+void animate(KeyFrame& keyframe, glm::vec2& position, double& rotation, glm::vec2& scale, glm::vec2& rotation_pivot, double time);
+
 class AnimationData
 {
     private:
@@ -34,6 +37,7 @@ class AnimationData
         void call_animate();
 
         friend class boost::serialization::access;
+        friend class BinaryProjectFormat;
         template<class Archive>
         void serialize(Archive & archive, const unsigned int version)
         {
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <cstdint>
 #include <cmath>
 #include <glm/ext/scalar_constants.hpp>
 #include <map>
+#include <optional>
 #include <string>
 
 
@@ -73,4 +77,26 @@ const inline std::map<double (*)(double), std::string> easings_ref
     {&Easings::quint ,"Quint" },
     {&Easings::sine  ,"Sine"  },
     {&Easings::circ  ,"Circ"  },
-};
\ No newline at end of file
+};
+
+// position is the id stored in binary files, so new easings only go at the end
+const inline std::array<double (*)(double), 7> easing_ids
+{
+    &Easings::linear,
+    &Easings::quad,
+    &Easings::cubic,
+    &Easings::quart,
+    &Easings::quint,
+    &Easings::sine,
+    &Easings::circ,
+};
+
+// std::nullopt for easings that aren't in "easing_ids"
+inline std::optional<uint8_t> get_easing_id(double (*easing)(double))
+{
+    auto id = std::find(easing_ids.begin(), easing_ids.end(), easing);
+    if (id == easing_ids.end())
+        return std::nullopt;
+
+    return (uint8_t)(id - easing_ids.begin());
+}
@@ -1,10 +1,17 @@
 
 // builtin
+#include <algorithm>
+#include <mutex>
 #include <optional>
+#include <unordered_set>
+#include <utility>
 
 // local
 #include "keyframe.hpp"
 #include "animation/easings.hpp"
+#include "utils/binary_stream.hpp"
+#include "utils/mapped_file.hpp"
+#include "utils/serialization.hpp"
 
 
 
@@ -42,10 +49,150 @@ DoubleInstant::DoubleInstant(const double _time, const float* _value, const std:
 {}
 
 
+// the keyframes with at least one pending track
+static std::mutex mapped_keyframes_mutex;
+static std::unordered_set<KeyFrame*> mapped_keyframes;
+
+
 KeyFrame::KeyFrame()
 {}
 
+KeyFrame::KeyFrame(const KeyFrame& other)
+:position{other.position},rot_pivot{other.rot_pivot},scale{other.scale},rotation{other.rotation}
+{
+    for (size_t i = 0; i < other.pending.size(); ++i)
+        if (other.pending[i].has_value())
+            this->read_pending_track((Track)i, other.pending[i].value());
+}
+
+KeyFrame::KeyFrame(KeyFrame&& other)
+:position{std::move(other.position)},rot_pivot{std::move(other.rot_pivot)},scale{std::move(other.scale)},rotation{std::move(other.rotation)}
+,pending{std::exchange(other.pending, {})}
+{
+    other.update_mapped();
+    this->update_mapped();
+}
+
+KeyFrame& KeyFrame::operator=(const KeyFrame& other)
+{
+    if (this == &other)
+        return *this;
+
+    this->position = other.position;
+    this->rot_pivot = other.rot_pivot;
+    this->scale = other.scale;
+    this->rotation = other.rotation;
+    this->pending = {};
+
+    for (size_t i = 0; i < other.pending.size(); ++i)
+        if (other.pending[i].has_value())
+            this->read_pending_track((Track)i, other.pending[i].value());
+
+    this->update_mapped();
+    return *this;
+}
+
+KeyFrame& KeyFrame::operator=(KeyFrame&& other)
+{
+    if (this == &other)
+        return *this;
+
+    this->position = std::move(other.position);
+    this->rot_pivot = std::move(other.rot_pivot);
+    this->scale = std::move(other.scale);
+    this->rotation = std::move(other.rotation);
+    this->pending = std::exchange(other.pending, {});
+
+    other.update_mapped();
+    this->update_mapped();
+    return *this;
+}
+
+KeyFrame::~KeyFrame()
+{
+    // most keyframes were never listed, they don't need the lock
+    if (this->has_pending())
+    {
+        std::lock_guard lock{mapped_keyframes_mutex};
+        mapped_keyframes.erase(this);
+    }
+}
+
 KeyFrame::KeyFrame(const Vector2Instant& position, const Vector2Instant& rot_pivot,
                    const Vector2Instant& scale   , const DoubleInstant&  rotation )
 :position{position},rot_pivot{rot_pivot},scale{scale},rotation{rotation}
 {}
+
+
+void KeyFrame::load_pending_track(Track track)
+{
+    auto pending = std::move(this->pending[(size_t)track].value());
+    this->pending[(size_t)track].reset();
+
+    this->read_pending_track(track, pending);
+    this->update_mapped();
+}
+
+void KeyFrame::read_pending_track(Track track, const PendingTrack& pending)
+{
+    // the bounds were checked when the project was opened
+    BinaryReader reader{pending.file->get_data() + pending.offset, pending.file->get_size() - pending.offset};
+
+    switch (track)
+    {
+        case Track::POSITION:
+            BinaryProjectFormat::read_track_columns(reader, pending.count, this->position);
+            break;
+
+        case Track::SCALE:
+            BinaryProjectFormat::read_track_columns(reader, pending.count, this->scale);
+            break;
+
+        case Track::ROTATION:
+            BinaryProjectFormat::read_track_columns(reader, pending.count, this->rotation);
+            break;
+
+        case Track::PIVOT:
+            BinaryProjectFormat::read_track_columns(reader, pending.count, this->rot_pivot);
+            break;
+    }
+
+    // only the easings are left to go wrong, the instants keep none
+    if (auto error = reader.get_error(); error.has_value())
+        warn(error.value());
+}
+
+void KeyFrame::load_pending_tracks()
+{
+    for (size_t i = 0; i < this->pending.size(); ++i)
+        if (this->pending[i].has_value())
+            this->load_pending_track((Track)i);
+}
+
+void KeyFrame::load_all_pending_tracks()
+{
+    // loading takes each keyframe off the list, so it's taken out before
+    std::unordered_set<KeyFrame*> keyframes;
+    {
+        std::lock_guard lock{mapped_keyframes_mutex};
+        std::swap(keyframes, mapped_keyframes);
+    }
+
+    for (auto keyframe: keyframes)
+        keyframe->load_pending_tracks();
+}
+
+bool KeyFrame::has_pending() const
+{
+    return std::any_of(this->pending.begin(), this->pending.end(), [](const auto& track){ return track.has_value(); });
+}
+
+void KeyFrame::update_mapped()
+{
+    std::lock_guard lock{mapped_keyframes_mutex};
+
+    if (this->has_pending())
+        mapped_keyframes.insert(this);
+    else
+        mapped_keyframes.erase(this);
+}
@@ -2,6 +2,8 @@
 
 
 // builtin
+#include <array>
+#include <memory>
 #include <unordered_map>
 #include <vector>
 #include <cstdint>
@@ -83,6 +85,16 @@ struct get_track_type<Track::PIVOT> { using type = Vector2Instant; inline static
 
 
 class KeyFrame;
+class MappedFile;
+
+// a track left in a mapped project file until it's first used, "offset" is where
+// its columns start in the file
+struct PendingTrack
+{
+    std::shared_ptr<const MappedFile> file;
+    uint64_t offset;
+    uint64_t count;
+};
 
 namespace boost::serialization
 {
@@ -97,6 +109,7 @@ class KeyFrame
 {   
     template<class Archive> friend void boost::serialization::serialize(Archive& archive, KeyFrame& node_tree, const unsigned int);
     friend class boost::serialization::access;
+    friend class BinaryProjectFormat;
 
     private:
 
@@ -104,6 +117,9 @@ class KeyFrame
         std::vector<Vector2Instant> rot_pivot;
         std::vector<Vector2Instant> scale;
         std::vector<DoubleInstant> rotation;
+
+        // indexed by Track, the vector of a pending track stays empty until it's read
+        std::array<std::optional<PendingTrack>, 4> pending;
         
     private:
         
@@ -113,6 +129,9 @@ class KeyFrame
         template <Track track>
         std::vector<get_track_type_t<track>>& _get_track()
         {
+            if (this->pending[(size_t)track].has_value())
+                this->load_pending_track(track);
+
             if constexpr (track == Track::POSITION)
                 return this->position;
 
@@ -129,10 +148,33 @@ class KeyFrame
                 panic("invalid track");
         }
 
+        void load_pending_track(Track track);
+        void read_pending_track(Track track, const PendingTrack& pending);
+
+        bool has_pending() const;
+
+        // keeps the keyframes with pending tracks listed, wherever they're kept
+        void update_mapped();
+
     public:
 
         KeyFrame();
 
+        // copies read the pending tracks instead of sharing the mapped file
+        KeyFrame(const KeyFrame& other);
+        KeyFrame(KeyFrame&& other);
+        KeyFrame& operator=(const KeyFrame& other);
+        KeyFrame& operator=(KeyFrame&& other);
+
+        ~KeyFrame();
+
+        // reads the tracks still in the project file, after which it isn't needed anymore
+        void load_pending_tracks();
+
+        // same for every keyframe still reading from a mapped project, including the ones
+        // only kept by the history, so the file can be replaced
+        static void load_all_pending_tracks();
+
         template <Track track, typename track_type = get_track_type_t<track>>
         std::optional<track_type> remove_key(double time)
         {
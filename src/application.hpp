@@ -11,6 +11,7 @@
 
 // local
 #include "config.hpp"
+#include "export/export_queue.hpp"
 #include "graphical/graphics.hpp"
 #include "screens/main_screen.hpp"
 #include "screens/projects_screen.hpp"
@@ -34,6 +35,7 @@ class Application
 
             config = this->load_config();
             graphic_context.init();
+            export_queue.load(get_system_config_directory() / ".leaf_export_queue");
             history = new History{config.max_history_length};
             
             leaf_assert(graphic_context.initialized = true);
@@ -42,6 +44,8 @@ class Application
 
         ~Application()
         {
+            // the exports share textures with the ui context
+            export_queue.shutdown();
             sprite_manager.clear();
             graphic_context.destroy();
 
@@ -0,0 +1,302 @@
+// header
+#include "render_command.hpp"
+
+// local
+#include "config.hpp"
+#include "animation/animation.hpp"
+#include "export/export_progress.hpp"
+#include "export/scene_render.hpp"
+#include "export/video_encoder.hpp"
+#include "export/video_export.hpp"
+#include "graphical/graphics.hpp"
+#include "graphical/sprite.hpp"
+#include "utils/log.hpp"
+#include "utils/serialization.hpp"
+
+// builtin
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <thread>
+
+
+
+static const char* USAGE =
+    "usage: leaf render <project> --out <file> [--fps 60] [--range start:end] [--codec name] [--render-threads n] [--segments seconds] [--software]\n"
+    "    --range         seconds of the animation to render, the whole animation by default\n"
+    "    --codec         one of the export profiles, \"H.264\" by default\n"
+    "    --render-threads frames rendered in parallel, 0 picks it from the core count\n"
+    "    --segments      encodes segments of about this long, running the same command again\n"
+    "                    after an interruption or a crash resumes from the ones already done\n"
+    "    --software      renders on the cpu, without opengl\n";
+
+static const auto PROGRESS_INTERVAL = std::chrono::milliseconds{250};
+
+
+struct RenderArguments
+{
+    std::filesystem::path project;
+    std::string output;
+    uint64_t fps = 60;
+
+    // the whole animation when not given
+    std::optional<std::pair<double, double>> range;
+
+    VideoSettings settings = VideoSettings::get_profiles().front();
+};
+
+
+static volatile std::sig_atomic_t interrupted = 0;
+
+static void on_interrupt(int)
+{
+    interrupted = 1;
+}
+
+
+static std::optional<std::pair<double, double>> parse_range(const std::string& text)
+{
+    auto separator = text.find(':');
+    if (separator == std::string::npos)
+        return std::nullopt;
+
+    try
+    {
+        auto start = std::stod(text.substr(0, separator));
+        auto end = std::stod(text.substr(separator + 1));
+
+        if (start < 0 || end <= start)
+            return std::nullopt;
+
+        return std::pair{start, end};
+    }
+    catch (const std::exception&)
+    {
+        return std::nullopt;
+    }
+}
+
+// std::nullopt after printing what is wrong with them
+static std::optional<RenderArguments> parse_arguments(const std::vector<std::string>& arguments)
+{
+    RenderArguments output;
+    bool has_project = false;
+
+    const auto fail = [](const std::string& message) -> std::optional<RenderArguments>
+    {
+        std::cerr << "leaf render: " << message << '\n' << USAGE;
+        return std::nullopt;
+    };
+
+    for (size_t i = 0; i < arguments.size(); ++i)
+    {
+        auto& argument = arguments[i];
+
+        if (argument.rfind("--", 0) != 0)
+        {
+            if (has_project)
+                return fail(fmt::format("unexpected argument '{}'", argument));
+
+            output.project = argument;
+            has_project = true;
+            continue;
+        }
+
+        if (argument == "--software")
+        {
+            output.settings.software_rendering = true;
+            continue;
+        }
+
+        if (i + 1 == arguments.size())
+            return fail(fmt::format("'{}' needs a value", argument));
+
+        auto& value = arguments[++i];
+
+        if (argument == "--out")
+            output.output = value;
+
+        else if (argument == "--fps")
+        {
+            try
+            {
+                auto fps = std::stoll(value);
+                if (fps <= 0)
+                    return fail("the frame rate must be positive");
+
+                output.fps = fps;
+            }
+            catch (const std::exception&)
+            {
+                return fail(fmt::format("invalid frame rate '{}'", value));
+            }
+        }
+
+        else if (argument == "--range")
+        {
+            output.range = parse_range(value);
+            if (output.range.has_value() == false)
+                return fail(fmt::format("invalid range '{}', expected start:end in seconds", value));
+        }
+
+        else if (argument == "--codec")
+        {
+            auto& profiles = VideoSettings::get_profiles();
+            auto profile = std::find_if(profiles.begin(), profiles.end(), [&](const VideoSettings& settings){ return settings.profile_name == value; });
+
+            if (profile == profiles.end())
+                return fail(fmt::format("unknown codec '{}'", value));
+
+            output.settings = *profile;
+        }
+
+        else if (argument == "--render-threads")
+        {
+            try
+            {
+                output.settings.render_threads = std::max(std::stoi(value), 0);
+            }
+            catch (const std::exception&)
+            {
+                return fail(fmt::format("invalid thread count '{}'", value));
+            }
+        }
+
+        else if (argument == "--segments")
+        {
+            try
+            {
+                output.settings.segment_length = std::stod(value);
+                if (output.settings.segment_length <= 0)
+                    return fail("the segment length must be positive");
+            }
+            catch (const std::exception&)
+            {
+                return fail(fmt::format("invalid segment length '{}'", value));
+            }
+        }
+
+        else
+            return fail(fmt::format("unknown option '{}'", argument));
+    }
+
+    if (has_project == false)
+        return fail("no project given");
+
+    if (output.output.empty())
+        return fail("no output given");
+
+    if (std::filesystem::is_regular_file(output.project) == false)
+        return fail(fmt::format("'{}' is not a file", output.project.string()));
+
+    if (auto error = VideoEncoder::validate(output.output, output.settings); error.has_value())
+        return fail(error.value());
+
+    return output;
+}
+
+
+RenderExitCode run_render_command(const std::vector<std::string>& arguments)
+{
+    auto parsed = parse_arguments(arguments);
+    if (parsed.has_value() == false)
+        return RenderExitCode::INVALID_ARGUMENTS;
+
+    auto& render = parsed.value();
+    const auto render_start = std::chrono::steady_clock::now();
+
+    // before the context, nothing needs to be released when it can't be opened
+    if (auto error = load_project(render.project); error.has_value())
+    {
+        std::cerr << fmt::format("leaf render: {}\n", error.value());
+        return RenderExitCode::INVALID_ARGUMENTS;
+    }
+
+    if (render.settings.software_rendering == false)
+        graphic_context.init_headless();
+
+    auto [start, end] = render.range.value_or(std::pair{0.0, anim_data.length});
+
+    if (end > anim_data.length && start < anim_data.length)
+    {
+        std::cerr << fmt::format("leaf render: the range ends after the animation, rendering up to {}s instead of {}s\n", anim_data.length, end);
+        end = anim_data.length;
+    }
+
+    if (start >= end || start >= anim_data.length)
+    {
+        std::cerr << fmt::format("leaf render: the range is outside of the animation, which is {}s long\n", anim_data.length);
+
+        if (graphic_context.initialized)
+        {
+            sprite_manager.clear();
+            graphic_context.destroy();
+        }
+
+        return RenderExitCode::INVALID_ARGUMENTS;
+    }
+
+    auto progress = std::make_shared<ExportProgress>();
+    auto stop = std::make_shared<std::atomic_bool>(false);
+
+    // contexts and textures are made on this thread, like the ui does before an export
+    std::optional<ExportScene> scene;
+    if (render.settings.software_rendering)
+        scene = collect_software_export_scene();
+    else
+    {
+        graphic_context.reserve_export_contexts(get_render_thread_count(render.settings));
+        scene = collect_export_scene();
+    }
+
+    std::thread export_thread{export_animation, render.output, render.settings, render.fps, start, end - start, std::move(scene.value()), progress, stop};
+
+    auto previous_handler = std::signal(SIGINT, on_interrupt);
+    uint8_t reported = 0;
+
+    while (progress->get_state() == ExportProgress::State::RUNNING)
+    {
+        if (interrupted != 0)
+        {
+            stop->store(true);
+            break;
+        }
+
+        if (auto current = progress->get_percentage(); current != reported)
+        {
+            std::cout << fmt::format("rendering '{}': {}%", render.output, current) << std::endl;
+            reported = current;
+        }
+
+        std::this_thread::sleep_for(PROGRESS_INTERVAL);
+    }
+
+    export_thread.join();
+    std::signal(SIGINT, previous_handler);
+
+    if (graphic_context.initialized)
+    {
+        sprite_manager.clear();
+        graphic_context.destroy();
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - render_start).count();
+
+    if (interrupted != 0)
+    {
+        warn(fmt::format("render of '{}' interrupted after {:.2f}s", render.output, elapsed));
+        return RenderExitCode::INTERRUPTED;
+    }
+
+    // already logged by the export
+    if (progress->get_state() == ExportProgress::State::FAILED)
+        return RenderExitCode::FAILED;
+
+    notice(fmt::format("rendered '{}' ({:.2f}s to {:.2f}s at {} fps) in {:.2f}s", render.output, start, end, render.fps, elapsed));
+    return RenderExitCode::SUCCESS;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+
+// builtin
+#include <string>
+#include <vector>
+
+
+
+// returned by the process, scripts driving batch renders tell failures apart with them
+enum class RenderExitCode: int
+{
+    SUCCESS = 0,
+
+    INVALID_ARGUMENTS = 2,
+    INTERRUPTED = 3,
+
+    // the encoder or the output file failed while rendering
+    FAILED = 4
+};
+
+
+// leaf render <project> --out <file> [--fps 60] [--range start:end] [--codec name] [--render-threads n] [--segments seconds] [--software]
+// renders a project to a video without opening a window, "arguments" are the ones after "render"
+RenderExitCode run_render_command(const std::vector<std::string>& arguments);
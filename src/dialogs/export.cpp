@@ -3,49 +3,64 @@
 #include "export.hpp"
 
 // local
+#include "config.hpp"
 #include "dialogs/file_browser.hpp"
+#include "export/video_encoder.hpp"
 #include "graphical/graphics.hpp"
 #include "utils/asserts.hpp"
-#include "graphical/opengl/framebuffer.hpp"
-#include "graphical/opengl/render.hpp"
-#include "animation/animation.hpp"
 
 // builtin
-#include <atomic>
-#include <chrono>
+#include <algorithm>
+#include <cmath>
 #include <cstddef>
 #include <cstdint>
 #include <filesystem>
 #include <imgui.h>
-#include <memory>
-#include <thread>
-
-// extern
-#include <glm/vec2.hpp>
-#include <boost/dll/runtime_symbol_info.hpp>
-extern "C" {
-    #include <libavcodec/avcodec.h>
-    #include <libavutil/opt.h>
-    #include <libavutil/imgutils.h>
-    #include <libswscale/swscale.h>
-}
+#include <string_view>
 
 
 
 std::optional<std::string> browser_filter(const std::filesystem::path path)
 {
-    if (path.extension() != ".mp4")
-        return "only \".mp4\" is supported";
+    if (path.extension() != ".mp4" && path.extension() != ".mkv" && path.extension() != ".mov" && path.extension() != ".webp")
+        return "only \".mp4\", \".mkv\", \".mov\" and \".webp\" are supported";
     else
         return std::nullopt;
 }
 
+std::optional<std::string> atlas_filter(const std::filesystem::path path)
+{
+    if (path.extension() != ".png")
+        return "only \".png\" is supported";
+    else
+        return std::nullopt;
+}
 
-ExportDialog::ExportDialog(double _animation_length): animation_length(_animation_length)
+std::optional<std::string> gif_filter(const std::filesystem::path path)
+{
+    if (path.extension() != ".gif")
+        return "only \".gif\" is supported";
+    else
+        return std::nullopt;
+}
+
+std::optional<std::string> runtime_filter(const std::filesystem::path path)
+{
+    if (path.extension() != ".leafanim")
+        return "only \".leafanim\" is supported";
+    else
+        return std::nullopt;
+}
+
+
+ExportDialog::ExportDialog(double _animation_length): animation_length(_animation_length), end_time(_animation_length)
 {
     this->fps = 60;
     strcpy((char*)this->path.data(), (char*)std::filesystem::current_path().c_str());
 
+    auto camera_area = get_camera_area();
+    this->resolution = {(int)camera_area.x, (int)camera_area.y};
+
     ImGui::OpenPopup("Export");
 }
 
@@ -56,32 +71,37 @@ bool ExportDialog::run()
     leaf_assert(ImGui::BeginPopupModal("Export", nullptr, ImGuiWindowFlags_AlwaysAutoResize));
     
 
-    if (this->export_process.has_value())
-    {
-        if (auto progress = this->export_process->get_export_progress(); progress.has_value())
-        {
-            ImGui::ProgressBar((float)progress.value() / 100, ImVec2(0.0f, 0.0f));
-            
-            if (ImGui::Button("cancel"))
-            {
-                this->export_process->stop();
-                close = true;
-            }
-        }
-        else
-        {
-            ImGui::Text("export completed");
-            if (ImGui::Button("ok"))
-                close = true;
-        }
-    }
+    if (this->job_id.has_value())
+        this->render_progress(close);
     else
     {
-        ImGui::InputText("output path", this->path.data(), this->path.size());
+        int output = (int)this->output;
+        ImGui::RadioButton("video", &output, (int)Output::VIDEO);
+        ImGui::SameLine();
+        ImGui::RadioButton("image sequence", &output, (int)Output::IMAGE_SEQUENCE);
+        ImGui::SameLine();
+        ImGui::RadioButton("gif", &output, (int)Output::GIF);
+        ImGui::SameLine();
+        ImGui::RadioButton("spritesheet", &output, (int)Output::SPRITESHEET);
+        ImGui::SameLine();
+        ImGui::RadioButton("runtime", &output, (int)Output::RUNTIME);
+        this->output = (Output)output;
+
+        ImGui::InputText(this->output == Output::IMAGE_SEQUENCE ? "output folder" : "output path", this->path.data(), this->path.size());
         ImGui::SameLine();
         if (ImGui::Button("select path"))
         {
-            this->file_browser = FileBrowser{"select output path", FileBrowser::Type::File, browser_filter};
+            if (this->output == Output::VIDEO)
+                this->file_browser = FileBrowser{"select output path", FileBrowser::Type::File, browser_filter};
+            else if (this->output == Output::SPRITESHEET)
+                this->file_browser = FileBrowser{"select output path", FileBrowser::Type::File, atlas_filter};
+            else if (this->output == Output::RUNTIME)
+                this->file_browser = FileBrowser{"select output path", FileBrowser::Type::File, runtime_filter};
+            else if (this->output == Output::GIF)
+                this->file_browser = FileBrowser{"select output path", FileBrowser::Type::File, gif_filter};
+            else
+                this->file_browser = FileBrowser{"select output folder", FileBrowser::Type::Folder};
+
             this->file_browser->open(FileBrowser::State::default_with_current_path());
         }
 
@@ -91,7 +111,39 @@ bool ExportDialog::run()
                 strcpy(this->path.data(), output.value().data());
         }
 
-        ImGui::InputInt("fps", &this->fps);
+        // the runtime keeps the keyframes instead of rendering frames
+        if (this->output != Output::RUNTIME)
+        {
+            ImGui::InputInt("fps", &this->fps);
+            this->fps = std::max(this->fps, 1);
+
+            ImGui::InputInt2("resolution", this->resolution.data());
+            this->resolution = {std::max(this->resolution[0], 1), std::max(this->resolution[1], 1)};
+
+            ImGui::InputDouble("start (s)", &this->start_time, 0.5);
+            ImGui::InputDouble("end (s)", &this->end_time, 0.5);
+            this->start_time = std::clamp(this->start_time, 0.0, this->animation_length);
+            this->end_time = std::clamp(this->end_time, 0.0, this->animation_length);
+        }
+
+        if (this->output == Output::VIDEO)
+            this->render_video_settings();
+        else if (this->output == Output::SPRITESHEET)
+            this->render_spritesheet_settings();
+        else if (this->output == Output::IMAGE_SEQUENCE)
+            this->render_image_sequence_settings();
+        else if (this->output == Output::GIF)
+            this->render_gif_settings();
+        else
+            ImGui::TextDisabled("plays with the leaf_runtime library, sprites are referenced next to the file");
+
+        if (this->output != Output::RUNTIME)
+            ImGui::Checkbox("render on the cpu", &this->settings.software_rendering);
+
+        // checked up front, errors while exporting are only known once frames are rendered
+        auto error = this->validate();
+        if (error.has_value())
+            ImGui::TextColored({1.f, 0.4f, 0.4f, 1.f}, "%s", error->c_str());
 
         if (ImGui::Button("cancel"))
         {
@@ -100,9 +152,21 @@ bool ExportDialog::run()
         }
 
         ImGui::SameLine();
-        
+
+        ImGui::BeginDisabled(error.has_value());
         if (ImGui::Button("export"))
-            this->export_process = ExportProcess{this->path.data(), (uint64_t)this->fps, this->animation_length};
+            this->job_id = export_queue.add(this->make_job(), true);
+
+        ImGui::SameLine();
+
+        // runs after the jobs already queued, the dialog can be closed meanwhile
+        if (ImGui::Button("add to queue"))
+        {
+            export_queue.add(this->make_job());
+            ImGui::CloseCurrentPopup();
+            close = true;
+        }
+        ImGui::EndDisabled();
     }
     
     ImGui::EndPopup();
@@ -111,201 +175,208 @@ bool ExportDialog::run()
 
 
 
-ExportProcess::ExportProcess(std::string path, uint64_t fps, double animation_length): progress_counter(std::make_shared<std::atomic_uint8_t>(0)), _stop(std::make_shared<std::atomic_bool>(false))
+void ExportDialog::render_video_settings()
 {
-    std::thread{export_animation, path, fps, animation_length, this->progress_counter, this->_stop}.detach();
-}
+    if (ImGui::BeginCombo("codec", this->settings.profile_name.c_str()))
+    {
+        for (auto& profile: VideoSettings::get_profiles())
+            if (ImGui::Selectable(profile.profile_name.c_str(), profile.profile_name == this->settings.profile_name))
+                this->settings = profile;
 
-std::optional<uint8_t> ExportProcess::get_export_progress()
-{
-    auto progress = this->progress_counter->load();
+        ImGui::EndCombo();
+    }
 
-    if (progress >= 100)
-        return std::nullopt;
+    if (this->settings.preset.empty() == false && ImGui::BeginCombo("preset", this->settings.preset.c_str()))
+    {
+        for (auto& preset: VideoSettings::get_presets())
+            if (ImGui::Selectable(preset.c_str(), preset == this->settings.preset))
+                this->settings.preset = preset;
 
-    return progress;
-}
+        ImGui::EndCombo();
+    }
 
-void ExportProcess::stop()
-{
-    this->_stop->store(true);
-}
+    bool constant_quality = this->settings.quality.has_value();
+    if (ImGui::Checkbox("constant quality", &constant_quality))
+        this->settings.quality = constant_quality ? std::optional<int>{23} : std::nullopt;
 
+    if (this->settings.quality.has_value())
+    {
+        // lower is better, 0 is lossless on x264
+        ImGui::SliderInt("quality (crf)", &this->settings.quality.value(), 0, 63);
+    }
+    else
+    {
+        int bit_rate = this->settings.bit_rate / 1000;
+        if (ImGui::InputInt("bitrate (kbit/s)", &bit_rate, 500))
+            this->settings.bit_rate = (int64_t)std::max(bit_rate, 0) * 1000;
+    }
 
+    ImGui::InputInt("keyframe interval (0 = 2s)", &this->settings.gop_size);
+    this->settings.gop_size = std::max(this->settings.gop_size, 0);
 
+    ImGui::InputInt("b-frames", &this->settings.max_b_frames);
+    this->settings.max_b_frames = std::clamp(this->settings.max_b_frames, 0, 16);
 
-void encode(AVCodecContext* enc_ctx, AVFrame* frame, AVPacket* pkt, FILE* output_file)
-{
-    int ret;
+    ImGui::InputInt("threads (0 = all cores)", &this->settings.thread_count);
+    this->settings.thread_count = std::max(this->settings.thread_count, 0);
 
-    ret = avcodec_send_frame(enc_ctx, frame);
-    leaf_runtime_assert(ret >= 0);
+    ImGui::Checkbox("slice threading", &this->settings.slice_threading);
 
-    while (ret >= 0)
-    {
-        ret = avcodec_receive_packet(enc_ctx, pkt);
-        
-        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
-            return;
-        leaf_runtime_assert(ret >= 0);
-
-        fwrite(pkt->data, 1, pkt->size, output_file);
-        av_packet_unref(pkt);
-    }
+    ImGui::InputInt("render threads (0 = auto)", &this->settings.render_threads);
+    this->settings.render_threads = std::max(this->settings.render_threads, 0);
+
+    ImGui::InputDouble("segments (s, 0 = one piece)", &this->settings.segment_length, 5);
+    this->settings.segment_length = std::max(this->settings.segment_length, 0.0);
+
+    if (this->settings.segment_length > 0)
+        ImGui::TextDisabled("a stopped export resumes from the segments already encoded");
 }
 
-void render(Framebuffer& framebuffer, double time)
+void ExportDialog::render_image_sequence_settings()
 {
-    const auto draw_node = [&framebuffer, time](Node& node)
+    if (ImGui::BeginCombo("format", ImageSequenceSettings::get_extension(this->image_format)))
     {
-        animate(node, time);
-
-        auto& sprite = sprite_manager.get_sprite(node.texture_path.value());
-        render_sprite(
-            sprite,
-            node.position,
-            (glm::dvec2)sprite.size * (glm::dvec2)node.scale,
-            glm::degrees(node.rotation),
-            {node.rotation_pivot[0] + node.position.x, node.rotation_pivot[1] + node.position.y},
-            framebuffer
-        );
-    };
-
-    framebuffer.clear({255, 255, 255, 255});
-
-    node_tree->run_on_nodes_ordered_reverse([&](Node& node)
-    {
-        if (node.texture_path.has_value() == false)
-            return;
+        for (auto format: {ImageFormat::PNG, ImageFormat::TGA, ImageFormat::PPM})
+            if (ImGui::Selectable(ImageSequenceSettings::get_extension(format), format == this->image_format))
+                this->image_format = format;
 
-        if (node.visible == false)
-            return;
+        ImGui::EndCombo();
+    }
 
-        draw_node(node);
-    });
-}
+    if (this->image_format != ImageFormat::PNG)
+        ImGui::TextDisabled("uncompressed, quick to write but large");
 
+    ImGui::Checkbox("only write changed frames", &this->incremental);
+}
 
-void export_animation(std::string path, uint64_t fps, double length, std::shared_ptr<std::atomic_uint8_t> progress_counter, std::shared_ptr<std::atomic_bool> stop)
+void ExportDialog::render_spritesheet_settings()
 {
-    const std::string codec_name = "mpeg2video";
-    const AVCodec* codec;
-    AVCodecContext* codec_context = nullptr;
-    auto camera_size = (glm::u64vec2)get_camera_area();
-    FILE* output_file;
-    AVFrame* frame;
-    AVPacket* pkt;
-    uint8_t endcode[] = { 0, 0, 1, 0xb7 };
-
-    codec = avcodec_find_encoder_by_name(codec_name.c_str());
-    leaf_runtime_assert(codec != nullptr);
-
-    codec_context = avcodec_alloc_context3(codec);
-    leaf_runtime_assert(codec_context != nullptr);
-
-    pkt = av_packet_alloc();
-    leaf_runtime_assert(pkt != nullptr);
-    
-
-    codec_context->bit_rate = 400000;
-    // resolution must be a multiple of two
-    codec_context->width = camera_size.x + ((camera_size.x % 2 == 0) ? 0 : 1);
-    codec_context->height = camera_size.y + ((camera_size.y % 2 == 0) ? 0 : 1);
-    codec_context->time_base = AVRational{1, (int)fps};
-    codec_context->framerate = AVRational{(int)fps, 1};
-    codec_context->gop_size = 10;
-    codec_context->max_b_frames = 1;
-    codec_context->pix_fmt = AV_PIX_FMT_YUV420P;
+    ImGui::InputInt("padding (px)", &this->padding);
+    this->padding = std::clamp(this->padding, 0, 64);
 
-    if (codec->id == AV_CODEC_ID_H264)
-        av_opt_set(codec_context->priv_data, "preset", "slow", 0);
+    ImGui::TextDisabled("the frames are listed in a \".json\" next to the atlas");
+}
 
-    leaf_runtime_assert(avcodec_open2(codec_context, codec, NULL) >= 0);
+void ExportDialog::render_gif_settings()
+{
+    ImGui::Checkbox("dithering", &this->dithering);
 
-    output_file = fopen((path + ".tmp").c_str(), "wb");
-    leaf_runtime_assert(output_file != nullptr);
+    if (this->fps > 50)
+        ImGui::TextDisabled("gifs are limited to 50 fps, viewers slow down faster ones");
+}
 
-    frame = av_frame_alloc();
-    leaf_runtime_assert(frame != nullptr);
+void ExportDialog::render_progress(bool& close)
+{
+    auto job = export_queue.get_job(this->job_id.value());
 
-    frame->format = codec_context->pix_fmt;
-    frame->width  = codec_context->width;
-    frame->height = codec_context->height;
+    if (job.has_value() == false || job->state == ExportJob::State::CANCELED)
+    {
+        close = true;
+        return;
+    }
 
-    leaf_runtime_assert(av_frame_get_buffer(frame, 0) >= 0);
+    if (job->state == ExportJob::State::RUNNING || job->state == ExportJob::State::QUEUED)
+    {
+        ImGui::ProgressBar((float)job->percentage / 100, ImVec2(0.0f, 0.0f));
 
-    
-    
-    
-    graphic_context.make_current_export_context();
-    auto framebuffer = Framebuffer{camera_size.x, camera_size.y};
-    uint8_t* pixels = new uint8_t[camera_size.x * camera_size.y * 4];
-    memset(pixels, 0, camera_size.x * camera_size.y * 4);
-    SwsContext* sws_context = nullptr;
+        if (job->remaining_seconds.has_value())
+            ImGui::Text("%.1f frames/s, about %.0fs left", job->frames_per_second, std::ceil(job->remaining_seconds.value()));
 
-    for (uint64_t i = 0; i < (length / (1.f / fps)); ++i)
-    {
-        if (stop->load() == true)
+        if (ImGui::Button("cancel"))
         {
-            delete[] pixels;
-            fclose(output_file);
-            avcodec_free_context(&codec_context);
-            av_frame_free(&frame);
-            av_packet_free(&pkt);
-            return;
+            export_queue.cancel(job->id);
+            close = true;
         }
 
-        progress_counter->store((uint8_t)(((double)i / (double)(length / (1.f / fps))) * 100));
+        return;
+    }
 
-        render(framebuffer, (1.f / fps) * i);
+    if (job->state == ExportJob::State::FAILED)
+        ImGui::TextColored({1.f, 0.4f, 0.4f, 1.f}, "export failed: %s", job->error.c_str());
+    else
+        ImGui::Text("export completed");
 
-        framebuffer.bind();
-        glReadPixels(0, 0, camera_size.x, camera_size.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
-        
+    if (ImGui::Button("ok"))
+    {
+        export_queue.remove(job->id);
+        close = true;
+    }
+}
 
-        sws_context = sws_getCachedContext(sws_context, 
-            frame->width, frame->height, AV_PIX_FMT_RGBA,
-            frame->width, frame->height, AV_PIX_FMT_YUV420P,
-            SWS_BICUBIC, NULL, NULL, NULL
-        );
+ExportJob ExportDialog::make_job()
+{
+    ExportJob job;
+    job.size = {(uint64_t)this->resolution[0], (uint64_t)this->resolution[1]};
 
-        int linesize = camera_size.x * 4;
-        sws_scale(sws_context, &pixels, &linesize, 0, frame->height, frame->data, frame->linesize);
+    if (this->output == Output::VIDEO)
+        job.settings = VideoExportJob{this->path.data(), this->settings, (uint64_t)this->fps, this->start_time, this->end_time - this->start_time};
 
-        frame->pts = i;
-        leaf_runtime_assert(av_frame_make_writable(frame) >= 0);
-        encode(codec_context, frame, pkt, output_file);
+    else if (this->output == Output::SPRITESHEET)
+    {
+        SpritesheetSettings spritesheet;
+        spritesheet.path = this->path.data();
+        spritesheet.fps = this->fps;
+        spritesheet.start_time = this->start_time;
+        spritesheet.end_time = this->end_time;
+        spritesheet.padding = this->padding;
+        spritesheet.software_rendering = this->settings.software_rendering;
+
+        job.settings = spritesheet;
     }
-    progress_counter->store(100);
+    else if (this->output == Output::RUNTIME)
+        job.settings = RuntimeExportSettings{this->path.data(), this->animation_length};
 
+    else if (this->output == Output::GIF)
+    {
+        GifSettings gif;
+        gif.path = this->path.data();
+        gif.fps = this->fps;
+        gif.start_time = this->start_time;
+        gif.end_time = this->end_time;
+        gif.dithering = this->dithering;
+        gif.software_rendering = this->settings.software_rendering;
+
+        job.settings = gif;
+    }
+    else
+    {
+        ImageSequenceSettings sequence;
+        sequence.directory = this->path.data();
+        sequence.format = this->image_format;
+        sequence.fps = this->fps;
+        sequence.start_time = this->start_time;
+        sequence.end_time = this->end_time;
+        sequence.software_rendering = this->settings.software_rendering;
+        sequence.incremental = this->incremental;
+
+        job.settings = sequence;
+    }
 
+    return job;
+}
 
-    encode(codec_context, nullptr, pkt, output_file);
+std::optional<std::string> ExportDialog::validate()
+{
+    if (this->output == Output::RUNTIME)
+        return runtime_filter(this->path.data());
 
-    if (codec->id == AV_CODEC_ID_MPEG1VIDEO || codec->id == AV_CODEC_ID_MPEG2VIDEO)
-        fwrite(endcode, 1, sizeof(endcode), output_file);
-    fclose(output_file);
+    if (this->end_time <= this->start_time)
+        return "the end must come after the start";
 
-    delete[] pixels;
-    avcodec_free_context(&codec_context);
-    av_frame_free(&frame);
-    av_packet_free(&pkt);
+    if (this->output == Output::VIDEO)
+        return VideoEncoder::validate(this->path.data(), this->settings);
 
+    if (this->output == Output::SPRITESHEET)
+        return atlas_filter(this->path.data());
 
-    std::string ffmpeg_path;
+    if (this->output == Output::GIF)
+        return gif_filter(this->path.data());
 
-    #if defined(_WIN32)
-        ffmpeg_path = boost::dll::program_location().parent_path().string() + ".\\ffmpeg.exe";
-    #elif defined(__linux__)
-        ffmpeg_path = boost::dll::program_location().parent_path().string() + "/ffmpeg";
-    #else
-        #error "unsupported plataform"
-    #endif
+    if (std::string_view{this->path.data()}.empty())
+        return "no output folder";
 
-    if (std::filesystem::exists(path))
-        std::filesystem::remove(path);
+    if (auto path = std::filesystem::path{this->path.data()}; std::filesystem::exists(path) && std::filesystem::is_directory(path) == false)
+        return fmt::format("'{}' is not a folder", path.string());
 
-    auto command = fmt::format("{} -i \"{}.tmp\" -c:v copy -f mp4 \"{}\"", ffmpeg_path, path, path);
-    system(command.c_str());
-    std::filesystem::remove(path + ".tmp");
+    return std::nullopt;
 }
@@ -4,6 +4,7 @@
 
 // local
 #include "dialogs/file_browser.hpp"
+#include "export/export_queue.hpp"
 #include "graphical/graphics.hpp"
 #include "utils/asserts.hpp"
 #include "node_tree.hpp"
@@ -11,45 +12,57 @@
 // builtin
 #include <array>
 #include <cstdint>
-#include <atomic>
+#include <optional>
 
 
 
-class ExportProcess
-{
-
-    private: 
-    
-        std::shared_ptr<std::atomic<uint8_t>> progress_counter;
-        std::shared_ptr<std::atomic_bool> _stop;
-
-    public:
-
-        ExportProcess(std::string path, uint64_t fps, double animation_length);
-
-        std::optional<uint8_t> get_export_progress();
-        void stop();
-
-};
-
-
 class ExportDialog
 {
 
     private:
 
-        std::optional<ExportProcess> export_process = std::nullopt;
+        enum class Output
+        {
+            VIDEO,
+            IMAGE_SEQUENCE,
+            SPRITESHEET,
+            RUNTIME,
+            GIF
+        };
+
+        // the export started from this dialog, it runs in "export_queue"
+        std::optional<uint64_t> job_id = std::nullopt;
         std::optional<FileBrowser> file_browser = std::nullopt;
         double animation_length;
         std::array<char, 6666> path;
         int32_t fps;
+        double start_time = 0;
+        double end_time;
+        std::array<int, 2> resolution;
+
+        Output output = Output::VIDEO;
+        VideoSettings settings = VideoSettings::get_profiles().front();
+        ImageFormat image_format = ImageFormat::PNG;
+        bool incremental = true;
+        int padding = 2;
+        bool dithering = true;
 
     public:
 
         ExportDialog(double _animation_length);
         bool run();
 
-};
+    private:
+
+        void render_video_settings();
+        void render_image_sequence_settings();
+        void render_spritesheet_settings();
+        void render_gif_settings();
+        void render_progress(bool& close);
 
+        ExportJob make_job();
 
-void export_animation(std::string path, uint64_t fps, double length, std::shared_ptr<std::atomic_uint8_t> progress_counter, std::shared_ptr<std::atomic_bool> stop);
\ No newline at end of file
+        // why the export can't start yet, if it can't
+        std::optional<std::string> validate();
+
+};
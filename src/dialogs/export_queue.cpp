@@ -0,0 +1,112 @@
+// header
+#include "export_queue.hpp"
+
+// local
+#include "export/export_queue.hpp"
+
+// extern
+#include <fmt/core.h>
+#include <imgui.h>
+
+// builtin
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+
+
+static const char* get_state_name(ExportJob::State state)
+{
+    switch (state)
+    {
+        case ExportJob::State::QUEUED: return "queued";
+        case ExportJob::State::RUNNING: return "running";
+        case ExportJob::State::FINISHED: return "done";
+        case ExportJob::State::FAILED: return "failed";
+        case ExportJob::State::CANCELED: return "canceled";
+    }
+
+    return "";
+}
+
+
+void ExportQueueWindow::open()
+{
+    this->visible = true;
+}
+
+void ExportQueueWindow::render()
+{
+    if (this->visible == false)
+        return;
+
+    ImGui::SetNextWindowSize({520, 320}, ImGuiCond_FirstUseEver);
+    if (ImGui::Begin("Export queue", &this->visible) == false)
+    {
+        ImGui::End();
+        return;
+    }
+
+    int concurrency = export_queue.get_concurrency();
+    ImGui::SetNextItemWidth(120);
+    if (ImGui::InputInt("exports at once", &concurrency))
+        export_queue.set_concurrency(std::max(concurrency, 1));
+
+    ImGui::SameLine();
+    if (ImGui::Button("clear completed"))
+        export_queue.remove_completed();
+
+    ImGui::Separator();
+
+    auto jobs = export_queue.get_jobs();
+    if (jobs.empty())
+        ImGui::TextDisabled("no exports, add them from the export dialog");
+
+    for (auto& job: jobs)
+    {
+        ImGui::PushID((int)job.id);
+
+        ImGui::Text("%s", job.name.c_str());
+        ImGui::SameLine();
+        ImGui::TextDisabled("%s, %s", job.description.c_str(), get_state_name(job.state));
+
+        if (job.state == ExportJob::State::RUNNING)
+        {
+            auto overlay = fmt::format("{}/{} frames", job.done_frames, job.frame_count);
+            ImGui::ProgressBar((float)job.percentage / 100, {-1, 0}, overlay.c_str());
+
+            if (job.remaining_seconds.has_value())
+                ImGui::Text("%.1f frames/s, %s left", job.frames_per_second, ExportQueueWindow::format_duration(job.remaining_seconds.value()).c_str());
+        }
+
+        if (job.waiting_for_project)
+            ImGui::TextDisabled("waits for its project to be opened");
+
+        if (job.state == ExportJob::State::FAILED)
+            ImGui::TextColored({1.f, 0.4f, 0.4f, 1.f}, "%s", job.error.c_str());
+
+        if (job.state == ExportJob::State::QUEUED || job.state == ExportJob::State::RUNNING)
+        {
+            if (ImGui::SmallButton("cancel"))
+                export_queue.cancel(job.id);
+        }
+        else if (ImGui::SmallButton("remove"))
+            export_queue.remove(job.id);
+
+        ImGui::Separator();
+        ImGui::PopID();
+    }
+
+    ImGui::End();
+}
+
+
+std::string ExportQueueWindow::format_duration(double seconds)
+{
+    auto total = (uint64_t)std::ceil(seconds);
+
+    if (total < 60)
+        return fmt::format("{}s", total);
+
+    return fmt::format("{}m {:02}s", total / 60, total % 60);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+
+// builtin
+#include <string>
+
+
+
+// a window listing the jobs of "export_queue", it stays open while the editor is used
+class ExportQueueWindow
+{
+
+    private:
+
+        bool visible = false;
+
+    public:
+
+        void open();
+        void render();
+
+    private:
+
+        static std::string format_duration(double seconds);
+
+};
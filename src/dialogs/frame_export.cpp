@@ -6,9 +6,11 @@
 
 // local
 #include "node_tree.hpp"
+#include "export/image_sequence.hpp"
 #include "graphical/sprite.hpp"
 #include "graphical/opengl/framebuffer.hpp"
 #include "graphical/opengl/render.hpp"
+#include "utils/thread_pool.hpp"
 
 // extern
 #include <glm/vec2.hpp>
@@ -78,7 +80,7 @@ void render_current_frame(Framebuffer& framebuffer)
         if (node.visible == false)
             return;
 
-        auto& sprite = sprite_manager.get_sprite(node.texture_path.value());
+        auto& sprite = sprite_manager.get_ready_sprite(node.texture_path.value());
         render_sprite(
                 sprite,
                 node.position,
@@ -103,7 +105,12 @@ void FrameExportDialog::export_frame(const std::string& path)
     
     framebuffer.bind();
     glReadPixels(0, 0, frame_size.x, frame_size.y, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    auto err = stbi_write_png(path.c_str(), frame_size.x, frame_size.y, 4, pixels.data(), 0);
-    leaf_assert(err != 0);
+    // compressing a large frame takes long enough to drop ui frames
+    thread_pool.submit([path, frame_size, pixels = std::move(pixels)]()
+    {
+        if (write_image(path, ImageFormat::PNG, frame_size, pixels.data()) == false)
+            warn(fmt::format("could not write '{}'", path));
+    });
 }
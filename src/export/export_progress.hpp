@@ -0,0 +1,109 @@
+#pragma once
+
+
+// local
+#include "utils/log.hpp"
+
+// builtin
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+
+
+// shared by an export thread, which counts the frames it is done with, and whoever
+// shows its progress. frames are counted instead of a percentage so the ui can show
+// a rate and an estimate. the state leaves RUNNING once, when the export is done
+class ExportProgress
+{
+    public:
+
+        enum class State
+        {
+            RUNNING,
+            FINISHED,
+            FAILED
+        };
+
+    private:
+
+        std::atomic_uint64_t done_frames = 0;
+        std::atomic_uint64_t frame_count = 0;
+        std::atomic<State> state = State::RUNNING;
+
+        mutable std::mutex mutex;
+        std::string error;
+
+    public:
+
+        void set_frame_count(uint64_t count)
+        {
+            this->frame_count.store(count);
+        }
+
+        void set_done_frames(uint64_t count)
+        {
+            this->done_frames.store(count);
+        }
+
+        void add_done_frames(uint64_t count = 1)
+        {
+            this->done_frames.fetch_add(count);
+        }
+
+        void finish()
+        {
+            this->done_frames.store(this->frame_count.load());
+            this->state.store(State::FINISHED);
+        }
+
+        // also logged, exports keep running on their own thread and have no one else to tell
+        void fail(const std::string& message)
+        {
+            warn(message);
+
+            {
+                std::lock_guard lock{this->mutex};
+                this->error = message;
+            }
+
+            this->state.store(State::FAILED);
+        }
+
+
+        State get_state() const
+        {
+            return this->state.load();
+        }
+
+        uint64_t get_done_frames() const
+        {
+            return this->done_frames.load();
+        }
+
+        uint64_t get_frame_count() const
+        {
+            return this->frame_count.load();
+        }
+
+        // 100 is only reached once the output is complete
+        uint8_t get_percentage() const
+        {
+            if (this->state.load() == State::FINISHED)
+                return 100;
+
+            auto count = this->frame_count.load();
+            if (count == 0)
+                return 0;
+
+            return (uint8_t)std::min<double>((double)this->done_frames.load() / count * 100, 99);
+        }
+
+        std::string get_error() const
+        {
+            std::lock_guard lock{this->mutex};
+            return this->error;
+        }
+};
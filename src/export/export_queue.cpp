@@ -0,0 +1,669 @@
+// header
+#include "export_queue.hpp"
+
+// local
+#include "config.hpp"
+#include "utils/file_io.hpp"
+#include "utils/log.hpp"
+
+// extern
+#include <nlohmann/json.hpp>
+
+// builtin
+#include <algorithm>
+
+
+
+static const int QUEUE_FILE_VERSION = 1;
+
+
+NLOHMANN_JSON_SERIALIZE_ENUM(ImageFormat, {
+    {ImageFormat::PNG, "png"},
+    {ImageFormat::TGA, "tga"},
+    {ImageFormat::PPM, "ppm"},
+})
+
+NLOHMANN_JSON_SERIALIZE_ENUM(ExportJob::State, {
+    {ExportJob::State::QUEUED, "queued"},
+    {ExportJob::State::RUNNING, "running"},
+    {ExportJob::State::FINISHED, "finished"},
+    {ExportJob::State::FAILED, "failed"},
+    {ExportJob::State::CANCELED, "canceled"},
+})
+
+
+static nlohmann::json video_to_json(const VideoExportJob& job)
+{
+    auto& settings = job.settings;
+
+    return {
+        {"path", job.path},
+        {"fps", job.fps},
+        {"start_time", job.start_time},
+        {"length", job.length},
+        {"profile_name", settings.profile_name},
+        {"encoders", settings.encoders},
+        {"pixel_format", (int)settings.pixel_format},
+        {"quality", settings.quality.has_value() ? nlohmann::json(settings.quality.value()) : nlohmann::json(nullptr)},
+        {"bit_rate", settings.bit_rate},
+        {"gop_size", settings.gop_size},
+        {"max_b_frames", settings.max_b_frames},
+        {"thread_count", settings.thread_count},
+        {"slice_threading", settings.slice_threading},
+        {"render_threads", settings.render_threads},
+        {"software_rendering", settings.software_rendering},
+        {"segment_length", settings.segment_length},
+        {"preset", settings.preset},
+        {"options", settings.options},
+        {"muxer_options", settings.muxer_options}
+    };
+}
+
+static VideoExportJob video_from_json(const nlohmann::json& json)
+{
+    VideoExportJob job;
+    auto& settings = job.settings;
+
+    job.path = json.at("path").get<std::string>();
+    job.fps = json.at("fps").get<uint64_t>();
+    job.start_time = json.at("start_time").get<double>();
+    job.length = json.at("length").get<double>();
+
+    settings.profile_name = json.at("profile_name").get<std::string>();
+    settings.encoders = json.at("encoders").get<std::vector<std::string>>();
+    settings.pixel_format = (AVPixelFormat)json.at("pixel_format").get<int>();
+    settings.quality = json.at("quality").is_null() ? std::nullopt : std::optional<int>{json.at("quality").get<int>()};
+    settings.bit_rate = json.value("bit_rate", settings.bit_rate);
+    settings.gop_size = json.value("gop_size", settings.gop_size);
+    settings.max_b_frames = json.value("max_b_frames", settings.max_b_frames);
+    settings.thread_count = json.value("thread_count", settings.thread_count);
+    settings.slice_threading = json.value("slice_threading", settings.slice_threading);
+    settings.render_threads = json.value("render_threads", settings.render_threads);
+    settings.software_rendering = json.value("software_rendering", settings.software_rendering);
+    settings.segment_length = json.value("segment_length", settings.segment_length);
+    settings.preset = json.value("preset", settings.preset);
+    settings.options = json.value("options", settings.options);
+    settings.muxer_options = json.value("muxer_options", settings.muxer_options);
+
+    return job;
+}
+
+
+static nlohmann::json settings_to_json(const ExportJobSettings& settings)
+{
+    if (auto video = std::get_if<VideoExportJob>(&settings))
+    {
+        auto json = video_to_json(*video);
+        json["kind"] = "video";
+        return json;
+    }
+
+    if (auto sequence = std::get_if<ImageSequenceSettings>(&settings))
+    {
+        return {
+            {"kind", "image_sequence"},
+            {"directory", sequence->directory.string()},
+            {"prefix", sequence->prefix},
+            {"format", sequence->format},
+            {"fps", sequence->fps},
+            {"start_time", sequence->start_time},
+            {"end_time", sequence->end_time},
+            {"software_rendering", sequence->software_rendering},
+            {"incremental", sequence->incremental}
+        };
+    }
+
+    if (auto spritesheet = std::get_if<SpritesheetSettings>(&settings))
+    {
+        return {
+            {"kind", "spritesheet"},
+            {"path", spritesheet->path.string()},
+            {"fps", spritesheet->fps},
+            {"start_time", spritesheet->start_time},
+            {"end_time", spritesheet->end_time},
+            {"padding", spritesheet->padding},
+            {"max_side", spritesheet->max_side},
+            {"software_rendering", spritesheet->software_rendering}
+        };
+    }
+
+    if (auto gif = std::get_if<GifSettings>(&settings))
+    {
+        return {
+            {"kind", "gif"},
+            {"path", gif->path.string()},
+            {"fps", gif->fps},
+            {"start_time", gif->start_time},
+            {"end_time", gif->end_time},
+            {"dithering", gif->dithering},
+            {"software_rendering", gif->software_rendering}
+        };
+    }
+
+    auto& runtime = std::get<RuntimeExportSettings>(settings);
+
+    return {
+        {"kind", "runtime"},
+        {"path", runtime.path.string()},
+        {"length", runtime.length}
+    };
+}
+
+static ExportJobSettings settings_from_json(const nlohmann::json& json)
+{
+    auto kind = json.at("kind").get<std::string>();
+
+    if (kind == "video")
+        return video_from_json(json);
+
+    if (kind == "image_sequence")
+    {
+        ImageSequenceSettings sequence;
+        sequence.directory = json.at("directory").get<std::string>();
+        sequence.prefix = json.value("prefix", sequence.prefix);
+        sequence.format = json.at("format").get<ImageFormat>();
+        sequence.fps = json.at("fps").get<uint64_t>();
+        sequence.start_time = json.at("start_time").get<double>();
+        sequence.end_time = json.at("end_time").get<double>();
+        sequence.software_rendering = json.value("software_rendering", sequence.software_rendering);
+        sequence.incremental = json.value("incremental", sequence.incremental);
+        return sequence;
+    }
+
+    if (kind == "spritesheet")
+    {
+        SpritesheetSettings spritesheet;
+        spritesheet.path = json.at("path").get<std::string>();
+        spritesheet.fps = json.at("fps").get<uint64_t>();
+        spritesheet.start_time = json.at("start_time").get<double>();
+        spritesheet.end_time = json.at("end_time").get<double>();
+        spritesheet.padding = json.value("padding", spritesheet.padding);
+        spritesheet.max_side = json.value("max_side", spritesheet.max_side);
+        spritesheet.software_rendering = json.value("software_rendering", spritesheet.software_rendering);
+        return spritesheet;
+    }
+
+    if (kind == "gif")
+    {
+        GifSettings gif;
+        gif.path = json.at("path").get<std::string>();
+        gif.fps = json.at("fps").get<uint64_t>();
+        gif.start_time = json.at("start_time").get<double>();
+        gif.end_time = json.at("end_time").get<double>();
+        gif.dithering = json.value("dithering", gif.dithering);
+        gif.software_rendering = json.value("software_rendering", gif.software_rendering);
+        return gif;
+    }
+
+    if (kind == "runtime")
+        return RuntimeExportSettings{json.at("path").get<std::string>(), json.at("length").get<double>()};
+
+    throw nlohmann::json::other_error::create(501, fmt::format("unknown export kind '{}'", kind), &json);
+}
+
+
+static std::string get_output_path(const ExportJobSettings& settings)
+{
+    if (auto video = std::get_if<VideoExportJob>(&settings))
+        return video->path;
+
+    if (auto sequence = std::get_if<ImageSequenceSettings>(&settings))
+        return sequence->directory.string();
+
+    if (auto spritesheet = std::get_if<SpritesheetSettings>(&settings))
+        return spritesheet->path.string();
+
+    if (auto gif = std::get_if<GifSettings>(&settings))
+        return gif->path.string();
+
+    return std::get<RuntimeExportSettings>(settings).path.string();
+}
+
+static std::string describe(const ExportJobSettings& settings)
+{
+    if (auto video = std::get_if<VideoExportJob>(&settings))
+        return fmt::format("{}, {}s to {}s at {} fps", video->settings.profile_name, video->start_time, video->start_time + video->length, video->fps);
+
+    if (auto sequence = std::get_if<ImageSequenceSettings>(&settings))
+        return fmt::format("{} sequence, {}s to {}s at {} fps", ImageSequenceSettings::get_extension(sequence->format), sequence->start_time, sequence->end_time, sequence->fps);
+
+    if (auto spritesheet = std::get_if<SpritesheetSettings>(&settings))
+        return fmt::format("spritesheet, {}s to {}s at {} fps", spritesheet->start_time, spritesheet->end_time, spritesheet->fps);
+
+    if (auto gif = std::get_if<GifSettings>(&settings))
+        return fmt::format("gif, {}s to {}s at {} fps", gif->start_time, gif->end_time, gif->fps);
+
+    return "runtime animation";
+}
+
+static bool is_software_rendered(const ExportJobSettings& settings)
+{
+    if (auto video = std::get_if<VideoExportJob>(&settings))
+        return video->settings.software_rendering;
+
+    if (auto sequence = std::get_if<ImageSequenceSettings>(&settings))
+        return sequence->software_rendering;
+
+    if (auto spritesheet = std::get_if<SpritesheetSettings>(&settings))
+        return spritesheet->software_rendering;
+
+    if (auto gif = std::get_if<GifSettings>(&settings))
+        return gif->software_rendering;
+
+    return false;
+}
+
+static size_t get_context_count(const ExportJobSettings& settings)
+{
+    // the runtime export doesn't draw anything
+    if (std::holds_alternative<RuntimeExportSettings>(settings) || is_software_rendered(settings))
+        return 0;
+
+    if (auto video = std::get_if<VideoExportJob>(&settings))
+        return get_render_thread_count(video->settings);
+
+    return 1;
+}
+
+// must be called from the ui thread, like the functions it calls
+static ExportScene collect_scene(const ExportJobSettings& settings)
+{
+    if (std::holds_alternative<RuntimeExportSettings>(settings))
+        return collect_scene_nodes();
+
+    return is_software_rendered(settings) ? collect_software_export_scene() : collect_export_scene();
+}
+
+// the exports delete the fence themselves, scenes that are never exported still hold one
+static void release_scene(ExportScene& scene)
+{
+    if (scene.fence != nullptr)
+        graphic_context.delete_fence(scene.fence);
+
+    scene.fence = nullptr;
+}
+
+static void run_export(ExportJobSettings settings, ExportScene scene, std::shared_ptr<ExportProgress> progress, std::shared_ptr<std::atomic_bool> stop)
+{
+    if (auto video = std::get_if<VideoExportJob>(&settings))
+        export_animation(video->path, video->settings, video->fps, video->start_time, video->length, std::move(scene), progress, stop);
+
+    else if (auto sequence = std::get_if<ImageSequenceSettings>(&settings))
+        export_image_sequence(*sequence, std::move(scene), progress, stop);
+
+    else if (auto spritesheet = std::get_if<SpritesheetSettings>(&settings))
+        export_spritesheet(*spritesheet, std::move(scene), progress, stop);
+
+    else if (auto gif = std::get_if<GifSettings>(&settings))
+        export_gif(*gif, std::move(scene), progress, stop);
+
+    else
+        export_runtime_animation(std::get<RuntimeExportSettings>(settings), std::move(scene), progress, stop);
+}
+
+
+
+void ExportQueue::load(const std::filesystem::path& path)
+{
+    this->save_path = path;
+
+    auto content = try_read_file(path.string());
+    if (content.has_value() == false)
+        return;
+
+    try
+    {
+        auto json = nlohmann::json::parse(content.value());
+
+        if (json.at("version").get<int>() != QUEUE_FILE_VERSION)
+        {
+            warn(fmt::format("'{}' is from another version, the export queue starts empty", path.string()));
+            return;
+        }
+
+        this->concurrency = std::max<size_t>(json.at("concurrency").get<size_t>(), 1);
+
+        for (auto& job_json: json.at("jobs"))
+        {
+            Entry entry;
+            entry.job.id = this->next_id++;
+            entry.job.state = job_json.at("state").get<ExportJob::State>();
+            entry.job.settings = settings_from_json(job_json.at("settings"));
+            entry.job.project = job_json.at("project").get<std::string>();
+            entry.job.size = {job_json.at("size").at(0).get<uint64_t>(), job_json.at("size").at(1).get<uint64_t>()};
+            entry.job.error = job_json.value("error", "");
+
+            if (entry.job.state == ExportJob::State::RUNNING)
+                entry.job.state = ExportJob::State::QUEUED;
+
+            this->entries.push_back(std::move(entry));
+        }
+    }
+    catch (const nlohmann::json::exception& error)
+    {
+        warn(fmt::format("could not read the export queue from '{}': {}", path.string(), error.what()));
+        this->entries.clear();
+    }
+}
+
+uint64_t ExportQueue::add(ExportJob job, bool priority)
+{
+    Entry entry;
+    entry.job = std::move(job);
+    entry.job.id = this->next_id++;
+    entry.job.state = ExportJob::State::QUEUED;
+    entry.job.project = config.current_project.header.path;
+    entry.priority = priority;
+
+    entry.scene = collect_scene(entry.job.settings);
+
+    auto id = entry.job.id;
+    this->entries.push_back(std::move(entry));
+
+    // started now if there is room, instead of on the next frame
+    this->update();
+    this->save();
+
+    return id;
+}
+
+void ExportQueue::cancel(uint64_t id)
+{
+    auto entry = this->find(id);
+    if (entry == nullptr)
+        return;
+
+    if (entry->job.state == ExportJob::State::RUNNING)
+        entry->stop->store(true);
+
+    else if (entry->job.state == ExportJob::State::QUEUED)
+    {
+        if (entry->scene.has_value())
+            release_scene(entry->scene.value());
+
+        entry->scene.reset();
+        entry->job.state = ExportJob::State::CANCELED;
+        this->save();
+    }
+}
+
+void ExportQueue::remove(uint64_t id)
+{
+    auto entry = this->find(id);
+    if (entry == nullptr || entry->job.state == ExportJob::State::RUNNING)
+        return;
+
+    if (entry->scene.has_value())
+        release_scene(entry->scene.value());
+
+    this->entries.remove_if([id](const Entry& entry){ return entry.job.id == id; });
+    this->save();
+}
+
+void ExportQueue::remove_completed()
+{
+    this->entries.remove_if([](const Entry& entry)
+    {
+        auto state = entry.job.state;
+        return state == ExportJob::State::FINISHED || state == ExportJob::State::FAILED || state == ExportJob::State::CANCELED;
+    });
+
+    this->save();
+}
+
+
+void ExportQueue::update()
+{
+    bool changed = false;
+
+    for (auto& entry: this->entries)
+    {
+        if (entry.job.state == ExportJob::State::RUNNING && entry.done->load() == true)
+        {
+            this->reap(entry);
+            changed = true;
+        }
+    }
+
+    auto running = (size_t)std::count_if(this->entries.begin(), this->entries.end(), [](const Entry& entry)
+    {
+        return entry.job.state == ExportJob::State::RUNNING && entry.priority == false;
+    });
+
+    for (auto& entry: this->entries)
+    {
+        if (entry.job.state != ExportJob::State::QUEUED)
+            continue;
+
+        if (entry.priority == false && running >= this->concurrency)
+            continue;
+
+        // jobs of the last session are collected again, once their project is open
+        if (entry.scene.has_value() == false)
+        {
+            auto& current_project = config.current_project.header.path;
+
+            if (current_project.empty() || current_project != entry.job.project)
+                continue;
+
+            entry.scene = collect_scene(entry.job.settings);
+        }
+
+        this->start(entry);
+        changed = true;
+
+        if (entry.priority == false)
+            running += 1;
+    }
+
+    if (changed)
+        this->save();
+}
+
+void ExportQueue::shutdown()
+{
+    for (auto& entry: this->entries)
+        if (entry.job.state == ExportJob::State::RUNNING)
+            entry.stop->store(true);
+
+    for (auto& entry: this->entries)
+    {
+        if (entry.job.state == ExportJob::State::RUNNING)
+        {
+            entry.thread.join();
+
+            // they start over next time, the partial outputs were already removed
+            entry.job.state = ExportJob::State::QUEUED;
+        }
+
+        if (entry.scene.has_value())
+            release_scene(entry.scene.value());
+
+        entry.scene.reset();
+    }
+
+    this->save();
+}
+
+
+void ExportQueue::set_concurrency(size_t _concurrency)
+{
+    this->concurrency = std::max<size_t>(_concurrency, 1);
+    this->save();
+}
+
+size_t ExportQueue::get_concurrency()
+{
+    return this->concurrency;
+}
+
+
+std::vector<ExportJobStatus> ExportQueue::get_jobs()
+{
+    std::vector<ExportJobStatus> output;
+
+    for (auto& entry: this->entries)
+        output.push_back(this->get_status(entry));
+
+    return output;
+}
+
+std::optional<ExportJobStatus> ExportQueue::get_job(uint64_t id)
+{
+    auto entry = this->find(id);
+    if (entry == nullptr)
+        return std::nullopt;
+
+    return this->get_status(*entry);
+}
+
+
+
+void ExportQueue::start(Entry& entry)
+{
+    auto& scene = entry.scene.value();
+
+    if (entry.job.size.x > 0 && entry.job.size.y > 0)
+        scene.size = entry.job.size;
+
+    // the first free range of contexts large enough, new ones are made past the end
+    auto context_count = get_context_count(entry.job.settings);
+    if (context_count > 0)
+    {
+        size_t first = 0;
+
+        for (size_t i = 0; i < this->context_owners.size(); ++i)
+        {
+            if (this->context_owners[i] != 0)
+                first = i + 1;
+            else if (i + 1 - first == context_count)
+                break;
+        }
+
+        if (this->context_owners.size() < first + context_count)
+            this->context_owners.resize(first + context_count, 0);
+
+        std::fill_n(this->context_owners.begin() + first, context_count, entry.job.id);
+        graphic_context.reserve_export_contexts(first + context_count);
+
+        scene.first_context = first;
+    }
+
+    entry.progress = std::make_shared<ExportProgress>();
+    entry.stop = std::make_shared<std::atomic_bool>(false);
+    entry.done = std::make_shared<std::atomic_bool>(false);
+    entry.start_time = std::chrono::steady_clock::now();
+
+    entry.thread = std::thread{[settings = entry.job.settings, scene = std::move(scene), progress = entry.progress, stop = entry.stop, done = entry.done]() mutable
+    {
+        run_export(std::move(settings), std::move(scene), progress, stop);
+        done->store(true);
+    }};
+
+    entry.scene.reset();
+    entry.job.state = ExportJob::State::RUNNING;
+    entry.job.error.clear();
+}
+
+void ExportQueue::reap(Entry& entry)
+{
+    entry.thread.join();
+
+    std::replace(this->context_owners.begin(), this->context_owners.end(), entry.job.id, (uint64_t)0);
+
+    switch (entry.progress->get_state())
+    {
+        case ExportProgress::State::FINISHED:
+            entry.job.state = ExportJob::State::FINISHED;
+            break;
+
+        case ExportProgress::State::FAILED:
+            entry.job.state = ExportJob::State::FAILED;
+            entry.job.error = entry.progress->get_error();
+            break;
+
+        case ExportProgress::State::RUNNING:
+            if (entry.stop->load() == true)
+                entry.job.state = ExportJob::State::CANCELED;
+            else
+            {
+                entry.job.state = ExportJob::State::FAILED;
+                entry.job.error = "the export ended without completing";
+            }
+            break;
+    }
+}
+
+void ExportQueue::save()
+{
+    if (this->save_path.empty())
+        return;
+
+    auto jobs = nlohmann::json::array();
+
+    for (auto& entry: this->entries)
+    {
+        // exports started from the dialog aren't part of the queue
+        if (entry.priority)
+            continue;
+
+        jobs.push_back({
+            {"state", entry.job.state},
+            {"settings", settings_to_json(entry.job.settings)},
+            {"project", entry.job.project.string()},
+            {"size", {entry.job.size.x, entry.job.size.y}},
+            {"error", entry.job.error}
+        });
+    }
+
+    auto json = nlohmann::json{
+        {"version", QUEUE_FILE_VERSION},
+        {"concurrency", this->concurrency},
+        {"jobs", std::move(jobs)}
+    }.dump(4);
+
+    // the queue keeps running from memory, it just won't be there after a restart
+    if (try_write_file(this->save_path.string(), json.data(), json.size()) == false)
+        warn(fmt::format("could not save the export queue to '{}'", this->save_path.string()));
+}
+
+
+ExportQueue::Entry* ExportQueue::find(uint64_t id)
+{
+    auto entry = std::find_if(this->entries.begin(), this->entries.end(), [id](const Entry& entry){ return entry.job.id == id; });
+    return entry != this->entries.end() ? &*entry : nullptr;
+}
+
+ExportJobStatus ExportQueue::get_status(Entry& entry)
+{
+    ExportJobStatus status;
+    status.id = entry.job.id;
+    status.state = entry.job.state;
+    status.name = std::filesystem::path{get_output_path(entry.job.settings)}.filename().string();
+    status.description = describe(entry.job.settings);
+    status.error = entry.job.error;
+    status.waiting_for_project = entry.job.state == ExportJob::State::QUEUED && entry.scene.has_value() == false;
+
+    if (entry.job.state == ExportJob::State::FINISHED)
+        status.percentage = 100;
+
+    if (entry.progress == nullptr)
+        return status;
+
+    status.percentage = entry.progress->get_percentage();
+    status.done_frames = entry.progress->get_done_frames();
+    status.frame_count = entry.progress->get_frame_count();
+
+    if (entry.job.state == ExportJob::State::RUNNING)
+    {
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - entry.start_time).count();
+
+        if (elapsed > 0 && status.done_frames > 0)
+        {
+            status.frames_per_second = status.done_frames / elapsed;
+            status.remaining_seconds = (status.frame_count - std::min(status.done_frames, status.frame_count)) / status.frames_per_second;
+        }
+    }
+
+    return status;
+}
@@ -0,0 +1,163 @@
+#pragma once
+
+
+// local
+#include "export_progress.hpp"
+#include "gif_export.hpp"
+#include "image_sequence.hpp"
+#include "runtime_export.hpp"
+#include "scene_render.hpp"
+#include "spritesheet.hpp"
+#include "video_export.hpp"
+#include "video_settings.hpp"
+
+// extern
+#include <glm/vec2.hpp>
+
+// builtin
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <list>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <variant>
+#include <vector>
+
+
+
+struct VideoExportJob
+{
+    std::string path;
+    VideoSettings settings;
+    uint64_t fps = 60;
+    double start_time = 0;
+    double length = 0;
+};
+
+using ExportJobSettings = std::variant<VideoExportJob, ImageSequenceSettings, SpritesheetSettings, GifSettings, RuntimeExportSettings>;
+
+
+// everything an export needs besides the nodes, so it can be saved and run later
+struct ExportJob
+{
+    enum class State
+    {
+        QUEUED,
+        RUNNING,
+        FINISHED,
+        FAILED,
+        CANCELED
+    };
+
+    uint64_t id = 0;
+    State state = State::QUEUED;
+    ExportJobSettings settings;
+
+    // the nodes are taken from this project, the one open when the job was added
+    std::filesystem::path project;
+
+    // of the frames, the camera area of the project when it is {0, 0}
+    glm::u64vec2 size = {0, 0};
+
+    std::string error;
+};
+
+// what the ui shows of a job
+struct ExportJobStatus
+{
+    uint64_t id;
+    ExportJob::State state;
+    std::string name;
+    std::string description;
+
+    uint8_t percentage = 0;
+    uint64_t done_frames = 0;
+    uint64_t frame_count = 0;
+    double frames_per_second = 0;
+    std::optional<double> remaining_seconds;
+
+    // jobs restored from the last session wait until their project is opened
+    bool waiting_for_project = false;
+    std::string error;
+};
+
+
+// runs exports in the background, at most "concurrency" at a time and each on its own
+// range of export contexts. every method must be called from the ui thread, which also
+// has to call "update" every frame. the jobs are saved whenever one changes, jobs that
+// were running when the application closed run again the next time
+class ExportQueue
+{
+    private:
+
+        struct Entry
+        {
+            ExportJob job;
+
+            // taken when the job is added, or when it starts for jobs of the last session
+            std::optional<ExportScene> scene;
+
+            // starts right away instead of waiting for a free slot
+            bool priority = false;
+
+            std::shared_ptr<ExportProgress> progress;
+            std::shared_ptr<std::atomic_bool> stop;
+            std::shared_ptr<std::atomic_bool> done;
+            std::thread thread;
+            std::chrono::steady_clock::time_point start_time;
+        };
+
+        std::list<Entry> entries;
+        uint64_t next_id = 1;
+        size_t concurrency = 1;
+
+        // id of the job using each export context, 0 for free ones
+        std::vector<uint64_t> context_owners;
+
+        std::filesystem::path save_path;
+
+    public:
+
+        ExportQueue() = default;
+        ExportQueue(const ExportQueue&) = delete;
+        ExportQueue& operator=(const ExportQueue&) = delete;
+
+        // jobs that were queued or running last time are queued again, the others are kept as history
+        void load(const std::filesystem::path& path);
+
+        // the nodes are collected now, from the open project
+        uint64_t add(ExportJob job, bool priority = false);
+
+        // a running job is stopped and its partial output removed, it is canceled once its thread is done
+        void cancel(uint64_t id);
+
+        // only jobs that aren't running
+        void remove(uint64_t id);
+        void remove_completed();
+
+        void update();
+
+        // stops every job and waits for them, they are saved as queued
+        void shutdown();
+
+        void set_concurrency(size_t concurrency);
+        size_t get_concurrency();
+
+        std::vector<ExportJobStatus> get_jobs();
+        std::optional<ExportJobStatus> get_job(uint64_t id);
+
+    private:
+
+        void start(Entry& entry);
+        void reap(Entry& entry);
+        void save();
+
+        Entry* find(uint64_t id);
+        ExportJobStatus get_status(Entry& entry);
+};
+
+inline ExportQueue export_queue;
@@ -0,0 +1,479 @@
+// header
+#include "gif_export.hpp"
+
+// local
+#include "export/palette.hpp"
+#include "export/pixel_readback.hpp"
+#include "graphical/software/framebuffer.hpp"
+#include "utils/log.hpp"
+#include "utils/thread_pool.hpp"
+
+// builtin
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <vector>
+
+
+
+static const uint64_t MAX_GIF_FPS = 50;
+
+static const size_t READBACK_BUFFER_COUNT = 3;
+static const size_t TASKS_PER_POOL_THREAD = 2;
+
+// the last index is kept for the pixels that didn't change
+static const size_t PALETTE_SIZE = 255;
+static const uint8_t TRANSPARENT_INDEX = 255;
+
+static const uint32_t LZW_MIN_CODE_SIZE = 8;
+static const uint32_t LZW_MAX_CODE = 4095;
+static const size_t LZW_HASH_SIZE = 8191;
+
+
+using Pixels = std::shared_ptr<const std::vector<uint8_t>>;
+
+
+// codes of variable width packed from the lowest bit, in blocks of at most 255 bytes
+class CodeWriter
+{
+    private:
+
+        std::vector<uint8_t>& output;
+        std::vector<uint8_t> block;
+        uint32_t bits = 0;
+        uint32_t bit_count = 0;
+
+    public:
+
+        CodeWriter(std::vector<uint8_t>& _output): output{_output}
+        {
+        }
+
+        void write(uint32_t code, uint32_t size)
+        {
+            this->bits |= code << this->bit_count;
+            this->bit_count += size;
+
+            while (this->bit_count >= 8)
+            {
+                this->push_byte(this->bits & 0xff);
+                this->bits >>= 8;
+                this->bit_count -= 8;
+            }
+        }
+
+        void finish()
+        {
+            if (this->bit_count > 0)
+                this->push_byte(this->bits & 0xff);
+
+            this->flush_block();
+            this->output.push_back(0);
+        }
+
+    private:
+
+        void push_byte(uint8_t byte)
+        {
+            this->block.push_back(byte);
+
+            if (this->block.size() == 255)
+                this->flush_block();
+        }
+
+        void flush_block()
+        {
+            if (this->block.empty())
+                return;
+
+            this->output.push_back((uint8_t)this->block.size());
+            this->output.insert(this->output.end(), this->block.begin(), this->block.end());
+            this->block.clear();
+        }
+};
+
+
+// the dictionary maps a code followed by a byte to the code of the longer string
+static void compress(const std::vector<uint8_t>& indices, std::vector<uint8_t>& output)
+{
+    const uint32_t clear_code = 1 << LZW_MIN_CODE_SIZE;
+    const uint32_t end_code = clear_code + 1;
+
+    std::vector<int32_t> keys(LZW_HASH_SIZE);
+    std::vector<uint16_t> codes(LZW_HASH_SIZE);
+
+    uint32_t code_size = LZW_MIN_CODE_SIZE + 1;
+    uint32_t last_code = end_code;
+
+    const auto reset = [&]()
+    {
+        std::fill(keys.begin(), keys.end(), -1);
+        code_size = LZW_MIN_CODE_SIZE + 1;
+        last_code = end_code;
+    };
+
+    output.push_back(LZW_MIN_CODE_SIZE);
+    CodeWriter writer{output};
+
+    reset();
+    writer.write(clear_code, code_size);
+
+    int32_t current = -1;
+
+    for (auto index: indices)
+    {
+        if (current < 0)
+        {
+            current = index;
+            continue;
+        }
+
+        int32_t key = (current << 8) | index;
+        size_t slot = (size_t)key % LZW_HASH_SIZE;
+
+        while (keys[slot] >= 0 && keys[slot] != key)
+            slot = (slot + 1) % LZW_HASH_SIZE;
+
+        if (keys[slot] == key)
+        {
+            current = codes[slot];
+            continue;
+        }
+
+        writer.write(current, code_size);
+
+        last_code += 1;
+        keys[slot] = key;
+        codes[slot] = (uint16_t)last_code;
+
+        // the decoder adds this code one step later, so it widens its codes after reading the next one
+        if (last_code >= (1u << code_size) && code_size < 12)
+            code_size += 1;
+
+        if (last_code == LZW_MAX_CODE)
+        {
+            writer.write(clear_code, code_size);
+            reset();
+        }
+
+        current = index;
+    }
+
+    if (current >= 0)
+    {
+        writer.write(current, code_size);
+
+        // the decoder still adds a code for the last one, which may widen the end code
+        if (last_code + 1 >= (1u << code_size) && code_size < 12 && last_code > end_code)
+            code_size += 1;
+    }
+
+    writer.write(end_code, code_size);
+    writer.finish();
+}
+
+
+static void write_u16(std::vector<uint8_t>& output, uint16_t value)
+{
+    output.push_back(value & 0xff);
+    output.push_back(value >> 8);
+}
+
+static bool same_color(const uint8_t* a, const uint8_t* b)
+{
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+
+// the graphic control extension, image descriptor, palette and pixels of one frame
+static std::vector<uint8_t> encode_frame(Pixels current, Pixels previous, glm::u64vec2 size, uint16_t delay, bool dithering)
+{
+    const auto pixel = [&](const Pixels& pixels, uint64_t x, uint64_t y){ return pixels->data() + (y * size.x + x) * Image::CHANNELS; };
+
+    // only what changed since the last frame, which stays on the canvas
+    glm::u64vec2 min = {0, 0};
+    glm::u64vec2 max = size;
+
+    if (previous != nullptr)
+    {
+        min = size;
+        max = {0, 0};
+
+        for (uint64_t y = 0; y < size.y; ++y)
+            for (uint64_t x = 0; x < size.x; ++x)
+                if (same_color(pixel(current, x, y), pixel(previous, x, y)) == false)
+                {
+                    min = {std::min(min.x, x), std::min(min.y, y)};
+                    max = {std::max(max.x, x + 1), std::max(max.y, y + 1)};
+                }
+
+        // the frame is still needed for its delay, a single transparent pixel
+        if (min.x >= max.x || min.y >= max.y)
+        {
+            min = {0, 0};
+            max = {1, 1};
+        }
+    }
+
+    const auto rect = max - min;
+    const auto changed = [&](uint64_t x, uint64_t y){ return previous == nullptr || same_color(pixel(current, x, y), pixel(previous, x, y)) == false; };
+
+    ColorHistogram histogram;
+    for (uint64_t y = min.y; y < max.y; ++y)
+        for (uint64_t x = min.x; x < max.x; ++x)
+            if (changed(x, y))
+                histogram.add(pixel(current, x, y)[0], pixel(current, x, y)[1], pixel(current, x, y)[2]);
+
+    auto palette = histogram.make_palette(PALETTE_SIZE);
+    if (palette.empty())
+        palette.push_back({0, 0, 0});
+
+    PaletteMapper mapper{palette};
+    std::vector<uint8_t> indices(rect.x * rect.y, TRANSPARENT_INDEX);
+
+    // floyd steinberg, the error of this row and the next with a pixel of margin on each side
+    std::vector<int> error((rect.x + 2) * 3 * 2, 0);
+
+    for (uint64_t y = 0; y < rect.y; ++y)
+    {
+        auto row_error = error.data() + (y % 2) * (rect.x + 2) * 3;
+        auto next_error = error.data() + ((y + 1) % 2) * (rect.x + 2) * 3;
+        std::fill(next_error, next_error + (rect.x + 2) * 3, 0);
+
+        for (uint64_t x = 0; x < rect.x; ++x)
+        {
+            if (changed(min.x + x, min.y + y) == false)
+                continue;
+
+            auto source = pixel(current, min.x + x, min.y + y);
+            auto pixel_error = row_error + (x + 1) * 3;
+
+            int color[3];
+            for (int channel = 0; channel < 3; ++channel)
+                color[channel] = std::clamp(source[channel] + (dithering ? pixel_error[channel] / 16 : 0), 0, 255);
+
+            auto index = mapper.get_index((uint8_t)color[0], (uint8_t)color[1], (uint8_t)color[2]);
+            indices[y * rect.x + x] = index;
+
+            if (dithering == false)
+                continue;
+
+            auto& chosen = mapper.get_color(index);
+            for (int channel = 0; channel < 3; ++channel)
+            {
+                int difference = color[channel] - chosen[channel];
+
+                pixel_error[channel + 3] += difference * 7;
+                next_error[x * 3 + channel] += difference * 3;
+                next_error[(x + 1) * 3 + channel] += difference * 5;
+                next_error[(x + 2) * 3 + channel] += difference * 1;
+            }
+        }
+    }
+
+    std::vector<uint8_t> output;
+
+    // graphic control extension: left on the canvas, with a transparent index
+    output.insert(output.end(), {0x21, 0xf9, 0x04, (1 << 2) | 1});
+    write_u16(output, delay);
+    output.insert(output.end(), {TRANSPARENT_INDEX, 0x00});
+
+    // image descriptor with a local color table of 256 entries
+    output.push_back(0x2c);
+    write_u16(output, (uint16_t)min.x);
+    write_u16(output, (uint16_t)min.y);
+    write_u16(output, (uint16_t)rect.x);
+    write_u16(output, (uint16_t)rect.y);
+    output.push_back(0x80 | 7);
+
+    for (size_t i = 0; i < 256; ++i)
+    {
+        auto color = i < palette.size() ? palette[i] : glm::u8vec3{0, 0, 0};
+        output.insert(output.end(), {color.r, color.g, color.b});
+    }
+
+    compress(indices, output);
+
+    return output;
+}
+
+
+static std::vector<uint8_t> encode_header(glm::u64vec2 size)
+{
+    std::vector<uint8_t> output{'G', 'I', 'F', '8', '9', 'a'};
+
+    // logical screen without a global color table
+    write_u16(output, (uint16_t)size.x);
+    write_u16(output, (uint16_t)size.y);
+    output.insert(output.end(), {0x00, 0x00, 0x00});
+
+    // loops forever
+    output.insert(output.end(), {0x21, 0xff, 0x0b});
+    output.insert(output.end(), {'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0'});
+    output.insert(output.end(), {0x03, 0x01, 0x00, 0x00, 0x00});
+
+    return output;
+}
+
+
+void export_gif(GifSettings settings, ExportScene scene, std::shared_ptr<ExportProgress> progress, std::shared_ptr<std::atomic_bool> stop)
+{
+    const auto fps = std::clamp<uint64_t>(settings.fps, 1, MAX_GIF_FPS);
+    const auto frame_count = (uint64_t)std::ceil((settings.end_time - settings.start_time) * fps);
+    const auto size = scene.size;
+    const auto export_start = std::chrono::steady_clock::now();
+
+    const auto get_time = [&](uint64_t index){ return settings.start_time + (double)index / fps; };
+
+    // gif delays are in hundredths of a second, rounding the end of every frame keeps the total right
+    const auto get_delay = [&](uint64_t first, uint64_t end)
+    {
+        return (uint16_t)(std::llround(end * 100.0 / fps) - std::llround(first * 100.0 / fps));
+    };
+
+    // a run of frames with the same scene is stored once, shown for all of them
+    std::vector<std::pair<uint64_t, uint64_t>> runs;
+    uint64_t last_hash = 0;
+
+    for (uint64_t i = 0; i < frame_count; ++i)
+    {
+        auto hash = hash_frame(scene, get_time(i));
+
+        if (runs.empty() || hash != last_hash)
+            runs.push_back({i, i + 1});
+        else
+            runs.back().second = i + 1;
+
+        last_hash = hash;
+    }
+
+    progress->set_frame_count(runs.size());
+
+    std::ofstream file{settings.path, std::ios::binary};
+    if (file.is_open() == false)
+    {
+        progress->fail(fmt::format("could not write '{}'", settings.path.string()));
+        release_export_scene_with_context(scene);
+        return;
+    }
+
+    auto header = encode_header(size);
+    file.write((const char*)header.data(), header.size());
+
+    std::deque<std::future<std::vector<uint8_t>>> tasks;
+    const size_t max_tasks = thread_pool.get_thread_count() * TASKS_PER_POOL_THREAD;
+
+    Pixels previous = nullptr;
+    size_t written_frames = 0;
+    uint64_t written_bytes = header.size();
+
+    // frames are written in the order they were queued, the oldest task finishes first anyway
+    const auto write_oldest = [&]()
+    {
+        auto frame = tasks.front().get();
+        tasks.pop_front();
+
+        file.write((const char*)frame.data(), frame.size());
+        written_bytes += frame.size();
+        written_frames += 1;
+
+        progress->set_done_frames(written_frames);
+    };
+
+    const auto encode = [&](size_t run, std::vector<uint8_t> pixels)
+    {
+        while (tasks.size() >= max_tasks)
+            write_oldest();
+
+        auto current = std::make_shared<const std::vector<uint8_t>>(std::move(pixels));
+        auto delay = get_delay(runs[run].first, runs[run].second);
+
+        tasks.push_back(thread_pool.submit([current, previous, size, delay, dithering = settings.dithering]()
+        {
+            return encode_frame(current, previous, size, delay, dithering);
+        }));
+
+        previous = current;
+    };
+
+    if (settings.software_rendering)
+    {
+        auto framebuffer = SoftwareFramebuffer{size.x, size.y};
+
+        for (size_t run = 0; run < runs.size() && stop->load() == false; ++run)
+        {
+            render_scene(framebuffer, get_time(runs[run].first), scene);
+
+            auto pixels = framebuffer.get_pixels();
+            encode(run, std::vector<uint8_t>(pixels, pixels + size.x * size.y * Image::CHANNELS));
+        }
+    }
+    else
+    {
+        graphic_context.make_current_export_context(scene.first_context);
+        graphic_context.wait_fence(scene.fence);
+
+        {
+            auto framebuffer = Framebuffer{size.x, size.y};
+            auto readback = PixelReadback{size, GL_RGBA, READBACK_BUFFER_COUNT};
+
+            const auto take_oldest_frame = [&]()
+            {
+                std::vector<uint8_t> pixels(readback.byte_size());
+                auto run = readback.finish(pixels.data());
+                encode(run, std::move(pixels));
+            };
+
+            for (size_t run = 0; run < runs.size() && stop->load() == false; ++run)
+            {
+                render_scene(framebuffer, get_time(runs[run].first), scene);
+                readback.start(framebuffer, run);
+
+                if (readback.is_full())
+                    take_oldest_frame();
+            }
+
+            while (readback.is_empty() == false && stop->load() == false)
+                take_oldest_frame();
+        }
+
+        release_export_scene(scene);
+        graphic_context.release_current_context();
+    }
+
+    while (tasks.empty() == false)
+        write_oldest();
+
+    // an incomplete gif would still play, but it isn't what was asked for
+    if (stop->load() == true)
+    {
+        file.close();
+
+        std::error_code error;
+        std::filesystem::remove(settings.path, error);
+        return;
+    }
+
+    file.put(0x3b);
+    file.close();
+
+    // a full disk only shows once the file is flushed
+    if (file.fail())
+    {
+        progress->fail(fmt::format("could not write '{}'", settings.path.string()));
+
+        std::error_code error;
+        std::filesystem::remove(settings.path, error);
+        return;
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - export_start).count();
+    notice(fmt::format("wrote {} gif frames ({} merged) in {:.2f}s, {} KiB",
+        written_frames, frame_count - runs.size(), elapsed, written_bytes / 1024));
+
+    progress->finish();
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+
+// local
+#include "export_progress.hpp"
+#include "scene_render.hpp"
+
+// builtin
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+
+
+struct GifSettings
+{
+    std::filesystem::path path;
+
+    // capped to "MAX_GIF_FPS", viewers slow down faster gifs
+    uint64_t fps = 25;
+    double start_time = 0;
+    double end_time = 0;
+
+    // smoother gradients, but the noise makes every frame differ a bit more from the last
+    bool dithering = true;
+
+    // draws on the cpu instead, for machines without a gpu
+    bool software_rendering = false;
+};
+
+
+// runs on its own thread with the first export context. every frame gets its own palette,
+// picked by median cut, and only the rect that changed since the last frame is stored, the
+// unchanged pixels inside it are transparent. frames are quantized and compressed on the
+// thread pool while the next ones render, and frames that look the same are merged
+void export_gif(GifSettings settings, ExportScene scene, std::shared_ptr<ExportProgress> progress, std::shared_ptr<std::atomic_bool> stop);
@@ -0,0 +1,323 @@
+// header
+#include "image_sequence.hpp"
+
+// local
+#include "export/pixel_readback.hpp"
+#include "graphical/software/framebuffer.hpp"
+#include "utils/file_io.hpp"
+#include "utils/log.hpp"
+#include "utils/thread_pool.hpp"
+
+// extern
+#include <nlohmann/json.hpp>
+#include <stb_image_write.h>
+
+// builtin
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+
+
+// frames read back ahead of the one being written
+static const size_t READBACK_BUFFER_COUNT = 3;
+
+// frames waiting on the pool per thread of it, so rendering can't run too far ahead of the writes
+static const size_t WRITES_PER_POOL_THREAD = 2;
+
+
+const char* ImageSequenceSettings::get_extension(ImageFormat format)
+{
+    switch (format)
+    {
+        case ImageFormat::PNG: return "png";
+        case ImageFormat::TGA: return "tga";
+        case ImageFormat::PPM: return "ppm";
+    }
+
+    panic("invalid image format");
+}
+
+
+static bool write_ppm(const std::filesystem::path& path, glm::u64vec2 size, const uint8_t* pixels)
+{
+    auto file = std::fopen(path.string().c_str(), "wb");
+    if (file == nullptr)
+        return false;
+
+    std::fprintf(file, "P6\n%llu %llu\n255\n", (unsigned long long)size.x, (unsigned long long)size.y);
+
+    std::vector<uint8_t> row(size.x * 3);
+    bool written = true;
+
+    for (uint64_t y = 0; y < size.y && written; ++y)
+    {
+        auto source = pixels + y * size.x * 4;
+
+        for (uint64_t x = 0; x < size.x; ++x)
+            std::memcpy(&row[x * 3], &source[x * 4], 3);
+
+        written = std::fwrite(row.data(), 1, row.size(), file) == row.size();
+    }
+
+    return std::fclose(file) == 0 && written;
+}
+
+bool write_image(const std::filesystem::path& path, ImageFormat format, glm::u64vec2 size, const uint8_t* pixels)
+{
+    switch (format)
+    {
+        case ImageFormat::PNG:
+            return stbi_write_png(path.string().c_str(), size.x, size.y, 4, pixels, 0) != 0;
+
+        case ImageFormat::TGA:
+            return stbi_write_tga(path.string().c_str(), size.x, size.y, 4, pixels) != 0;
+
+        case ImageFormat::PPM:
+            return write_ppm(path, size, pixels);
+    }
+
+    return false;
+}
+
+
+// frame number to the hash of its scene, for the frames already in the folder
+using FrameHashes = std::unordered_map<uint64_t, uint64_t>;
+
+static const int FRAME_CACHE_VERSION = 1;
+
+static std::filesystem::path get_frame_cache_path(const ImageSequenceSettings& settings)
+{
+    return settings.directory / fmt::format(".{}.leafcache", settings.prefix);
+}
+
+// empty if there is none, or it was written for another format or size
+static FrameHashes read_frame_cache(const ImageSequenceSettings& settings, glm::u64vec2 size)
+{
+    auto content = try_read_file(get_frame_cache_path(settings).string());
+    if (content.has_value() == false)
+        return {};
+
+    auto json = nlohmann::json::parse(content.value(), nullptr, false);
+    if (json.is_discarded() || json.is_object() == false)
+        return {};
+
+    if (json.value("version", 0) != FRAME_CACHE_VERSION
+        || json.value("format", "") != ImageSequenceSettings::get_extension(settings.format)
+        || json.value("width", 0ull) != size.x
+        || json.value("height", 0ull) != size.y)
+        return {};
+
+    FrameHashes output;
+
+    for (auto& frame: json.value("frames", nlohmann::json::array()))
+        if (frame.is_array() && frame.size() == 2)
+            output.emplace(frame[0].get<uint64_t>(), frame[1].get<uint64_t>());
+
+    return output;
+}
+
+static bool write_frame_cache(const ImageSequenceSettings& settings, glm::u64vec2 size, const FrameHashes& hashes)
+{
+    auto frames = nlohmann::json::array();
+    for (auto& [frame, hash]: hashes)
+        frames.push_back({frame, hash});
+
+    auto json = nlohmann::json{
+        {"version", FRAME_CACHE_VERSION},
+        {"format", ImageSequenceSettings::get_extension(settings.format)},
+        {"width", size.x},
+        {"height", size.y},
+        {"frames", std::move(frames)}
+    }.dump();
+
+    return try_write_file(get_frame_cache_path(settings).string(), json.data(), json.size());
+}
+
+
+// returns false if it was stopped or a frame couldn't be written
+static bool write_sequence(const ImageSequenceSettings& settings, ExportScene& scene, std::shared_ptr<ExportProgress> progress, std::shared_ptr<std::atomic_bool> stop)
+{
+    const auto first_frame = (uint64_t)std::llround(settings.start_time * settings.fps);
+    const auto frame_count = (uint64_t)std::ceil((settings.end_time - settings.start_time) * settings.fps);
+    const auto size = scene.size;
+    const auto export_start = std::chrono::steady_clock::now();
+
+    progress->set_frame_count(frame_count);
+
+    std::error_code error;
+    std::filesystem::create_directories(settings.directory, error);
+    if (error)
+    {
+        progress->fail(fmt::format("could not create '{}': {}", settings.directory.string(), error.message()));
+        return false;
+    }
+
+    // the rle variant is slower to write and few tools expect it
+    stbi_write_tga_with_rle = 0;
+
+    // hashed up front, it only animates the nodes and is far cheaper than a frame
+    std::vector<uint64_t> hashes(frame_count);
+    for (uint64_t i = 0; i < frame_count; ++i)
+        hashes[i] = hash_frame(scene, settings.start_time + (double)i / settings.fps);
+
+    // frames of other ranges stay in the cache, frames of this one are added back once written
+    auto cached = settings.incremental ? read_frame_cache(settings, size) : FrameHashes{};
+    std::mutex cached_mutex;
+
+    const auto get_path = [&](uint64_t index)
+    {
+        return settings.directory / fmt::format("{}_{:05}.{}", settings.prefix, first_frame + index, ImageSequenceSettings::get_extension(settings.format));
+    };
+
+    std::vector<bool> unchanged(frame_count, false);
+    uint64_t skipped_frames = 0;
+
+    for (uint64_t i = 0; i < frame_count; ++i)
+    {
+        auto frame = cached.find(first_frame + i);
+
+        if (frame != cached.end() && frame->second == hashes[i] && std::filesystem::exists(get_path(i)))
+        {
+            unchanged[i] = true;
+            skipped_frames += 1;
+        }
+        else if (frame != cached.end())
+            cached.erase(frame);
+    }
+
+    progress->set_done_frames(skipped_frames);
+    std::atomic_bool failed = false;
+    std::deque<std::future<void>> writes;
+
+    const size_t max_writes = thread_pool.get_thread_count() * WRITES_PER_POOL_THREAD;
+
+    const auto write_frame = [&](uint64_t index, std::vector<uint8_t> pixels)
+    {
+        // the oldest write is likely done by now, this only waits when the pool falls behind
+        while (writes.size() >= max_writes)
+        {
+            writes.front().get();
+            writes.pop_front();
+        }
+
+        auto path = get_path(index);
+
+        writes.push_back(thread_pool.submit([&, index, path, pixels = std::move(pixels)]()
+        {
+            if (failed.load() == true || stop->load() == true)
+                return;
+
+            if (write_image(path, settings.format, size, pixels.data()) == false)
+            {
+                // only the first failure is reported, the others are skipped
+                if (failed.exchange(true) == false)
+                    progress->fail(fmt::format("could not write '{}'", path.string()));
+
+                return;
+            }
+
+            {
+                std::lock_guard lock{cached_mutex};
+                cached[first_frame + index] = hashes[index];
+            }
+
+            progress->add_done_frames();
+        }));
+    };
+
+    const auto should_stop = [&](){ return stop->load() == true || failed.load() == true; };
+
+    if (settings.software_rendering)
+    {
+        auto framebuffer = SoftwareFramebuffer{size.x, size.y};
+
+        for (uint64_t i = 0; i < frame_count && should_stop() == false; ++i)
+        {
+            if (unchanged[i])
+                continue;
+
+            render_scene(framebuffer, settings.start_time + (double)i / settings.fps, scene);
+
+            auto pixels = framebuffer.get_pixels();
+            write_frame(i, std::vector<uint8_t>(pixels, pixels + size.x * size.y * Image::CHANNELS));
+        }
+    }
+    else
+    {
+        graphic_context.make_current_export_context(scene.first_context);
+        graphic_context.wait_fence(scene.fence);
+
+        {
+            auto framebuffer = Framebuffer{size.x, size.y};
+            auto readback = PixelReadback{size, GL_RGBA, READBACK_BUFFER_COUNT};
+
+            const auto take_oldest_frame = [&]()
+            {
+                std::vector<uint8_t> pixels(readback.byte_size());
+                auto index = readback.finish(pixels.data());
+                write_frame(index, std::move(pixels));
+            };
+
+            for (uint64_t i = 0; i < frame_count && should_stop() == false; ++i)
+            {
+                if (unchanged[i])
+                    continue;
+
+                render_scene(framebuffer, settings.start_time + (double)i / settings.fps, scene);
+                readback.start(framebuffer, i);
+
+                if (readback.is_full())
+                    take_oldest_frame();
+            }
+
+            while (readback.is_empty() == false && should_stop() == false)
+                take_oldest_frame();
+        }
+
+        release_export_scene(scene);
+        graphic_context.release_current_context();
+    }
+
+    for (auto& write: writes)
+        write.get();
+
+    // also when stopped, so the frames written so far are skipped next time
+    bool cache_written = write_frame_cache(settings, size, cached);
+
+    if (should_stop())
+        return false;
+
+    if (cache_written == false)
+    {
+        progress->fail(fmt::format("could not write '{}'", get_frame_cache_path(settings).string()));
+        return false;
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - export_start).count();
+    auto written_frames = frame_count - skipped_frames;
+
+    notice(fmt::format("wrote {} {} frames to '{}' in {:.2f}s ({:.1f} fps), {} unchanged frames skipped",
+        written_frames, ImageSequenceSettings::get_extension(settings.format), settings.directory.string(), elapsed, written_frames / std::max(elapsed, 1e-9), skipped_frames));
+
+    return true;
+}
+
+
+void export_image_sequence(ImageSequenceSettings settings, ExportScene scene, std::shared_ptr<ExportProgress> progress, std::shared_ptr<std::atomic_bool> stop)
+{
+    // failures were already reported to "progress"
+    bool written = write_sequence(settings, scene, progress, stop);
+
+    // it returns before making the context current when it fails early
+    release_export_scene_with_context(scene);
+
+    if (written)
+        progress->finish();
+}
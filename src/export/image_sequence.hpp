@@ -0,0 +1,59 @@
+#pragma once
+
+
+// local
+#include "export_progress.hpp"
+#include "scene_render.hpp"
+
+// extern
+#include <glm/vec2.hpp>
+
+// builtin
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+
+enum class ImageFormat
+{
+    PNG,
+
+    // uncompressed, much faster to write when the frames are only read back by another tool
+    TGA,
+    PPM
+};
+
+struct ImageSequenceSettings
+{
+    // frames are written as "<directory>/<prefix>_<frame>.<extension>"
+    std::filesystem::path directory;
+    std::string prefix = "frame";
+    ImageFormat format = ImageFormat::PNG;
+
+    uint64_t fps = 60;
+    double start_time = 0;
+    double end_time = 0;
+
+    // draws on the cpu instead, for machines without a gpu
+    bool software_rendering = false;
+
+    // frames that look the same as in the last export to this folder aren't written again
+    bool incremental = true;
+
+
+    static const char* get_extension(ImageFormat format);
+};
+
+
+// runs on its own thread with the first export context, frames are compressed and
+// written on the thread pool while the next ones render. frames already written
+// are kept if it is stopped, and a hash of each one is kept next to them so the
+// next export only renders the frames that changed
+void export_image_sequence(ImageSequenceSettings settings, ExportScene scene, std::shared_ptr<ExportProgress> progress, std::shared_ptr<std::atomic_bool> stop);
+
+// rgba pixels, rows from the top. ppm has no alpha so it is dropped there
+bool write_image(const std::filesystem::path& path, ImageFormat format, glm::u64vec2 size, const uint8_t* pixels);
@@ -0,0 +1,173 @@
+// header
+#include "palette.hpp"
+
+// extern
+#include <glm/common.hpp>
+
+// builtin
+#include <algorithm>
+#include <limits>
+
+
+
+// a range of bins sorted along the axis the box was last split on
+struct Box
+{
+    size_t begin;
+    size_t end;
+
+    uint64_t count;
+    glm::u8vec3 minimum;
+    glm::u8vec3 maximum;
+
+    int get_widest_axis() const
+    {
+        auto range = this->maximum - this->minimum;
+
+        if (range.r >= range.g && range.r >= range.b)
+            return 0;
+        else if (range.g >= range.b)
+            return 1;
+        else
+            return 2;
+    }
+
+    uint64_t get_priority() const
+    {
+        auto axis = this->get_widest_axis();
+        return this->count * (uint64_t)(this->maximum[axis] - this->minimum[axis]);
+    }
+};
+
+
+static glm::u8vec3 get_bin_color(uint32_t bin)
+{
+    const uint32_t mask = (1 << ColorHistogram::BITS) - 1;
+    return glm::u8vec3{(uint8_t)((bin >> (ColorHistogram::BITS * 2)) & mask), (uint8_t)((bin >> ColorHistogram::BITS) & mask), (uint8_t)(bin & mask)};
+}
+
+static Box make_box(const std::vector<uint32_t>& bins, const std::vector<uint64_t>& counts, size_t begin, size_t end)
+{
+    Box box{begin, end, 0, {255, 255, 255}, {0, 0, 0}};
+
+    for (size_t i = begin; i < end; ++i)
+    {
+        auto color = get_bin_color(bins[i]);
+
+        box.count += counts[bins[i]];
+        box.minimum = glm::min(box.minimum, color);
+        box.maximum = glm::max(box.maximum, color);
+    }
+
+    return box;
+}
+
+
+
+ColorHistogram::ColorHistogram(): bins(BIN_COUNT)
+{
+}
+
+std::vector<glm::u8vec3> ColorHistogram::make_palette(size_t max_colors) const
+{
+    std::vector<uint32_t> used;
+    std::vector<uint64_t> counts(BIN_COUNT);
+
+    for (uint32_t i = 0; i < BIN_COUNT; ++i)
+    {
+        counts[i] = this->bins[i].count;
+
+        if (counts[i] > 0)
+            used.push_back(i);
+    }
+
+    if (used.empty())
+        return {};
+
+    std::vector<Box> boxes{make_box(used, counts, 0, used.size())};
+
+    while (boxes.size() < max_colors)
+    {
+        // boxes of a single bin can't be split anymore
+        auto box = std::max_element(boxes.begin(), boxes.end(), [](const Box& a, const Box& b)
+        {
+            return (a.end - a.begin > 1 ? a.get_priority() : 0) < (b.end - b.begin > 1 ? b.get_priority() : 0);
+        });
+
+        if (box->end - box->begin <= 1)
+            break;
+
+        auto axis = box->get_widest_axis();
+        std::sort(used.begin() + box->begin, used.begin() + box->end, [axis](uint32_t a, uint32_t b)
+        {
+            return get_bin_color(a)[axis] < get_bin_color(b)[axis];
+        });
+
+        // the bin holding the median pixel, keeping at least one bin on each side
+        uint64_t half = box->count / 2;
+        uint64_t seen = 0;
+        size_t split = box->begin + 1;
+
+        for (size_t i = box->begin; i < box->end - 1; ++i)
+        {
+            seen += counts[used[i]];
+            split = i + 1;
+
+            if (seen >= half)
+                break;
+        }
+
+        auto [begin, end] = std::pair{box->begin, box->end};
+        *box = make_box(used, counts, begin, split);
+        boxes.push_back(make_box(used, counts, split, end));
+    }
+
+    std::vector<glm::u8vec3> palette;
+
+    for (auto& box: boxes)
+    {
+        glm::u64vec3 sum = {0, 0, 0};
+        uint64_t count = 0;
+
+        for (size_t i = box.begin; i < box.end; ++i)
+        {
+            sum += this->bins[used[i]].sum;
+            count += this->bins[used[i]].count;
+        }
+
+        palette.push_back(glm::u8vec3{(sum + count / 2) / count});
+    }
+
+    return palette;
+}
+
+
+
+PaletteMapper::PaletteMapper(std::vector<glm::u8vec3> _palette): palette{std::move(_palette)}, cache(ColorHistogram::BIN_COUNT, -1)
+{
+}
+
+int16_t PaletteMapper::find_nearest(uint8_t r, uint8_t g, uint8_t b)
+{
+    int16_t nearest = 0;
+    int best = std::numeric_limits<int>::max();
+
+    for (size_t i = 0; i < this->palette.size(); ++i)
+    {
+        auto& color = this->palette[i];
+        int dr = (int)color.r - r;
+        int dg = (int)color.g - g;
+        int db = (int)color.b - b;
+
+        // weighted roughly by how sensitive the eye is to each channel
+        int distance = 2 * dr * dr + 4 * dg * dg + 3 * db * db;
+
+        if (distance < best)
+        {
+            best = distance;
+            nearest = (int16_t)i;
+        }
+    }
+
+    return nearest;
+}
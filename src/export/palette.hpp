@@ -0,0 +1,87 @@
+#pragma once
+
+
+// extern
+#include <glm/vec3.hpp>
+
+// builtin
+#include <array>
+#include <cstdint>
+#include <vector>
+
+
+
+// colors counted with 5 bits per channel, plenty to pick a palette from and small
+// enough that building one doesn't depend on the image size
+class ColorHistogram
+{
+    public:
+
+        static const uint32_t BITS = 5;
+        static const uint32_t BIN_COUNT = 1 << (BITS * 3);
+
+    private:
+
+        struct Bin
+        {
+            uint64_t count = 0;
+            glm::u64vec3 sum = {0, 0, 0};
+        };
+
+        std::vector<Bin> bins;
+
+    public:
+
+        ColorHistogram();
+
+        void add(uint8_t r, uint8_t g, uint8_t b)
+        {
+            auto& bin = this->bins[ColorHistogram::get_bin(r, g, b)];
+
+            bin.count += 1;
+            bin.sum += glm::u64vec3{r, g, b};
+        }
+
+        // median cut, boxes with the most pixels times the widest range are split first.
+        // colors are the average of the pixels in each box, not the center of the box
+        std::vector<glm::u8vec3> make_palette(size_t max_colors) const;
+
+        static uint32_t get_bin(uint8_t r, uint8_t g, uint8_t b)
+        {
+            const uint32_t shift = 8 - BITS;
+            return ((r >> shift) << (BITS * 2)) | ((g >> shift) << BITS) | (b >> shift);
+        }
+};
+
+
+// nearest palette color, remembered for every histogram bin the first time it is looked up
+class PaletteMapper
+{
+    private:
+
+        std::vector<glm::u8vec3> palette;
+        std::vector<int16_t> cache;
+
+    public:
+
+        PaletteMapper(std::vector<glm::u8vec3> palette);
+
+        uint8_t get_index(uint8_t r, uint8_t g, uint8_t b)
+        {
+            auto& index = this->cache[ColorHistogram::get_bin(r, g, b)];
+
+            if (index < 0)
+                index = this->find_nearest(r, g, b);
+
+            return (uint8_t)index;
+        }
+
+        const glm::u8vec3& get_color(uint8_t index)
+        {
+            return this->palette[index];
+        }
+
+    private:
+
+        int16_t find_nearest(uint8_t r, uint8_t g, uint8_t b);
+};
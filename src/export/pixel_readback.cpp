@@ -0,0 +1,110 @@
+// header
+#include "pixel_readback.hpp"
+
+// local
+#include "utils/asserts.hpp"
+
+// builtin
+#include <algorithm>
+#include <cstring>
+
+
+
+PixelReadback::PixelReadback(glm::u64vec2 size, GLenum format, size_t buffer_count): size{size}, format{format}
+{
+    leaf_assert(format == GL_RGBA || format == GL_RED);
+
+    // pixel buffers and glMapBufferRange are core since 3.0
+    if (!GLAD_GL_VERSION_3_0)
+        return;
+
+    this->buffers.resize(std::max<size_t>(buffer_count, 1));
+    glGenBuffers(this->buffers.size(), this->buffers.data());
+
+    for (auto buffer: this->buffers)
+    {
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glBufferData(GL_PIXEL_PACK_BUFFER, this->byte_size(), nullptr, GL_STREAM_READ);
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+PixelReadback::~PixelReadback()
+{
+    if (this->buffers.empty() == false)
+        glDeleteBuffers(this->buffers.size(), this->buffers.data());
+}
+
+
+void PixelReadback::start(Framebuffer& framebuffer, uint64_t index)
+{
+    leaf_assert(this->is_full() == false);
+
+    framebuffer.bind();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    if (this->buffers.empty())
+    {
+        Pending frame{index, 0, std::vector<uint8_t>(this->byte_size())};
+        glReadPixels(0, 0, this->size.x, this->size.y, this->format, GL_UNSIGNED_BYTE, frame.pixels.data());
+        this->pending.push_back(std::move(frame));
+    }
+    else
+    {
+        auto buffer = this->buffers[this->next_buffer];
+        this->next_buffer = (this->next_buffer + 1) % this->buffers.size();
+
+        // returns right away, the copy happens once the gpu gets to it
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer);
+        glReadPixels(0, 0, this->size.x, this->size.y, this->format, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+        this->pending.push_back(Pending{index, buffer, {}});
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+uint64_t PixelReadback::finish(uint8_t* output)
+{
+    leaf_assert(this->is_empty() == false);
+
+    auto frame = std::move(this->pending.front());
+    this->pending.pop_front();
+
+    if (this->buffers.empty())
+    {
+        memcpy(output, frame.pixels.data(), frame.pixels.size());
+        return frame.index;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, frame.buffer);
+
+    // only waits if the gpu hasn't finished the transfer yet
+    auto mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, this->byte_size(), GL_MAP_READ_BIT);
+    leaf_runtime_assert(mapped != nullptr, "could not map the readback buffer");
+
+    memcpy(output, mapped, this->byte_size());
+
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    return frame.index;
+}
+
+
+bool PixelReadback::is_full()
+{
+    return this->pending.size() >= std::max<size_t>(this->buffers.size(), 1);
+}
+
+bool PixelReadback::is_empty()
+{
+    return this->pending.empty();
+}
+
+uint64_t PixelReadback::byte_size()
+{
+    return this->size.x * this->size.y * (this->format == GL_RED ? 1 : 4);
+}
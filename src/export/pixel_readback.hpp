@@ -0,0 +1,57 @@
+#pragma once
+
+
+// local
+#include "graphical/graphics.hpp"
+#include "graphical/opengl/framebuffer.hpp"
+
+// extern
+#include <glm/vec2.hpp>
+
+// builtin
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+
+
+// reads frames back through a ring of pixel buffers, a frame is only mapped
+// once the next ones were submitted, so the transfer overlaps with rendering
+// instead of stalling the pipeline like a plain glReadPixels
+class PixelReadback
+{
+    private:
+
+        struct Pending
+        {
+            uint64_t index;
+            GLuint buffer;
+
+            // only used when pixel buffers are unavailable
+            std::vector<uint8_t> pixels;
+        };
+
+        glm::u64vec2 size;
+        GLenum format;
+        std::vector<GLuint> buffers;
+        size_t next_buffer = 0;
+        std::deque<Pending> pending;
+
+    public:
+
+        // "format" is GL_RGBA or GL_RED, always read as unsigned bytes
+        PixelReadback(glm::u64vec2 size, GLenum format, size_t buffer_count);
+        PixelReadback(const PixelReadback&) = delete;
+        PixelReadback& operator=(const PixelReadback&) = delete;
+        ~PixelReadback();
+
+        // queues the transfer of the framebuffer, "is_full" must be false
+        void start(Framebuffer& framebuffer, uint64_t index);
+
+        // copies the oldest frame into "output" and returns its index
+        uint64_t finish(uint8_t* output);
+
+        bool is_full();
+        bool is_empty();
+        uint64_t byte_size();
+};
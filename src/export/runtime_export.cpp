@@ -0,0 +1,165 @@
+// header
+#include "runtime_export.hpp"
+
+// local
+#include "animation/easings.hpp"
+#include "runtime/leaf_runtime.hpp"
+#include "utils/file_io.hpp"
+#include "utils/log.hpp"
+
+// builtin
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+#include <vector>
+
+
+
+namespace format = leaf_runtime::format;
+
+
+static float get_component(const Vector2Instant& instant, int component)
+{
+    return instant.vector[component];
+}
+
+static float get_component(const DoubleInstant& instant, int)
+{
+    return (float)instant.value;
+}
+
+static uint16_t quantize(double value, double minimum, double range)
+{
+    if (range <= 0)
+        return 0;
+
+    return (uint16_t)std::clamp(std::lround((value - minimum) / range * format::QUANTIZATION_STEPS), 0L, (long)format::QUANTIZATION_STEPS);
+}
+
+static uint8_t get_runtime_easing(Easing easing)
+{
+    // instants created without one are eased linearly by the runtime
+    return get_easing_id(easing).value_or((uint8_t)leaf_runtime::Easing::LINEAR);
+}
+
+// appends the keys of "instants", which are already sorted, and returns where they are
+template <typename Instant>
+static format::Track bake_track(const std::vector<Instant>& instants, int components, std::vector<format::Key>& keys)
+{
+    format::Track track{};
+    track.first_key = (uint32_t)keys.size();
+    track.key_count = (uint32_t)instants.size();
+
+    if (instants.empty())
+        return track;
+
+    track.start_time = (float)instants.front().time;
+    track.time_range = (float)(instants.back().time - instants.front().time);
+
+    for (int component = 0; component < components; ++component)
+    {
+        auto [minimum, maximum] = std::minmax_element(instants.begin(), instants.end(), [component](auto& a, auto& b)
+        {
+            return get_component(a, component) < get_component(b, component);
+        });
+
+        track.minimum[component] = get_component(*minimum, component);
+        track.range[component] = get_component(*maximum, component) - track.minimum[component];
+    }
+
+    for (auto& instant: instants)
+    {
+        format::Key key{};
+        key.time = quantize(instant.time, track.start_time, track.time_range);
+        key.easing = get_runtime_easing(instant.easing);
+
+        for (int component = 0; component < components; ++component)
+            key.value[component] = quantize(get_component(instant, component), track.minimum[component], track.range[component]);
+
+        keys.push_back(key);
+    }
+
+    return track;
+}
+
+
+void export_runtime_animation(RuntimeExportSettings settings, ExportScene scene, std::shared_ptr<ExportProgress> progress, std::shared_ptr<std::atomic_bool> stop)
+{
+    auto directory = std::filesystem::absolute(settings.path).parent_path();
+
+    std::vector<format::Node> nodes;
+    std::vector<format::Key> keys;
+    std::string strings;
+
+    // counted in nodes, there are no frames to count
+    progress->set_frame_count(scene.nodes.size());
+
+    for (size_t i = 0; i < scene.nodes.size() && stop->load() == false; ++i)
+    {
+        auto& node = scene.nodes[i];
+
+        // kept absolute when the sprite is on another drive than the file
+        std::error_code error;
+        auto sprite = std::filesystem::relative(node.texture_path, directory, error);
+        auto sprite_path = (error || sprite.empty()) ? node.texture_path : sprite.generic_string();
+
+        format::Node record{};
+        record.sprite_offset = (uint32_t)strings.size();
+        record.sprite_length = (uint32_t)sprite_path.size();
+        strings += sprite_path;
+
+        record.position[0] = node.position.x;
+        record.position[1] = node.position.y;
+        record.scale[0] = node.scale.x;
+        record.scale[1] = node.scale.y;
+        record.rotation = (float)node.rotation;
+        record.pivot[0] = node.rotation_pivot.x;
+        record.pivot[1] = node.rotation_pivot.y;
+
+        record.tracks[format::POSITION] = bake_track(node.keyframe.get_track<Track::POSITION>(), 2, keys);
+        record.tracks[format::SCALE] = bake_track(node.keyframe.get_track<Track::SCALE>(), 2, keys);
+        record.tracks[format::ROTATION] = bake_track(node.keyframe.get_track<Track::ROTATION>(), 1, keys);
+        record.tracks[format::PIVOT] = bake_track(node.keyframe.get_track<Track::PIVOT>(), 2, keys);
+
+        nodes.push_back(record);
+        progress->add_done_frames();
+    }
+
+    if (stop->load() == true)
+        return;
+
+    format::Header header{};
+    std::memcpy(header.magic, format::MAGIC, sizeof(format::MAGIC));
+    header.version = format::VERSION;
+    header.node_count = (uint32_t)nodes.size();
+    header.key_count = (uint32_t)keys.size();
+    header.string_bytes = (uint32_t)strings.size();
+    header.length = (float)settings.length;
+
+    std::vector<uint8_t> output(sizeof(header) + nodes.size() * sizeof(format::Node) + keys.size() * sizeof(format::Key) + strings.size());
+    auto cursor = output.data();
+
+    const auto append = [&cursor](const void* data, size_t size)
+    {
+        // memcpy with a null source is undefined even for zero bytes
+        if (size > 0)
+            std::memcpy(cursor, data, size);
+
+        cursor += size;
+    };
+
+    append(&header, sizeof(header));
+    append(nodes.data(), nodes.size() * sizeof(format::Node));
+    append(keys.data(), keys.size() * sizeof(format::Key));
+    append(strings.data(), strings.size());
+
+    if (try_write_file(settings.path.string(), output.data(), output.size()) == false)
+    {
+        progress->fail(fmt::format("could not write '{}'", settings.path.string()));
+        return;
+    }
+
+    notice(fmt::format("baked {} nodes and {} keys into {} bytes", nodes.size(), keys.size(), output.size()));
+    progress->finish();
+}
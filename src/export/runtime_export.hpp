@@ -0,0 +1,24 @@
+#pragma once
+
+
+// local
+#include "export_progress.hpp"
+#include "scene_render.hpp"
+
+// builtin
+#include <atomic>
+#include <filesystem>
+#include <memory>
+
+
+
+struct RuntimeExportSettings
+{
+    std::filesystem::path path;
+    double length = 0;
+};
+
+
+// bakes the nodes of "scene" into the binary format played by "leaf_runtime". tracks are
+// quantized to 16 bits over their own range, sprites are referenced relative to the file
+void export_runtime_animation(RuntimeExportSettings settings, ExportScene scene, std::shared_ptr<ExportProgress> progress, std::shared_ptr<std::atomic_bool> stop);
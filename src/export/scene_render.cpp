@@ -0,0 +1,172 @@
+// header
+#include "scene_render.hpp"
+
+// local
+#include "config.hpp"
+#include "node_tree.hpp"
+#include "animation/animation.hpp"
+#include "graphical/opengl/render.hpp"
+#include "graphical/software/render.hpp"
+#include "utils/hash.hpp"
+#include "utils/log.hpp"
+
+// builtin
+#include <functional>
+#include <unordered_set>
+
+
+
+// nodes in drawing order, "on_texture" is called once for every texture they use
+static ExportScene collect_nodes(std::function<void(ExportScene&, const std::string&)> on_texture)
+{
+    ExportScene output;
+    output.size = (glm::u64vec2)get_camera_area();
+
+    std::unordered_set<std::string> paths;
+
+    node_tree->run_on_nodes_ordered_reverse([&](Node& node)
+    {
+        if (node.texture_path.has_value() == false)
+            return;
+
+        if (node.visible == false)
+            return;
+
+        auto& path = node.texture_path.value();
+        if (paths.insert(path).second)
+            on_texture(output, path);
+
+        output.nodes.push_back(ExportNode{path, node.position, node.scale, node.rotation, node.rotation_pivot, node.keyframe});
+    });
+
+    return output;
+}
+
+ExportScene collect_export_scene()
+{
+    auto output = collect_nodes([](ExportScene& scene, const std::string& path)
+    {
+        auto& texture = sprite_manager.get_ready_sprite(path).texture;
+
+        // none when the file couldn't be loaded, drawn as nothing like on the cpu
+        scene.textures.emplace(path, texture);
+        scene.content_hashes.emplace(path, texture != nullptr ? texture->content_hash : 0);
+    });
+
+    output.fence = graphic_context.create_fence();
+
+    return output;
+}
+
+ExportScene collect_scene_nodes()
+{
+    return collect_nodes([](ExportScene&, const std::string&){});
+}
+
+ExportScene collect_software_export_scene()
+{
+    return collect_nodes([](ExportScene& scene, const std::string& path)
+    {
+        // drawn as nothing, like the placeholder of a sprite that can't be loaded
+        auto image = Image::decode(path);
+        if (image.has_value() == false)
+            warn(fmt::format("could not decode '{}'", path));
+
+        scene.images.emplace(path, image.value_or(Image{}));
+        scene.content_hashes.emplace(path, image.has_value() ? hash_bytes(image->pixels.get(), image->byte_size()) : 0);
+    });
+}
+
+void release_export_scene(ExportScene& scene)
+{
+    graphic_context.delete_fence(scene.fence);
+    scene.fence = nullptr;
+
+    scene.textures.clear();
+}
+
+void release_export_scene_with_context(ExportScene& scene)
+{
+    if (scene.fence == nullptr && scene.textures.empty())
+        return;
+
+    graphic_context.make_current_export_context(scene.first_context);
+    release_export_scene(scene);
+    graphic_context.release_current_context();
+}
+
+
+// transforms of a node animated to "time", from the values it had when the export started
+static ExportNode sample_pose(ExportNode& node, double time)
+{
+    ExportNode pose{node.texture_path, node.position, node.scale, node.rotation, node.rotation_pivot, {}};
+    animate(node.keyframe, pose.position, pose.rotation, pose.scale, pose.rotation_pivot, time);
+
+    return pose;
+}
+
+void render_scene(Framebuffer& framebuffer, double time, ExportScene& scene, glm::u8vec4 background)
+{
+    framebuffer.clear(background);
+
+    for (auto& node: scene.nodes)
+    {
+        auto& texture = scene.textures.at(node.texture_path);
+        if (texture == nullptr)
+            continue;
+
+        auto pose = sample_pose(node, time);
+
+        render_texture(
+            texture->id,
+            pose.position,
+            (glm::dvec2)texture->size * (glm::dvec2)pose.scale,
+            glm::degrees(pose.rotation),
+            {pose.rotation_pivot[0] + pose.position.x, pose.rotation_pivot[1] + pose.position.y},
+            framebuffer
+        );
+    }
+}
+
+void render_scene(SoftwareFramebuffer& framebuffer, double time, ExportScene& scene, glm::u8vec4 background)
+{
+    framebuffer.clear(background);
+
+    for (auto& node: scene.nodes)
+    {
+        auto pose = sample_pose(node, time);
+        auto& image = scene.images.at(node.texture_path);
+
+        render_image(
+            image,
+            pose.position,
+            (glm::dvec2)image.size * (glm::dvec2)pose.scale,
+            glm::degrees(pose.rotation),
+            {pose.rotation_pivot[0] + pose.position.x, pose.rotation_pivot[1] + pose.position.y},
+            framebuffer
+        );
+    }
+}
+
+uint64_t hash_frame(ExportScene& scene, double time)
+{
+    const auto hash_value = [](uint64_t hash, auto value)
+    {
+        return hash_combine(hash, hash_bytes(&value, sizeof(value)));
+    };
+
+    uint64_t hash = hash_value(0, scene.nodes.size());
+
+    for (auto& node: scene.nodes)
+    {
+        auto pose = sample_pose(node, time);
+
+        hash = hash_combine(hash, scene.content_hashes.at(node.texture_path));
+        hash = hash_value(hash, pose.position);
+        hash = hash_value(hash, pose.scale);
+        hash = hash_value(hash, pose.rotation);
+        hash = hash_value(hash, pose.rotation_pivot);
+    }
+
+    return hash;
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+
+// local
+#include "animation/keyframe.hpp"
+#include "graphical/graphics.hpp"
+#include "graphical/sprite.hpp"
+#include "graphical/image.hpp"
+#include "graphical/opengl/framebuffer.hpp"
+#include "graphical/software/framebuffer.hpp"
+
+// extern
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+// builtin
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+
+// copy of a visible node with a texture, taken when the export starts so render
+// threads animate their own copies instead of the tree being edited by the ui
+struct ExportNode
+{
+    std::string texture_path;
+
+    glm::vec2 position;
+    glm::vec2 scale;
+    double rotation;
+    glm::vec2 rotation_pivot;
+
+    KeyFrame keyframe;
+};
+
+struct ExportScene
+{
+    // in drawing order
+    std::vector<ExportNode> nodes;
+
+    // referenced so they outlive the ui freeing or evicting them
+    std::unordered_map<std::string, std::shared_ptr<Texture>> textures;
+
+    // decoded pixels instead of textures, when rendering on the cpu
+    std::unordered_map<std::string, Image> images;
+
+    // of the pixels of every texture, so editing an image invalidates the frames using it
+    std::unordered_map<std::string, uint64_t> content_hashes;
+
+    // waited on by every export context before sampling the textures
+    GLsync fence = nullptr;
+
+    // of the frames, the camera area when the scene was collected
+    glm::u64vec2 size = {0, 0};
+
+    // exports running at the same time each draw on their own range of export contexts,
+    // the first one used is this one
+    size_t first_context = 0;
+};
+
+
+// must be called from the ui thread, sprites that aren't resident yet are loaded
+ExportScene collect_export_scene();
+
+// only the nodes, for exports that reference the sprites instead of drawing them
+ExportScene collect_scene_nodes();
+
+// decodes every image again instead of using the sprites, so it needs no opengl context
+ExportScene collect_software_export_scene();
+
+// deletes the fence and drops the references to the textures, the last one deletes its
+// texture so both need an opengl context. exports call it before releasing theirs
+void release_export_scene(ExportScene& scene);
+
+// same on the first export context of the scene, for exports that return before using it
+void release_export_scene_with_context(ExportScene& scene);
+
+// draws the scene animated to "time" over "background", on whatever context is current.
+// each thread needs its own copy of the scene since the keyframes are read through it
+void render_scene(Framebuffer& framebuffer, double time, ExportScene& scene, glm::u8vec4 background = {255, 255, 255, 255});
+void render_scene(SoftwareFramebuffer& framebuffer, double time, ExportScene& scene, glm::u8vec4 background = {255, 255, 255, 255});
+
+// fingerprint of what "render_scene" draws at "time", equal hashes give the same image
+uint64_t hash_frame(ExportScene& scene, double time);
@@ -0,0 +1,370 @@
+// header
+#include "segmented_encoder.hpp"
+
+// local
+#include "utils/asserts.hpp"
+#include "utils/file_io.hpp"
+#include "utils/hash.hpp"
+#include "utils/log.hpp"
+
+// extern
+#include <fmt/core.h>
+#include <nlohmann/json.hpp>
+
+// builtin
+#include <algorithm>
+#include <cmath>
+#include <string_view>
+#include <system_error>
+
+
+
+static const int MANIFEST_VERSION = 1;
+static const char* MANIFEST_NAME = "manifest.json";
+
+
+// everything that changes the encoded packets besides the frames themselves
+static uint64_t hash_settings(const VideoSettings& settings, glm::u64vec2 size, uint64_t fps, uint64_t segment_frames)
+{
+    auto text = fmt::format("{}|{}|{}|{}|{}|{}|{}|{}x{}|{}|{}",
+        settings.profile_name, VideoEncoder::find_encoder(settings)->name, (int)settings.pixel_format,
+        settings.quality.value_or(-1), settings.bit_rate, settings.gop_size, settings.max_b_frames,
+        size.x, size.y, fps, segment_frames
+    );
+
+    text += "|" + settings.preset;
+    for (auto& [name, value]: settings.options)
+        text += fmt::format("|{}={}", name, value);
+
+    return hash_bytes(text.data(), text.size());
+}
+
+
+SegmentedEncoder::SegmentedEncoder(std::string _path, VideoSettings _settings, glm::u64vec2 _size, uint64_t _fps, double start_time, uint64_t _frame_count, ExportScene& scene):
+    path{std::move(_path)}, settings{std::move(_settings)}, size{_size}, fps{_fps}, frame_count{_frame_count}
+{
+    this->segmented = this->settings.segment_length > 0;
+    this->segment_frames = this->segmented ? SegmentedEncoder::get_segment_frames(this->settings, this->fps) : std::max<uint64_t>(this->frame_count, 1);
+    this->directory = SegmentedEncoder::get_segment_directory(this->path);
+
+    if (this->segmented == false)
+        return;
+
+    // hashing only animates the nodes, it is far cheaper than encoding a frame
+    auto settings_hash = hash_settings(this->settings, this->size, this->fps, this->segment_frames);
+    this->segment_hashes.assign(this->get_segment_count(), settings_hash);
+
+    for (uint64_t i = 0; i < this->frame_count; ++i)
+    {
+        auto& hash = this->segment_hashes[i / this->segment_frames];
+        hash = hash_combine(hash, hash_frame(scene, start_time + (double)i / this->fps));
+    }
+
+    std::error_code error;
+    std::filesystem::create_directories(this->directory, error);
+
+    if (error)
+    {
+        this->fail(fmt::format("could not create '{}': {}", this->directory.string(), error.message()));
+        return;
+    }
+
+    this->read_manifest();
+
+    // partial segments and the ones that can't be used anymore
+    for (auto& entry: std::filesystem::directory_iterator{this->directory, error})
+    {
+        if (entry.path().filename() == MANIFEST_NAME)
+            continue;
+
+        bool used = false;
+        for (uint64_t i = 0; i < this->get_segment_count() && used == false; ++i)
+            used = entry.path() == this->get_segment_path(i) && this->is_completed(i);
+
+        if (used == false)
+            std::filesystem::remove(entry.path(), error);
+    }
+
+    uint64_t reused = 0;
+    for (uint64_t i = 0; i < this->get_segment_count(); ++i)
+        reused += this->is_completed(i) ? 1 : 0;
+
+    if (reused > 0)
+        notice(fmt::format("resuming '{}', {} of {} segments are already encoded", this->path, reused, this->get_segment_count()));
+}
+
+SegmentedEncoder::~SegmentedEncoder()
+{
+    if (this->encoder.has_value() == false)
+        return;
+
+    // the muxer only completes the file in "finish", what is left is unusable
+    this->encoder.reset();
+
+    std::error_code error;
+    std::filesystem::remove(this->segmented ? this->get_segment_path(this->current_segment, true) : this->get_partial_path(), error);
+}
+
+
+std::vector<uint64_t> SegmentedEncoder::get_missing_frames()
+{
+    std::vector<uint64_t> output;
+
+    for (uint64_t i = 0; i < this->frame_count; ++i)
+        if (this->is_completed(i / this->segment_frames) == false)
+            output.push_back(i);
+
+    return output;
+}
+
+bool SegmentedEncoder::encode(VideoFrame frame)
+{
+    if (this->error.has_value())
+        return false;
+
+    auto segment = (uint64_t)frame->pts / this->segment_frames;
+
+    if (this->encoder.has_value() == false || segment != this->current_segment)
+    {
+        if (this->close_segment() == false || this->open_segment(segment) == false)
+            return false;
+    }
+
+    // every segment starts at 0, they are moved back in place when concatenated
+    frame->pts -= segment * this->segment_frames;
+
+    if (this->encoder->encode(std::move(frame)) == false)
+        return this->fail(fmt::format("could not encode '{}': {}", this->path, this->encoder->get_error().value()));
+
+    return true;
+}
+
+bool SegmentedEncoder::finish()
+{
+    if (this->error.has_value())
+        return false;
+
+    if (this->segmented == false)
+    {
+        // an empty video still gets its header and trailer
+        if (this->encoder.has_value() == false && this->open_segment(0) == false)
+            return false;
+
+        if (this->encoder->finish() == false)
+            return this->fail(fmt::format("could not complete '{}': {}", this->path, this->encoder->get_error().value()));
+
+        this->encoder.reset();
+
+        return this->complete_output();
+    }
+
+    if (this->close_segment() == false)
+        return false;
+
+    std::vector<std::filesystem::path> segments;
+    for (uint64_t i = 0; i < this->get_segment_count(); ++i)
+    {
+        // removed by hand while encoding, the next run encodes it again
+        if (this->is_completed(i) == false)
+            return this->fail(fmt::format("segment {} of '{}' is missing, export it again to encode it", i, this->path));
+
+        segments.push_back(this->get_segment_path(i));
+    }
+
+    if (auto error = VideoEncoder::concatenate(segments, this->get_partial_path().string(), this->settings, this->fps, this->segment_frames); error.has_value())
+    {
+        std::error_code remove_error;
+        std::filesystem::remove(this->get_partial_path(), remove_error);
+
+        return this->fail(error.value());
+    }
+
+    // the segments stay for the next try
+    if (this->complete_output() == false)
+        return false;
+
+    std::error_code error;
+    std::filesystem::remove_all(this->directory, error);
+
+    return true;
+}
+
+std::optional<std::string> SegmentedEncoder::get_error()
+{
+    return this->error;
+}
+
+
+glm::u64vec2 SegmentedEncoder::get_size()
+{
+    return VideoEncoder::get_frame_size(this->size);
+}
+
+AVPixelFormat SegmentedEncoder::get_pixel_format()
+{
+    return VideoEncoder::get_frame_pixel_format(this->settings);
+}
+
+
+uint64_t SegmentedEncoder::get_segment_frames(const VideoSettings& settings, uint64_t fps)
+{
+    // same default as the encoder, segments always start on a keyframe
+    uint64_t gop_size = settings.gop_size > 0 ? settings.gop_size : fps * 2;
+    auto intervals = (uint64_t)std::ceil(settings.segment_length * fps / gop_size);
+
+    return std::max<uint64_t>(intervals, 1) * gop_size;
+}
+
+std::filesystem::path SegmentedEncoder::get_segment_directory(const std::string& path)
+{
+    return path + ".segments";
+}
+
+
+
+bool SegmentedEncoder::open_segment(uint64_t segment)
+{
+    this->current_segment = segment;
+
+    auto output_path = this->segmented ? this->get_segment_path(segment, true) : this->get_partial_path();
+    this->encoder.emplace(output_path.string(), this->settings, this->size, this->fps);
+
+    // kept so the destructor removes what it may have created
+    if (auto error = this->encoder->get_error(); error.has_value())
+        return this->fail(fmt::format("could not write '{}': {}", output_path.string(), error.value()));
+
+    return true;
+}
+
+bool SegmentedEncoder::close_segment()
+{
+    if (this->encoder.has_value() == false)
+        return true;
+
+    if (this->encoder->finish() == false)
+        return this->fail(fmt::format("could not complete segment {} of '{}': {}", this->current_segment, this->path, this->encoder->get_error().value()));
+
+    this->encoder.reset();
+
+    // renamed once complete, a crash while writing it never leaves a segment that looks done
+    std::error_code error;
+    std::filesystem::rename(this->get_segment_path(this->current_segment, true), this->get_segment_path(this->current_segment), error);
+
+    if (error)
+        return this->fail(fmt::format("could not complete segment {} of '{}': {}", this->current_segment, this->path, error.message()));
+
+    this->completed[this->current_segment] = this->segment_hashes[this->current_segment];
+    return this->write_manifest();
+}
+
+
+bool SegmentedEncoder::complete_output()
+{
+    // a file already at "path" is only replaced by a complete video
+    std::error_code error;
+    std::filesystem::rename(this->get_partial_path(), this->path, error);
+
+    if (error)
+    {
+        auto message = fmt::format("could not replace '{}': {}", this->path, error.message());
+        std::filesystem::remove(this->get_partial_path(), error);
+
+        return this->fail(message);
+    }
+
+    return true;
+}
+
+
+bool SegmentedEncoder::is_completed(uint64_t segment)
+{
+    if (this->segmented == false)
+        return false;
+
+    auto entry = this->completed.find(segment);
+    return entry != this->completed.end() && entry->second == this->segment_hashes[segment] && std::filesystem::exists(this->get_segment_path(segment));
+}
+
+void SegmentedEncoder::read_manifest()
+{
+    auto content = try_read_file((this->directory / MANIFEST_NAME).string());
+    if (content.has_value() == false)
+        return;
+
+    auto json = nlohmann::json::parse(content.value(), nullptr, false);
+    if (json.is_discarded() || json.is_object() == false)
+        return;
+
+    auto version = json.find("version");
+    if (version == json.end() || version->is_number_integer() == false || version->get<int>() != MANIFEST_VERSION)
+        return;
+
+    // edited by hand or corrupted, every segment is encoded again
+    auto segments = json.find("segments");
+    if (segments == json.end() || segments->is_array() == false)
+        return;
+
+    for (auto& segment: *segments)
+        if (segment.is_array() == false || segment.size() != 2 || segment[0].is_number_unsigned() == false || segment[1].is_number_unsigned() == false)
+            return;
+
+    for (auto& segment: *segments)
+        this->completed.emplace(segment[0].get<uint64_t>(), segment[1].get<uint64_t>());
+}
+
+bool SegmentedEncoder::write_manifest()
+{
+    auto segments = nlohmann::json::array();
+    for (auto& [segment, hash]: this->completed)
+        segments.push_back({segment, hash});
+
+    auto json = nlohmann::json{
+        {"version", MANIFEST_VERSION},
+        {"output", this->path},
+        {"segment_frames", this->segment_frames},
+        {"segments", std::move(segments)}
+    }.dump();
+
+    // replaced in one step, so a crash leaves either manifest
+    auto manifest_path = this->directory / MANIFEST_NAME;
+    auto temporary_path = this->directory / fmt::format("{}.tmp", MANIFEST_NAME);
+
+    if (try_write_file(temporary_path.string(), json.data(), json.size()) == false)
+        return this->fail(fmt::format("could not write '{}'", temporary_path.string()));
+
+    std::error_code error;
+    std::filesystem::rename(temporary_path, manifest_path, error);
+
+    if (error)
+        return this->fail(fmt::format("could not write '{}': {}", manifest_path.string(), error.message()));
+
+    return true;
+}
+
+bool SegmentedEncoder::fail(std::string message)
+{
+    if (this->error.has_value() == false)
+        this->error = std::move(message);
+
+    return false;
+}
+
+
+uint64_t SegmentedEncoder::get_segment_count()
+{
+    return (this->frame_count + this->segment_frames - 1) / this->segment_frames;
+}
+
+std::filesystem::path SegmentedEncoder::get_segment_path(uint64_t segment, bool partial)
+{
+    // same container as the output, so the packets need no conversion to be remuxed
+    auto extension = std::filesystem::path{this->path}.extension().string();
+    return this->directory / fmt::format("segment_{:05}{}{}", segment, partial ? ".partial" : "", extension);
+}
+
+std::filesystem::path SegmentedEncoder::get_partial_path()
+{
+    // the extension is kept, it picks the container
+    auto extension = std::filesystem::path{this->path}.extension().string();
+    return std::filesystem::path{this->path}.replace_extension(".partial" + extension);
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+
+// local
+#include "scene_render.hpp"
+#include "video_encoder.hpp"
+#include "video_settings.hpp"
+
+// extern
+#include <glm/vec2.hpp>
+
+// builtin
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+
+// writes an export as segments of whole keyframe intervals, each encoded to its own file
+// in "<path>.segments" next to a manifest of the completed ones. an export stopped or
+// crashed halfway only encodes the segments that are missing, or whose frames changed,
+// the next time. once every segment is there they are remuxed into "path" and removed.
+// with "segment_length" 0 there is a single segment. either way the video is written
+// next to "path" and only replaces it once complete
+class SegmentedEncoder
+{
+    private:
+
+        std::string path;
+        VideoSettings settings;
+        glm::u64vec2 size;
+        uint64_t fps;
+        uint64_t frame_count;
+
+        uint64_t segment_frames;
+        bool segmented;
+        std::filesystem::path directory;
+
+        // of the settings and the scene at each frame of the segment
+        std::vector<uint64_t> segment_hashes;
+
+        // as read from the manifest, segment number to the hash it was encoded with
+        std::unordered_map<uint64_t, uint64_t> completed;
+
+        std::optional<VideoEncoder> encoder;
+        uint64_t current_segment = 0;
+
+        // of the first file that couldn't be written, nothing is written after it
+        std::optional<std::string> error;
+
+    public:
+
+        // the scene is only animated to hash the frames, "size" is the one of the scene
+        SegmentedEncoder(std::string path, VideoSettings settings, glm::u64vec2 size, uint64_t fps, double start_time, uint64_t frame_count, ExportScene& scene);
+        SegmentedEncoder(const SegmentedEncoder&) = delete;
+        SegmentedEncoder& operator=(const SegmentedEncoder&) = delete;
+
+        // removes the segment or video being written, the completed segments stay for the next time
+        ~SegmentedEncoder();
+
+        // in order, the frames of the segments still to encode
+        std::vector<uint64_t> get_missing_frames();
+
+        // frames must come in order and their pts is their number in the whole export.
+        // false once a file couldn't be written, see "get_error"
+        bool encode(VideoFrame frame);
+
+        // completes the last segment and remuxes them all into the output, false on error
+        bool finish();
+
+        // set when the segment directory, a segment, the manifest or the output couldn't
+        // be written, also by the constructor
+        std::optional<std::string> get_error();
+
+        glm::u64vec2 get_size();
+        AVPixelFormat get_pixel_format();
+
+        // frames per segment, rounded up to whole keyframe intervals
+        static uint64_t get_segment_frames(const VideoSettings& settings, uint64_t fps);
+        static std::filesystem::path get_segment_directory(const std::string& path);
+
+    private:
+
+        bool open_segment(uint64_t segment);
+        bool close_segment();
+        bool complete_output();
+
+        bool is_completed(uint64_t segment);
+        void read_manifest();
+        bool write_manifest();
+
+        // always false, for returning it
+        bool fail(std::string message);
+
+        uint64_t get_segment_count();
+        std::filesystem::path get_partial_path();
+        std::filesystem::path get_segment_path(uint64_t segment, bool partial = false);
+};
@@ -0,0 +1,315 @@
+// header
+#include "spritesheet.hpp"
+
+// local
+#include "export/image_sequence.hpp"
+#include "export/pixel_readback.hpp"
+#include "graphical/software/framebuffer.hpp"
+#include "utils/file_io.hpp"
+#include "utils/hash.hpp"
+#include "utils/log.hpp"
+#include "utils/rect_packer.hpp"
+#include "utils/thread_pool.hpp"
+
+// extern
+#include <nlohmann/json.hpp>
+
+// builtin
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+
+
+static const size_t READBACK_BUFFER_COUNT = 3;
+static const size_t TASKS_PER_POOL_THREAD = 2;
+
+static const int MANIFEST_VERSION = 1;
+
+
+// the visible part of a frame, with straight alpha
+struct TrimmedFrame
+{
+    // top left of "image" inside the full frame
+    glm::u64vec2 offset = {0, 0};
+    Image image;
+    uint64_t hash = 0;
+};
+
+
+// the frame is premultiplied since it was drawn over a transparent background
+static TrimmedFrame trim_frame(std::vector<uint8_t>& pixels, glm::u64vec2 size)
+{
+    glm::u64vec2 min = size;
+    glm::u64vec2 max = {0, 0};
+
+    for (uint64_t y = 0; y < size.y; ++y)
+    {
+        auto row = pixels.data() + y * size.x * Image::CHANNELS;
+
+        for (uint64_t x = 0; x < size.x; ++x)
+        {
+            auto pixel = row + x * Image::CHANNELS;
+            auto alpha = pixel[3];
+
+            if (alpha == 0)
+                continue;
+
+            if (alpha != 255)
+                for (int channel = 0; channel < 3; ++channel)
+                    pixel[channel] = (uint8_t)std::min((pixel[channel] * 255 + alpha / 2) / alpha, 255);
+
+            min = {std::min(min.x, x), std::min(min.y, y)};
+            max = {std::max(max.x, x + 1), std::max(max.y, y + 1)};
+        }
+    }
+
+    TrimmedFrame output;
+
+    // nothing visible, an empty rect
+    if (min.x >= max.x || min.y >= max.y)
+        return output;
+
+    output.offset = min;
+    output.image = Image::allocate(max - min);
+
+    const auto row_size = output.image.size.x * Image::CHANNELS;
+
+    for (uint64_t y = 0; y < output.image.size.y; ++y)
+        std::memcpy(output.image.pixels.get() + y * row_size, pixels.data() + ((min.y + y) * size.x + min.x) * Image::CHANNELS, row_size);
+
+    output.hash = hash_combine(hash_bytes(output.image.pixels.get(), output.image.byte_size()), hash_bytes(&output.image.size, sizeof(output.image.size)));
+
+    return output;
+}
+
+static bool same_pixels(const TrimmedFrame& a, const TrimmedFrame& b)
+{
+    return a.hash == b.hash
+        && a.image.size == b.image.size
+        && std::memcmp(a.image.pixels.get(), b.image.pixels.get(), a.image.byte_size()) == 0;
+}
+
+
+// returns false if it was stopped or the frames don't fit in the atlas
+static bool write_spritesheet(const SpritesheetSettings& settings, ExportScene& scene, std::shared_ptr<ExportProgress> progress, std::shared_ptr<std::atomic_bool> stop)
+{
+    const auto frame_count = (uint64_t)std::ceil((settings.end_time - settings.start_time) * settings.fps);
+    const auto size = scene.size;
+    const auto export_start = std::chrono::steady_clock::now();
+
+    const auto get_time = [&](uint64_t index){ return settings.start_time + (double)index / settings.fps; };
+
+    // frames with the same scene are the same image, they aren't even rendered
+    std::vector<uint64_t> source(frame_count);
+    std::unordered_map<uint64_t, uint64_t> first_with_hash;
+
+    for (uint64_t i = 0; i < frame_count; ++i)
+        source[i] = first_with_hash.emplace(hash_frame(scene, get_time(i)), i).first->second;
+
+    // packing and writing the atlas come after, they are quick next to the frames
+    progress->set_frame_count(first_with_hash.size());
+
+    std::vector<TrimmedFrame> frames(frame_count);
+    std::deque<std::future<void>> tasks;
+
+    const size_t max_tasks = thread_pool.get_thread_count() * TASKS_PER_POOL_THREAD;
+
+    // the rendering stays one frame ahead of the trimming on the pool
+    const auto trim = [&](uint64_t index, std::vector<uint8_t> pixels)
+    {
+        while (tasks.size() >= max_tasks)
+        {
+            tasks.front().get();
+            tasks.pop_front();
+        }
+
+        tasks.push_back(thread_pool.submit([&, index, pixels = std::move(pixels)]() mutable
+        {
+            frames[index] = trim_frame(pixels, size);
+            progress->add_done_frames();
+        }));
+    };
+
+    if (settings.software_rendering)
+    {
+        auto framebuffer = SoftwareFramebuffer{size.x, size.y};
+        framebuffer.set_premultiplied(true);
+
+        for (uint64_t i = 0; i < frame_count && stop->load() == false; ++i)
+        {
+            if (source[i] != i)
+                continue;
+
+            render_scene(framebuffer, get_time(i), scene, {0, 0, 0, 0});
+
+            auto pixels = framebuffer.get_pixels();
+            trim(i, std::vector<uint8_t>(pixels, pixels + size.x * size.y * Image::CHANNELS));
+        }
+    }
+    else
+    {
+        graphic_context.make_current_export_context(scene.first_context);
+        graphic_context.wait_fence(scene.fence);
+
+        {
+            auto framebuffer = Framebuffer{size.x, size.y};
+            framebuffer.set_premultiplied(true);
+
+            auto readback = PixelReadback{size, GL_RGBA, READBACK_BUFFER_COUNT};
+
+            const auto take_oldest_frame = [&]()
+            {
+                std::vector<uint8_t> pixels(readback.byte_size());
+                auto index = readback.finish(pixels.data());
+                trim(index, std::move(pixels));
+            };
+
+            for (uint64_t i = 0; i < frame_count && stop->load() == false; ++i)
+            {
+                if (source[i] != i)
+                    continue;
+
+                render_scene(framebuffer, get_time(i), scene, {0, 0, 0, 0});
+                readback.start(framebuffer, i);
+
+                if (readback.is_full())
+                    take_oldest_frame();
+            }
+
+            while (readback.is_empty() == false && stop->load() == false)
+                take_oldest_frame();
+        }
+
+        release_export_scene(scene);
+        graphic_context.release_current_context();
+    }
+
+    for (auto& task: tasks)
+        task.get();
+
+    if (stop->load() == true)
+        return false;
+
+
+    // different scenes can still give the same pixels, like a node moving while hidden behind another
+    std::vector<uint64_t> unique_frames;
+    std::unordered_map<uint64_t, std::vector<uint64_t>> unique_by_hash;
+
+    for (uint64_t i = 0; i < frame_count; ++i)
+    {
+        if (source[i] != i)
+            continue;
+
+        auto& candidates = unique_by_hash[frames[i].hash];
+        auto same = std::find_if(candidates.begin(), candidates.end(), [&](uint64_t other){ return same_pixels(frames[i], frames[other]); });
+
+        if (same != candidates.end())
+            source[i] = *same;
+        else
+        {
+            candidates.push_back(i);
+            unique_frames.push_back(i);
+        }
+    }
+
+    // duplicates of a frame that turned out to be a duplicate itself
+    for (uint64_t i = 0; i < frame_count; ++i)
+        source[i] = source[source[i]];
+
+    std::vector<glm::u64vec2> rects;
+    for (auto index: unique_frames)
+        rects.push_back(frames[index].image.size);
+
+    auto packing = RectPacker::pack(rects, settings.padding, settings.max_side);
+    if (packing.has_value() == false)
+    {
+        progress->fail(fmt::format("{} frames don't fit in a {}x{} atlas", unique_frames.size(), settings.max_side, settings.max_side));
+        return false;
+    }
+
+    // every frame has its own rect, so they are copied in parallel
+    auto atlas = std::vector<uint8_t>(packing->size.x * packing->size.y * Image::CHANNELS, 0);
+    std::vector<std::future<void>> copies;
+
+    for (size_t i = 0; i < unique_frames.size(); ++i)
+    {
+        copies.push_back(thread_pool.submit([&, i]()
+        {
+            auto& image = frames[unique_frames[i]].image;
+            auto position = packing->positions[i];
+            const auto row_size = image.size.x * Image::CHANNELS;
+
+            for (uint64_t y = 0; y < image.size.y; ++y)
+                std::memcpy(atlas.data() + ((position.y + y) * packing->size.x + position.x) * Image::CHANNELS, image.pixels.get() + y * row_size, row_size);
+        }));
+    }
+
+    for (auto& copy: copies)
+        copy.get();
+
+    if (write_image(settings.path, ImageFormat::PNG, packing->size, atlas.data()) == false)
+    {
+        progress->fail(fmt::format("could not write '{}'", settings.path.string()));
+        return false;
+    }
+
+
+    std::unordered_map<uint64_t, size_t> rect_of_frame;
+    for (size_t i = 0; i < unique_frames.size(); ++i)
+        rect_of_frame[unique_frames[i]] = i;
+
+    auto manifest_frames = nlohmann::json::array();
+    for (uint64_t i = 0; i < frame_count; ++i)
+    {
+        auto rect = rect_of_frame.at(source[i]);
+        auto& frame = frames[source[i]];
+
+        manifest_frames.push_back({
+            {"rect", {packing->positions[rect].x, packing->positions[rect].y, frame.image.size.x, frame.image.size.y}},
+            {"offset", {frame.offset.x, frame.offset.y}},
+            {"time", get_time(i)}
+        });
+    }
+
+    auto manifest = nlohmann::json{
+        {"version", MANIFEST_VERSION},
+        {"image", settings.path.filename().string()},
+        {"size", {packing->size.x, packing->size.y}},
+        {"frame_size", {size.x, size.y}},
+        {"fps", settings.fps},
+        {"frames", std::move(manifest_frames)}
+    }.dump(4);
+
+    auto manifest_path = std::filesystem::path{settings.path}.replace_extension(".json");
+    if (try_write_file(manifest_path.string(), manifest.data(), manifest.size()) == false)
+    {
+        progress->fail(fmt::format("could not write '{}'", manifest_path.string()));
+        return false;
+    }
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - export_start).count();
+    notice(fmt::format("packed {} frames ({} unique) into a {}x{} atlas in {:.2f}s",
+        frame_count, unique_frames.size(), packing->size.x, packing->size.y, elapsed));
+
+    return true;
+}
+
+
+void export_spritesheet(SpritesheetSettings settings, ExportScene scene, std::shared_ptr<ExportProgress> progress, std::shared_ptr<std::atomic_bool> stop)
+{
+    // failures were already reported to "progress"
+    bool written = write_spritesheet(settings, scene, progress, stop);
+
+    // it returns before making the context current when it fails early
+    release_export_scene_with_context(scene);
+
+    if (written)
+        progress->finish();
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+
+// local
+#include "export_progress.hpp"
+#include "scene_render.hpp"
+
+// builtin
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+
+
+struct SpritesheetSettings
+{
+    // the atlas, the manifest is written next to it with a ".json" extension
+    std::filesystem::path path;
+
+    uint64_t fps = 30;
+    double start_time = 0;
+    double end_time = 0;
+
+    // transparent pixels around each frame, so filtering doesn't bleed between them
+    uint64_t padding = 2;
+    uint64_t max_side = 8192;
+
+    // draws on the cpu instead, for machines without a gpu
+    bool software_rendering = false;
+};
+
+
+// runs on its own thread with the first export context. every frame is rendered over a
+// transparent background, trimmed to its visible pixels and packed into one atlas, frames
+// that look the same share their rect. the manifest lists the rect of every frame, and
+// where it goes back in the full frame
+void export_spritesheet(SpritesheetSettings settings, ExportScene scene, std::shared_ptr<ExportProgress> progress, std::shared_ptr<std::atomic_bool> stop);
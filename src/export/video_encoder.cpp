@@ -0,0 +1,389 @@
+// header
+#include "video_encoder.hpp"
+
+// local
+#include "utils/asserts.hpp"
+#include "utils/log.hpp"
+
+// extern
+extern "C" {
+    #include <libavutil/dict.h>
+    #include <libavutil/opt.h>
+}
+
+// builtin
+#include <filesystem>
+#include <string_view>
+
+
+
+VideoEncoder::VideoEncoder(const std::string& path, const VideoSettings& settings, glm::u64vec2 size, uint64_t fps)
+{
+    int ret = avformat_alloc_output_context2(&this->format_context, nullptr, nullptr, path.c_str());
+    if (ret < 0 || this->format_context == nullptr)
+    {
+        this->fail(fmt::format("no container format matches '{}': {}", path, VideoEncoder::get_error_message(ret)));
+        return;
+    }
+
+    this->codec = VideoEncoder::find_encoder(settings);
+    if (this->codec == nullptr)
+    {
+        this->fail(fmt::format("no encoder for '{}' is available", settings.profile_name));
+        return;
+    }
+
+    this->context = avcodec_alloc_context3(this->codec);
+    leaf_runtime_assert(this->context != nullptr);
+
+    this->packet = av_packet_alloc();
+    leaf_runtime_assert(this->packet != nullptr);
+
+    auto frame_size = VideoEncoder::get_frame_size(size);
+    this->context->width = frame_size.x;
+    this->context->height = frame_size.y;
+    this->context->time_base = AVRational{1, (int)fps};
+    this->context->framerate = AVRational{(int)fps, 1};
+    this->context->gop_size = settings.gop_size > 0 ? settings.gop_size : (int)fps * 2;
+    this->context->max_b_frames = settings.max_b_frames;
+    this->context->pix_fmt = VideoEncoder::get_frame_pixel_format(settings);
+
+    this->context->thread_count = settings.thread_count;
+    this->context->thread_type = settings.slice_threading ? FF_THREAD_SLICE : FF_THREAD_FRAME | FF_THREAD_SLICE;
+
+    for (auto& [name, value]: settings.options)
+        if (av_opt_set(this->context->priv_data, name.c_str(), value.c_str(), 0) < 0)
+            warn(fmt::format("encoder '{}' has no option '{}'", this->codec->name, name));
+
+    if (settings.preset.empty() == false && av_opt_set(this->context->priv_data, "preset", settings.preset.c_str(), 0) < 0)
+        warn(fmt::format("encoder '{}' has no preset '{}'", this->codec->name, settings.preset));
+
+    this->context->bit_rate = settings.bit_rate;
+
+    if (settings.quality.has_value() && av_opt_set_int(this->context->priv_data, "crf", settings.quality.value(), 0) < 0)
+    {
+        // about 0.1 bits per pixel, plenty for flat 2d animation
+        if (this->context->bit_rate == 0)
+            this->context->bit_rate = (int64_t)this->context->width * this->context->height * fps / 10;
+
+        warn(fmt::format("encoder '{}' has no constant quality mode, using {} kbit/s instead", this->codec->name, this->context->bit_rate / 1000));
+    }
+
+    // mp4 and mov keep the codec headers in the container instead of in every keyframe
+    if (this->format_context->oformat->flags & AVFMT_GLOBALHEADER)
+        this->context->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    ret = avcodec_open2(this->context, this->codec, NULL);
+    if (ret < 0)
+    {
+        this->fail(fmt::format("could not open encoder '{}': {}", this->codec->name, VideoEncoder::get_error_message(ret)));
+        return;
+    }
+
+    this->stream = avformat_new_stream(this->format_context, nullptr);
+    leaf_runtime_assert(this->stream != nullptr);
+
+    this->stream->time_base = this->context->time_base;
+    this->stream->avg_frame_rate = this->context->framerate;
+    leaf_runtime_assert(avcodec_parameters_from_context(this->stream->codecpar, this->context) >= 0);
+
+    if (auto error = VideoEncoder::open_output(this->format_context, path, settings.muxer_options); error.has_value())
+        this->fail(error.value());
+}
+
+VideoEncoder::~VideoEncoder()
+{
+    // whatever the constructor got to before failing
+    if (this->format_context != nullptr && (this->format_context->oformat->flags & AVFMT_NOFILE) == 0)
+        avio_closep(&this->format_context->pb);
+
+    avformat_free_context(this->format_context);
+    avcodec_free_context(&this->context);
+    av_packet_free(&this->packet);
+}
+
+
+VideoFrame VideoEncoder::allocate_frame()
+{
+    return VideoEncoder::allocate_frame(this->get_size(), this->context->pix_fmt);
+}
+
+VideoFrame VideoEncoder::allocate_frame(glm::u64vec2 size, AVPixelFormat pixel_format)
+{
+    VideoFrame frame{av_frame_alloc()};
+    leaf_runtime_assert(frame != nullptr);
+
+    frame->format = pixel_format;
+    frame->width = size.x;
+    frame->height = size.y;
+
+    leaf_runtime_assert(av_frame_get_buffer(frame.get(), 0) >= 0);
+
+    return frame;
+}
+
+bool VideoEncoder::encode(VideoFrame frame)
+{
+    if (this->error.has_value())
+        return false;
+
+    // the codec keeps its own reference to the buffers it still needs
+    return this->send(frame.get());
+}
+
+bool VideoEncoder::finish()
+{
+    leaf_assert(this->finished == false);
+
+    if (this->error.has_value() || this->send(nullptr) == false)
+        return false;
+
+    int ret = av_write_trailer(this->format_context);
+    if (ret < 0)
+        return this->fail(fmt::format("could not complete the video: {}", VideoEncoder::get_error_message(ret)));
+
+    this->finished = true;
+    return true;
+}
+
+std::optional<std::string> VideoEncoder::get_error()
+{
+    return this->error;
+}
+
+
+glm::u64vec2 VideoEncoder::get_size()
+{
+    return {this->context->width, this->context->height};
+}
+
+AVPixelFormat VideoEncoder::get_pixel_format()
+{
+    return this->context->pix_fmt;
+}
+
+
+std::optional<std::string> VideoEncoder::validate(const std::string& path, const VideoSettings& settings)
+{
+    auto format = av_guess_format(nullptr, path.c_str(), nullptr);
+    if (format == nullptr)
+        return fmt::format("no container format matches '{}'", std::filesystem::path{path}.extension().string());
+
+    auto codec = VideoEncoder::find_encoder(settings);
+    if (codec == nullptr)
+        return fmt::format("this build has no encoder for {}", settings.profile_name);
+
+    if (avformat_query_codec(format, codec->id, FF_COMPLIANCE_NORMAL) != 1)
+        return fmt::format("{} can't be stored in a {} file", settings.profile_name, format->name);
+
+    // the webp muxer writes the whole animation as one packet, it can't be remuxed from pieces
+    if (settings.segment_length > 0 && std::string_view{format->name} == "webp")
+        return "animated webp can't be exported in segments";
+
+    return std::nullopt;
+}
+
+const AVCodec* VideoEncoder::find_encoder(const VideoSettings& settings)
+{
+    for (auto& name: settings.encoders)
+        if (auto codec = avcodec_find_encoder_by_name(name.c_str()); codec != nullptr)
+            return codec;
+
+    return nullptr;
+}
+
+glm::u64vec2 VideoEncoder::get_frame_size(glm::u64vec2 size)
+{
+    // resolution must be a multiple of two
+    return {size.x + ((size.x % 2 == 0) ? 0 : 1), size.y + ((size.y % 2 == 0) ? 0 : 1)};
+}
+
+AVPixelFormat VideoEncoder::get_frame_pixel_format(const VideoSettings& settings)
+{
+    auto codec = VideoEncoder::find_encoder(settings);
+    leaf_runtime_assert(codec != nullptr, fmt::format("no encoder for '{}' is available", settings.profile_name));
+
+    // frames from the pipeline are converted to whatever the encoder takes
+    if (VideoEncoder::supports_pixel_format(codec, settings.pixel_format) == false && codec->pix_fmts != nullptr)
+        return codec->pix_fmts[0];
+
+    return settings.pixel_format;
+}
+
+std::optional<std::string> VideoEncoder::concatenate(const std::vector<std::filesystem::path>& segments, const std::string& path, const VideoSettings& settings, uint64_t fps, uint64_t segment_frames)
+{
+    leaf_runtime_assert(segments.empty() == false);
+
+    AVFormatContext* output = nullptr;
+    int ret = avformat_alloc_output_context2(&output, nullptr, nullptr, path.c_str());
+    if (ret < 0 || output == nullptr)
+        return fmt::format("no container format matches '{}': {}", path, VideoEncoder::get_error_message(ret));
+
+    AVFormatContext* input = nullptr;
+    AVStream* output_stream = nullptr;
+    AVPacket* packet = av_packet_alloc();
+    leaf_runtime_assert(packet != nullptr);
+
+    // everything is released whether it worked or not
+    const auto close = [&](std::optional<std::string> error)
+    {
+        avformat_close_input(&input);
+
+        if ((output->oformat->flags & AVFMT_NOFILE) == 0)
+            avio_closep(&output->pb);
+
+        avformat_free_context(output);
+        av_packet_free(&packet);
+
+        return error;
+    };
+
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+        auto segment_path = segments[i].string();
+
+        ret = avformat_open_input(&input, segment_path.c_str(), nullptr, nullptr);
+        if (ret < 0)
+            return close(fmt::format("could not open the segment '{}': {}", segment_path, VideoEncoder::get_error_message(ret)));
+
+        ret = avformat_find_stream_info(input, nullptr);
+        if (ret < 0 || input->nb_streams != 1)
+            return close(fmt::format("'{}' isn't a segment of this video", segment_path));
+
+        auto input_stream = input->streams[0];
+
+        // the codec headers are the first segment's, the others were encoded the same way
+        if (output_stream == nullptr)
+        {
+            output_stream = avformat_new_stream(output, nullptr);
+            leaf_runtime_assert(output_stream != nullptr);
+            leaf_runtime_assert(avcodec_parameters_copy(output_stream->codecpar, input_stream->codecpar) >= 0);
+
+            // the tag of the segment's container may not exist in the output's
+            output_stream->codecpar->codec_tag = 0;
+            output_stream->time_base = AVRational{1, (int)fps};
+            output_stream->avg_frame_rate = AVRational{(int)fps, 1};
+
+            if (auto error = VideoEncoder::open_output(output, path, settings.muxer_options); error.has_value())
+                return close(error);
+        }
+
+        // every segment starts at 0, b-frames delay the dts by the same amount in each one
+        // so they stay increasing across the boundaries
+        auto offset = av_rescale_q(i * segment_frames, AVRational{1, (int)fps}, output_stream->time_base);
+
+        while ((ret = av_read_frame(input, packet)) >= 0)
+        {
+            av_packet_rescale_ts(packet, input_stream->time_base, output_stream->time_base);
+
+            if (packet->pts != AV_NOPTS_VALUE)
+                packet->pts += offset;
+
+            if (packet->dts != AV_NOPTS_VALUE)
+                packet->dts += offset;
+
+            packet->stream_index = output_stream->index;
+
+            ret = av_interleaved_write_frame(output, packet);
+            if (ret < 0)
+                return close(fmt::format("error while writing a packet of '{}': {}", segment_path, VideoEncoder::get_error_message(ret)));
+        }
+
+        if (ret != AVERROR_EOF)
+            return close(fmt::format("error while reading '{}': {}", segment_path, VideoEncoder::get_error_message(ret)));
+
+        avformat_close_input(&input);
+    }
+
+    ret = av_write_trailer(output);
+    if (ret < 0)
+        return close(fmt::format("could not complete the video: {}", VideoEncoder::get_error_message(ret)));
+
+    return close(std::nullopt);
+}
+
+
+std::optional<std::string> VideoEncoder::open_output(AVFormatContext* format_context, const std::string& path, const std::map<std::string, std::string>& muxer_options)
+{
+    int ret = 0;
+
+    if ((format_context->oformat->flags & AVFMT_NOFILE) == 0)
+    {
+        ret = avio_open(&format_context->pb, path.c_str(), AVIO_FLAG_WRITE);
+        if (ret < 0)
+            return fmt::format("could not open '{}': {}", path, VideoEncoder::get_error_message(ret));
+    }
+
+    AVDictionary* options = nullptr;
+    for (auto& [name, value]: muxer_options)
+        av_dict_set(&options, name.c_str(), value.c_str(), 0);
+
+    // the muxer may pick another time base for the stream, packets are rescaled to it
+    ret = avformat_write_header(format_context, &options);
+
+    // whatever is left wasn't used by the muxer
+    for (AVDictionaryEntry* entry = nullptr; (entry = av_dict_get(options, "", entry, AV_DICT_IGNORE_SUFFIX)) != nullptr;)
+        warn(fmt::format("container '{}' has no option '{}'", format_context->oformat->name, entry->key));
+
+    av_dict_free(&options);
+
+    if (ret < 0)
+        return fmt::format("could not write the header of '{}': {}", path, VideoEncoder::get_error_message(ret));
+
+    return std::nullopt;
+}
+
+bool VideoEncoder::send(const AVFrame* frame)
+{
+    int ret = avcodec_send_frame(this->context, frame);
+    if (ret < 0)
+        return this->fail(fmt::format("error while sending a frame to the encoder: {}", VideoEncoder::get_error_message(ret)));
+
+    while (true)
+    {
+        ret = avcodec_receive_packet(this->context, this->packet);
+
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+            return true;
+
+        if (ret < 0)
+            return this->fail(fmt::format("error while encoding a frame: {}", VideoEncoder::get_error_message(ret)));
+
+        av_packet_rescale_ts(this->packet, this->context->time_base, this->stream->time_base);
+        this->packet->stream_index = this->stream->index;
+
+        // buffers packets as needed to interleave them by dts, taking ownership of their data
+        ret = av_interleaved_write_frame(this->format_context, this->packet);
+        if (ret < 0)
+            return this->fail(fmt::format("error while writing a packet: {}", VideoEncoder::get_error_message(ret)));
+    }
+}
+
+bool VideoEncoder::fail(std::string message)
+{
+    if (this->error.has_value() == false)
+        this->error = std::move(message);
+
+    return false;
+}
+
+bool VideoEncoder::supports_pixel_format(const AVCodec* codec, AVPixelFormat pixel_format)
+{
+    // encoders that don't list their formats take anything
+    if (codec->pix_fmts == nullptr)
+        return true;
+
+    for (auto format = codec->pix_fmts; *format != AV_PIX_FMT_NONE; ++format)
+        if (*format == pixel_format)
+            return true;
+
+    return false;
+}
+
+std::string VideoEncoder::get_error_message(int error)
+{
+    char message[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(error, message, sizeof(message));
+
+    return message;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+
+// local
+#include "video_settings.hpp"
+
+// extern
+#include <glm/vec2.hpp>
+extern "C" {
+    #include <libavcodec/avcodec.h>
+    #include <libavformat/avformat.h>
+}
+
+// builtin
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+
+struct VideoFrameDeleter
+{
+    void operator()(AVFrame* frame) const
+    {
+        av_frame_free(&frame);
+    }
+};
+
+using VideoFrame = std::unique_ptr<AVFrame, VideoFrameDeleter>;
+
+
+// encodes frames and muxes the packets into the container as they come out of
+// the codec, the container (mp4, mkv, mov...) is picked from the file extension
+class VideoEncoder
+{
+    private:
+
+        const AVCodec* codec = nullptr;
+        AVCodecContext* context = nullptr;
+        AVPacket* packet = nullptr;
+
+        AVFormatContext* format_context = nullptr;
+        AVStream* stream = nullptr;
+        bool finished = false;
+
+        // of the first call to libav that failed, nothing is encoded after it
+        std::optional<std::string> error;
+
+    public:
+
+        // the size is rounded up to even dimensions, as required by yuv420. check
+        // "get_error" after, the output may not have been opened
+        VideoEncoder(const std::string& path, const VideoSettings& settings, glm::u64vec2 size, uint64_t fps);
+        VideoEncoder(const VideoEncoder&) = delete;
+        VideoEncoder& operator=(const VideoEncoder&) = delete;
+        ~VideoEncoder();
+
+        // empty frame in the encoder's size and pixel format, safe to call while another thread encodes
+        VideoFrame allocate_frame();
+        static VideoFrame allocate_frame(glm::u64vec2 size, AVPixelFormat pixel_format);
+
+        // false once the frame couldn't be encoded or written, see "get_error"
+        bool encode(VideoFrame frame);
+
+        // drains the frames still buffered by the codec and completes the file,
+        // an encoder destroyed without finishing leaves an incomplete file behind
+        bool finish();
+
+        // why the output couldn't be opened, encoded or written
+        std::optional<std::string> get_error();
+
+        glm::u64vec2 get_size();
+        AVPixelFormat get_pixel_format();
+
+        // why the settings can't be used to write "path", checked before an export starts
+        static std::optional<std::string> validate(const std::string& path, const VideoSettings& settings);
+        static const AVCodec* find_encoder(const VideoSettings& settings);
+
+        // what an encoder made with these would use, known without opening one
+        static glm::u64vec2 get_frame_size(glm::u64vec2 size);
+        static AVPixelFormat get_frame_pixel_format(const VideoSettings& settings);
+
+        // remuxes the segments, each starting at 0, one after another into "path" without
+        // encoding them again. they must have been encoded with the same settings and each
+        // one is "segment_frames" long, except the last. why it failed otherwise
+        static std::optional<std::string> concatenate(const std::vector<std::filesystem::path>& segments, const std::string& path, const VideoSettings& settings, uint64_t fps, uint64_t segment_frames);
+
+    private:
+
+        bool send(const AVFrame* frame);
+
+        // always false, for returning it
+        bool fail(std::string message);
+
+        // opens the file if the container needs one and writes its header
+        static std::optional<std::string> open_output(AVFormatContext* format_context, const std::string& path, const std::map<std::string, std::string>& muxer_options);
+
+        static bool supports_pixel_format(const AVCodec* codec, AVPixelFormat pixel_format);
+        static std::string get_error_message(int error);
+};
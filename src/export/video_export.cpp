@@ -0,0 +1,471 @@
+// header
+#include "video_export.hpp"
+
+// local
+#include "export/pixel_readback.hpp"
+#include "export/segmented_encoder.hpp"
+#include "export/video_encoder.hpp"
+#include "export/yuv_converter.hpp"
+#include "graphical/software/framebuffer.hpp"
+#include "utils/asserts.hpp"
+#include "utils/bounded_queue.hpp"
+#include "utils/log.hpp"
+#include "utils/reorder_buffer.hpp"
+
+// extern
+extern "C" {
+    #include <libswscale/swscale.h>
+}
+
+// builtin
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <optional>
+#include <thread>
+#include <vector>
+
+
+
+// frames in flight between the gpu and the cpu, and between each cpu stage, per render thread
+static const size_t READBACK_BUFFER_COUNT = 3;
+static const size_t STAGE_QUEUE_DEPTH = 4;
+
+static const size_t CORES_PER_RENDER_THREAD = 4;
+static const size_t MAX_RENDER_THREADS = 8;
+
+
+// time a stage spent working, waiting on its neighbours isn't counted
+struct StageTimer
+{
+    std::chrono::steady_clock::duration busy = std::chrono::steady_clock::duration::zero();
+    uint64_t frames = 0;
+
+    void add(std::chrono::steady_clock::time_point start)
+    {
+        this->busy += std::chrono::steady_clock::now() - start;
+        this->frames += 1;
+    }
+
+    StageTimer& operator+=(const StageTimer& other)
+    {
+        this->busy += other.busy;
+        this->frames += other.frames;
+        return *this;
+    }
+
+    double get_average_milliseconds() const
+    {
+        if (this->frames == 0)
+            return 0;
+
+        return std::chrono::duration<double, std::milli>(this->busy).count() / this->frames;
+    }
+};
+
+// rgba, or the packed yuv planes when converted on the gpu
+struct ReadbackFrame
+{
+    uint64_t index;
+    std::vector<uint8_t> pixels;
+};
+
+
+static void convert_with_swscale(SwsContext*& sws_context, const uint8_t* rgba, glm::u64vec2 size, AVFrame* frame)
+{
+    sws_context = sws_getCachedContext(sws_context,
+        size.x, size.y, AV_PIX_FMT_RGBA,
+        size.x, size.y, (AVPixelFormat)frame->format,
+        SWS_BICUBIC, NULL, NULL, NULL
+    );
+
+    const int linesize = size.x * 4;
+    sws_scale(sws_context, &rgba, &linesize, 0, size.y, frame->data, frame->linesize);
+}
+
+// converts the first frame on both the gpu and the cpu and compares them, so a
+// driver getting the shader wrong falls back to swscale instead of ruining the video
+static bool check_gpu_conversion(YuvConverter& converter, Framebuffer& framebuffer, ExportScene& scene, double time, glm::u64vec2 size, AVPixelFormat pixel_format)
+{
+    render_scene(framebuffer, time, scene);
+    converter.convert(framebuffer);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    std::vector<uint8_t> rgba(size.x * size.y * 4);
+    framebuffer.bind();
+    glReadPixels(0, 0, size.x, size.y, GL_RGBA, GL_UNSIGNED_BYTE, rgba.data());
+
+    auto packed_size = converter.get_output_size();
+    std::vector<uint8_t> packed(packed_size.x * packed_size.y);
+    converter.get_output().bind();
+    glReadPixels(0, 0, packed_size.x, packed_size.y, GL_RED, GL_UNSIGNED_BYTE, packed.data());
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    auto gpu_frame = VideoEncoder::allocate_frame(size, pixel_format);
+    YuvConverter::unpack(packed.data(), size, gpu_frame.get());
+
+    SwsContext* sws_context = nullptr;
+    auto cpu_frame = VideoEncoder::allocate_frame(size, pixel_format);
+    convert_with_swscale(sws_context, rgba.data(), size, cpu_frame.get());
+    sws_freeContext(sws_context);
+
+    // only rounding differences are expected on the luma, swscale filters the chroma
+    // differently from the 2x2 average so only its mean is compared
+    double mean_difference[3] = {0, 0, 0};
+    int max_luma_difference = 0;
+
+    for (int plane = 0; plane < 3; ++plane)
+    {
+        auto width = plane == 0 ? size.x : size.x / 2;
+        auto height = plane == 0 ? size.y : size.y / 2;
+
+        uint64_t total = 0;
+
+        for (uint64_t y = 0; y < height; ++y)
+        {
+            for (uint64_t x = 0; x < width; ++x)
+            {
+                int difference = std::abs((int)gpu_frame->data[plane][y * gpu_frame->linesize[plane] + x] - (int)cpu_frame->data[plane][y * cpu_frame->linesize[plane] + x]);
+                total += difference;
+
+                if (plane == 0)
+                    max_luma_difference = std::max(max_luma_difference, difference);
+            }
+        }
+
+        mean_difference[plane] = (double)total / (width * height);
+    }
+
+    bool matches = max_luma_difference <= 3 && mean_difference[0] <= 1 && mean_difference[1] <= 2 && mean_difference[2] <= 2;
+
+    if (matches == false)
+        warn(fmt::format("gpu color conversion differs from swscale (luma max {}, mean y {:.2f} u {:.2f} v {:.2f}), using swscale instead",
+            max_luma_difference, mean_difference[0], mean_difference[1], mean_difference[2]));
+
+    return matches;
+}
+
+
+// one per context, the readback, conversion and encoding run on the other threads.
+// "frames" are the numbers of the frames to render, the pipeline indexes them by position
+static void render_frames(size_t worker, size_t worker_count, const std::vector<uint64_t>& frames, uint64_t fps, double start_time, bool gpu_conversion, glm::u64vec2 size, ExportScene scene, ReorderBuffer<VideoFrame>& ordered, BoundedQueue<ReadbackFrame>& converting, BoundedQueue<std::vector<uint8_t>>& free_buffers, StageTimer& render_timer, StageTimer& readback_timer, std::shared_ptr<std::atomic_bool> stop)
+{
+    graphic_context.make_current_export_context(scene.first_context + worker);
+    graphic_context.wait_fence(scene.fence);
+
+    {
+        auto framebuffer = Framebuffer{size.x, size.y};
+
+        std::optional<YuvConverter> yuv_converter;
+        if (gpu_conversion)
+            yuv_converter.emplace(size);
+
+        auto readback = PixelReadback{
+            gpu_conversion ? yuv_converter->get_output_size() : size,
+            gpu_conversion ? (GLenum)GL_RED : (GLenum)GL_RGBA,
+            READBACK_BUFFER_COUNT
+        };
+
+        const auto take_oldest_frame = [&]()
+        {
+            auto start = std::chrono::steady_clock::now();
+
+            std::vector<uint8_t> pixels;
+            if (auto buffer = free_buffers.try_pop(); buffer.has_value())
+                pixels = std::move(buffer.value());
+            else
+                pixels.resize(readback.byte_size());
+
+            auto index = readback.finish(pixels.data());
+            readback_timer.add(start);
+
+            converting.push(ReadbackFrame{index, std::move(pixels)});
+        };
+
+        // every worker takes every "worker_count"th frame, so they stay close to each other
+        for (uint64_t i = worker; i < frames.size() && stop->load() == false; i += worker_count)
+        {
+            // the window is wider than the frames this worker keeps in its readback ring,
+            // so the oldest one is always handed over before waiting here can block on it
+            if (ordered.wait_for_window(i) == false)
+                break;
+
+            auto start = std::chrono::steady_clock::now();
+
+            render_scene(framebuffer, start_time + (double)frames[i] / fps, scene);
+
+            if (gpu_conversion)
+            {
+                yuv_converter->convert(framebuffer);
+                readback.start(yuv_converter->get_output(), i);
+            }
+            else
+                readback.start(framebuffer, i);
+
+            render_timer.add(start);
+
+            // the oldest transfer was submitted a few frames ago, so mapping it rarely waits
+            if (readback.is_full())
+                take_oldest_frame();
+        }
+
+        while (readback.is_empty() == false && stop->load() == false)
+            take_oldest_frame();
+    }
+
+    // the ui may have dropped its own references since, this copy's can be the last ones.
+    // the fence is shared by every copy, it's deleted once all the workers are done
+    scene.textures.clear();
+    graphic_context.release_current_context();
+
+    // a frame this worker dropped would keep the others waiting on the window forever
+    if (stop->load() == true)
+        ordered.close();
+}
+
+// same as "render_frames" without opengl, the pixels go straight to the conversion
+static void render_frames_on_cpu(size_t worker, size_t worker_count, const std::vector<uint64_t>& frames, uint64_t fps, double start_time, glm::u64vec2 size, ExportScene scene, ReorderBuffer<VideoFrame>& ordered, BoundedQueue<ReadbackFrame>& converting, BoundedQueue<std::vector<uint8_t>>& free_buffers, StageTimer& render_timer, std::shared_ptr<std::atomic_bool> stop)
+{
+    auto framebuffer = SoftwareFramebuffer{size.x, size.y};
+
+    for (uint64_t i = worker; i < frames.size() && stop->load() == false; i += worker_count)
+    {
+        if (ordered.wait_for_window(i) == false)
+            break;
+
+        auto start = std::chrono::steady_clock::now();
+
+        // every worker already has a frame of its own, the bands aren't spread any further
+        render_scene(framebuffer, start_time + (double)frames[i] / fps, scene);
+        framebuffer.flush(false);
+
+        std::vector<uint8_t> pixels;
+        if (auto buffer = free_buffers.try_pop(); buffer.has_value())
+            pixels = std::move(buffer.value());
+
+        pixels.resize(size.x * size.y * Image::CHANNELS);
+        std::memcpy(pixels.data(), framebuffer.get_pixels(), pixels.size());
+
+        render_timer.add(start);
+
+        converting.push(ReadbackFrame{i, std::move(pixels)});
+    }
+
+    if (stop->load() == true)
+        ordered.close();
+}
+
+// returns false if it was stopped before every frame was encoded
+static bool encode_animation(const std::string& output_path, const VideoSettings& settings, uint64_t fps, double start_time, double length, ExportScene& scene, std::shared_ptr<ExportProgress> progress, std::shared_ptr<std::atomic_bool> stop)
+{
+    const auto frame_count = (uint64_t)std::ceil(length * fps);
+    const auto worker_count = get_render_thread_count(settings);
+    const auto export_start = std::chrono::steady_clock::now();
+
+    progress->set_frame_count(frame_count);
+
+    SegmentedEncoder encoder{output_path, settings, scene.size, fps, start_time, frame_count, scene};
+
+    if (auto error = encoder.get_error(); error.has_value())
+    {
+        progress->fail(error.value());
+        release_export_scene_with_context(scene);
+        return false;
+    }
+
+    // only the segments that weren't encoded by an earlier run of this export
+    const auto frames = encoder.get_missing_frames();
+    progress->set_done_frames(frame_count - frames.size());
+
+    if (frames.empty())
+    {
+        release_export_scene_with_context(scene);
+
+        if (encoder.finish() == false)
+        {
+            progress->fail(encoder.get_error().value());
+            return false;
+        }
+
+        return true;
+    }
+
+    // rendered at the encoder's size, which is rounded up to even dimensions
+    const auto size = encoder.get_size();
+    const auto pixel_format = encoder.get_pixel_format();
+
+    // converting on the gpu reads back 1.5 bytes per pixel instead of 4 and skips swscale
+    bool gpu_conversion = false;
+    if (settings.software_rendering == false && pixel_format == AV_PIX_FMT_YUV420P && YuvConverter::is_supported(size))
+    {
+        graphic_context.make_current_export_context(scene.first_context);
+        graphic_context.wait_fence(scene.fence);
+
+        {
+            auto framebuffer = Framebuffer{size.x, size.y};
+            auto yuv_converter = YuvConverter{size};
+            auto check_scene = scene;
+
+            if (yuv_converter.is_valid() == false)
+                warn("gpu color conversion is not available, using swscale instead");
+            else
+                gpu_conversion = check_gpu_conversion(yuv_converter, framebuffer, check_scene, start_time + (double)frames.front() / fps, size, pixel_format);
+        }
+
+        // the first worker takes the context over
+        graphic_context.release_current_context();
+    }
+
+    // frames in flight are bounded by the window, the queues never hold more than it
+    const size_t window = worker_count * (READBACK_BUFFER_COUNT + STAGE_QUEUE_DEPTH);
+
+    BoundedQueue<ReadbackFrame> converting{window};
+    ReorderBuffer<VideoFrame> ordered{window};
+
+    // pixel buffers go back to the render stage instead of being reallocated every frame
+    BoundedQueue<std::vector<uint8_t>> free_buffers{window};
+
+    // each thread has its own timers, they are only added up once it is done
+    std::vector<StageTimer> render_timers(worker_count), readback_timers(worker_count), convert_timers(worker_count);
+    StageTimer encode_timer;
+
+
+    std::vector<std::thread> converters;
+    for (size_t i = 0; i < worker_count; ++i)
+    {
+        converters.emplace_back([&, i]()
+        {
+            SwsContext* sws_context = nullptr;
+
+            while (auto readback_frame = converting.pop())
+            {
+                auto start = std::chrono::steady_clock::now();
+                auto frame = VideoEncoder::allocate_frame(size, pixel_format);
+
+                if (gpu_conversion)
+                    YuvConverter::unpack(readback_frame->pixels.data(), size, frame.get());
+                else
+                    convert_with_swscale(sws_context, readback_frame->pixels.data(), size, frame.get());
+
+                frame->pts = frames[readback_frame->index];
+                free_buffers.push(std::move(readback_frame->pixels));
+
+                convert_timers[i].add(start);
+
+                ordered.push(readback_frame->index, std::move(frame));
+            }
+
+            sws_freeContext(sws_context);
+        });
+    }
+
+    std::thread encoder_thread{[&]()
+    {
+        while (auto frame = ordered.pop())
+        {
+            // frames left in the buffer are dropped once the export is stopped
+            if (stop->load() == true)
+                continue;
+
+            auto start = std::chrono::steady_clock::now();
+
+            // the render workers only watch "stop", the failure is what gets reported
+            if (encoder.encode(std::move(frame.value())) == false)
+            {
+                progress->fail(encoder.get_error().value());
+                stop->store(true);
+                continue;
+            }
+
+            encode_timer.add(start);
+
+            progress->add_done_frames();
+        }
+    }};
+
+    std::vector<std::thread> workers;
+    for (size_t i = 0; i < worker_count; ++i)
+    {
+        if (settings.software_rendering)
+            workers.emplace_back(render_frames_on_cpu, i, worker_count, std::cref(frames), fps, start_time, size, scene,
+                std::ref(ordered), std::ref(converting), std::ref(free_buffers), std::ref(render_timers[i]), stop);
+        else
+            workers.emplace_back(render_frames, i, worker_count, std::cref(frames), fps, start_time, gpu_conversion, size, scene,
+                std::ref(ordered), std::ref(converting), std::ref(free_buffers), std::ref(render_timers[i]), std::ref(readback_timers[i]), stop);
+    }
+
+
+    for (auto& worker: workers)
+        worker.join();
+
+    // every context waited on the fence by now
+    release_export_scene_with_context(scene);
+
+    converting.close();
+    free_buffers.close();
+
+    for (auto& converter: converters)
+        converter.join();
+
+    ordered.close();
+    encoder_thread.join();
+
+    if (stop->load() == true)
+        return false;
+
+    if (encoder.finish() == false)
+    {
+        progress->fail(encoder.get_error().value());
+        return false;
+    }
+
+    const auto total = [](const std::vector<StageTimer>& timers)
+    {
+        StageTimer output;
+        for (auto& timer: timers)
+            output += timer;
+
+        return output;
+    };
+
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - export_start).count();
+    notice(fmt::format("exported {} frames in {:.2f}s ({:.1f} fps, {} {} render threads, {} color conversion), per frame: render {:.2f}ms, readback {:.2f}ms, conversion {:.2f}ms, encoding {:.2f}ms",
+        frames.size(), elapsed, frames.size() / std::max(elapsed, 1e-9), worker_count, settings.software_rendering ? "cpu" : "gpu", gpu_conversion ? "gpu" : "swscale",
+        total(render_timers).get_average_milliseconds(), total(readback_timers).get_average_milliseconds(),
+        total(convert_timers).get_average_milliseconds(), encode_timer.get_average_milliseconds()
+    ));
+
+    return true;
+}
+
+
+size_t get_render_thread_count(const VideoSettings& settings)
+{
+    auto cores = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+
+    // frames drawn on the cpu scale with the cores, there is no shared gpu to wait on
+    if (settings.software_rendering)
+        return settings.render_threads > 0 ? std::min<size_t>(settings.render_threads, cores) : cores;
+
+    if (settings.render_threads > 0)
+        return std::min<size_t>(settings.render_threads, MAX_RENDER_THREADS);
+
+    // the gpu is shared by every context, past a few of them the cpu side
+    // of each one (readback, conversion) is what still scales
+    return std::clamp<size_t>(cores / CORES_PER_RENDER_THREAD, 1, MAX_RENDER_THREADS);
+}
+
+
+void export_animation(std::string path, VideoSettings settings, uint64_t fps, double start_time, double length, ExportScene scene, std::shared_ptr<ExportProgress> progress, std::shared_ptr<std::atomic_bool> stop)
+{
+    // the encoder removes the incomplete file or segment of a stopped export
+    if (encode_animation(path, settings, fps, start_time, length, scene, progress, stop) == false)
+        return;
+
+    progress->finish();
+}
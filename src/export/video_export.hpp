@@ -0,0 +1,25 @@
+#pragma once
+
+
+// local
+#include "export_progress.hpp"
+#include "scene_render.hpp"
+#include "video_settings.hpp"
+
+// builtin
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+
+
+// runs on its own thread, frames are rendered in parallel on "get_render_thread_count"
+// export contexts, which must have been reserved by the ui, or on as many cpu threads
+// with "software_rendering", in which case the scene comes from "collect_software_export_scene". rendering, readback, color
+// conversion and encoding are pipelined so they overlap instead of waiting on each other.
+// the container is picked from the extension of "path", the video starts at "start_time".
+// with a "segment_length" the segments encoded by an earlier, stopped run are reused
+void export_animation(std::string path, VideoSettings settings, uint64_t fps, double start_time, double length, ExportScene scene, std::shared_ptr<ExportProgress> progress, std::shared_ptr<std::atomic_bool> stop);
+
+size_t get_render_thread_count(const VideoSettings& settings);
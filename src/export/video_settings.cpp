@@ -0,0 +1,103 @@
+// header
+#include "video_settings.hpp"
+
+
+
+const std::vector<VideoSettings>& VideoSettings::get_profiles()
+{
+    static const std::vector<VideoSettings> profiles
+    {
+        []()
+        {
+            VideoSettings settings;
+            settings.profile_name = "H.264";
+            settings.encoders = {"libx264", "libopenh264"};
+            settings.quality = 20;
+            settings.max_b_frames = 2;
+            settings.preset = "medium";
+            return settings;
+        }(),
+
+        // quick renders to check the timing, quality doesn't matter
+        []()
+        {
+            VideoSettings settings;
+            settings.profile_name = "H.264 preview";
+            settings.encoders = {"libx264", "libopenh264"};
+            settings.quality = 30;
+            settings.preset = "ultrafast";
+            settings.slice_threading = true;
+            return settings;
+        }(),
+
+        []()
+        {
+            VideoSettings settings;
+            settings.profile_name = "VP9";
+            settings.encoders = {"libvpx-vp9"};
+            settings.quality = 32;
+            settings.max_b_frames = 0;
+            settings.options = {{"deadline", "good"}, {"cpu-used", "2"}, {"row-mt", "1"}};
+            return settings;
+        }(),
+
+        // lossless rgb, every frame is a keyframe so it can be cut anywhere
+        []()
+        {
+            VideoSettings settings;
+            settings.profile_name = "FFV1 lossless";
+            settings.encoders = {"ffv1"};
+            settings.pixel_format = AV_PIX_FMT_BGR0;
+            settings.gop_size = 1;
+            settings.slice_threading = true;
+            settings.options = {{"level", "3"}, {"slices", "16"}, {"slicecrc", "1"}};
+            return settings;
+        }(),
+
+        // intermediate for editing software, 10 bit 4:2:2
+        []()
+        {
+            VideoSettings settings;
+            settings.profile_name = "ProRes 422 HQ";
+            settings.encoders = {"prores_ks"};
+            settings.pixel_format = AV_PIX_FMT_YUV422P10LE;
+            settings.gop_size = 1;
+            settings.options = {{"profile", "3"}, {"vendor", "apl0"}};
+            return settings;
+        }(),
+
+        // light previews for review tools, libwebp only stores the rect that changed since the last frame
+        []()
+        {
+            VideoSettings settings;
+            settings.profile_name = "WebP (animated)";
+            settings.encoders = {"libwebp_anim"};
+            settings.options = {{"quality", "75"}, {"compression_level", "4"}};
+            settings.muxer_options = {{"loop", "0"}};
+            return settings;
+        }(),
+
+        []()
+        {
+            VideoSettings settings;
+            settings.profile_name = "MPEG-2";
+            settings.encoders = {"mpeg2video"};
+            settings.bit_rate = 8'000'000;
+            settings.gop_size = 12;
+            settings.max_b_frames = 2;
+            return settings;
+        }()
+    };
+
+    return profiles;
+}
+
+const std::vector<std::string>& VideoSettings::get_presets()
+{
+    static const std::vector<std::string> presets
+    {
+        "ultrafast", "superfast", "veryfast", "faster", "fast", "medium", "slow", "slower", "veryslow"
+    };
+
+    return presets;
+}
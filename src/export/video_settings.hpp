@@ -0,0 +1,60 @@
+#pragma once
+
+
+// extern
+extern "C" {
+    #include <libavutil/avutil.h>
+}
+
+// builtin
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+
+struct VideoSettings
+{
+    std::string profile_name;
+
+    // the first one available in this ffmpeg build is used
+    std::vector<std::string> encoders;
+    AVPixelFormat pixel_format = AV_PIX_FMT_YUV420P;
+
+    // constant quality (crf), encoders without it fall back to "bit_rate"
+    std::optional<int> quality;
+    int64_t bit_rate = 0;
+
+    // 0 leaves a keyframe every two seconds
+    int gop_size = 0;
+    int max_b_frames = 0;
+
+    // 0 uses every core, slice threading trades some compression for lower latency
+    int thread_count = 0;
+    bool slice_threading = false;
+
+    // frames rendered in parallel, each on its own context, 0 picks it from the core count
+    int render_threads = 0;
+
+    // draws on the cpu instead, for machines without a gpu
+    bool software_rendering = false;
+
+    // 0 encodes the video in one piece, otherwise it is encoded in segments of about this
+    // many seconds, rounded up to whole keyframe intervals, that a stopped export resumes from
+    double segment_length = 0;
+
+    // x264 speed preset, empty for encoders without one
+    std::string preset;
+
+    // private options of the encoder, passed as they are
+    std::map<std::string, std::string> options;
+
+    // options of the container, like how often an animated webp loops
+    std::map<std::string, std::string> muxer_options;
+
+
+    static const std::vector<VideoSettings>& get_profiles();
+    static const std::vector<std::string>& get_presets();
+};
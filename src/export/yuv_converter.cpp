@@ -0,0 +1,140 @@
+// header
+#include "yuv_converter.hpp"
+
+// builtin
+#include <cstring>
+
+
+
+static const char* YUV_VERTEX_SHADER = R"(
+#version 130
+
+// a single triangle covering the whole target, no vertex buffer needed
+void main()
+{
+    vec2 position = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(position * 2.0 - 1.0, 0.0, 1.0);
+}
+)";
+
+static const char* YUV_FRAGMENT_SHADER = R"(
+#version 130
+
+uniform sampler2D source;
+uniform ivec2 size;
+
+out vec4 output_color;
+
+float get_y(vec3 rgb)
+{
+    return (16.0 + dot(rgb, vec3(65.481, 128.553, 24.966))) / 255.0;
+}
+
+float get_u(vec3 rgb)
+{
+    return (128.0 + dot(rgb, vec3(-37.797, -74.203, 112.0))) / 255.0;
+}
+
+float get_v(vec3 rgb)
+{
+    return (128.0 + dot(rgb, vec3(112.0, -93.786, -18.214))) / 255.0;
+}
+
+void main()
+{
+    ivec2 target = ivec2(gl_FragCoord.xy);
+
+    if (target.y < size.y)
+    {
+        output_color = vec4(get_y(texelFetch(source, target, 0).rgb), 0.0, 0.0, 1.0);
+        return;
+    }
+
+    // chroma is the average of a 2x2 block
+    int half_width = size.x / 2;
+    bool is_v = target.x >= half_width;
+    ivec2 block = ivec2(is_v ? target.x - half_width : target.x, target.y - size.y) * 2;
+
+    vec3 rgb = (
+        texelFetch(source, block, 0).rgb +
+        texelFetch(source, block + ivec2(1, 0), 0).rgb +
+        texelFetch(source, block + ivec2(0, 1), 0).rgb +
+        texelFetch(source, block + ivec2(1, 1), 0).rgb
+    ) / 4.0;
+
+    output_color = vec4(is_v ? get_v(rgb) : get_u(rgb), 0.0, 0.0, 1.0);
+}
+)";
+
+
+
+YuvConverter::YuvConverter(glm::u64vec2 size):
+    size{size},
+    program{YUV_VERTEX_SHADER, YUV_FRAGMENT_SHADER},
+    output{size.x, size.y + size.y / 2, GL_R8}
+{
+    leaf_assert(YuvConverter::is_supported(size));
+}
+
+
+bool YuvConverter::is_supported(glm::u64vec2 size)
+{
+    // shaders with texelFetch and single channel render targets are core since 3.0
+    return GLAD_GL_VERSION_3_0 && size.x % 2 == 0 && size.y % 2 == 0;
+}
+
+
+bool YuvConverter::is_valid()
+{
+    return this->program.is_valid();
+}
+
+
+void YuvConverter::convert(Framebuffer& source)
+{
+    auto output_size = this->get_output_size();
+
+    this->output.bind();
+    glViewport(0, 0, output_size.x, output_size.y);
+    glDisable(GL_BLEND);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, source.get_texture_id());
+
+    this->program.bind();
+    glUniform1i(this->program.get_uniform_location("source"), 0);
+    glUniform2i(this->program.get_uniform_location("size"), this->size.x, this->size.y);
+
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    this->program.unbind();
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+
+Framebuffer& YuvConverter::get_output()
+{
+    return this->output;
+}
+
+glm::u64vec2 YuvConverter::get_output_size()
+{
+    return this->output.get_size();
+}
+
+
+void YuvConverter::unpack(const uint8_t* packed, glm::u64vec2 size, AVFrame* frame)
+{
+    for (uint64_t row = 0; row < size.y; ++row)
+        memcpy(frame->data[0] + row * frame->linesize[0], packed + row * size.x, size.x);
+
+    auto chroma = packed + size.x * size.y;
+    auto chroma_width = size.x / 2;
+
+    for (uint64_t row = 0; row < size.y / 2; ++row)
+    {
+        memcpy(frame->data[1] + row * frame->linesize[1], chroma + row * size.x, chroma_width);
+        memcpy(frame->data[2] + row * frame->linesize[2], chroma + row * size.x + chroma_width, chroma_width);
+    }
+}
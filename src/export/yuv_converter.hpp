@@ -0,0 +1,51 @@
+#pragma once
+
+
+// local
+#include "graphical/graphics.hpp"
+#include "graphical/opengl/framebuffer.hpp"
+#include "graphical/opengl/shader.hpp"
+
+// extern
+#include <glm/vec2.hpp>
+extern "C" {
+    #include <libavutil/frame.h>
+}
+
+// builtin
+#include <cstdint>
+
+
+
+// converts rendered rgba frames to yuv420 (bt.601, limited range) on the gpu so
+// only 1.5 bytes per pixel have to be read back instead of 4.
+// the planes are packed in a single texture 1.5 frames tall: the luma rows on
+// top, then the chroma rows, each holding its u samples followed by its v samples
+class YuvConverter
+{
+    private:
+
+        glm::u64vec2 size;
+        ShaderProgram program;
+        Framebuffer output;
+
+    public:
+
+        // "size" must be even, see "is_supported"
+        YuvConverter(glm::u64vec2 size);
+        YuvConverter(const YuvConverter&) = delete;
+        YuvConverter& operator=(const YuvConverter&) = delete;
+
+        static bool is_supported(glm::u64vec2 size);
+
+        // false when the driver couldn't build the shader, swscale is used instead
+        bool is_valid();
+
+        void convert(Framebuffer& source);
+
+        Framebuffer& get_output();
+        glm::u64vec2 get_output_size();
+
+        // copies the packed planes read back from the output into a yuv420p frame
+        static void unpack(const uint8_t* packed, glm::u64vec2 size, AVFrame* frame);
+};
@@ -0,0 +1,370 @@
+// header
+#include "asset_index.hpp"
+
+// local
+#include "graphical/image.hpp"
+#include "utils/file_io.hpp"
+#include "utils/hash.hpp"
+#include "utils/log.hpp"
+#include "utils/system.hpp"
+#include "utils/thread_pool.hpp"
+
+// builtin
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+
+
+
+static const char ASSET_INDEX_MAGIC[4] = {'L', 'A', 'I', 'X'};
+
+template <typename T>
+static void write_value(std::string& buffer, const T& value)
+{
+    buffer.append((const char*)&value, sizeof(T));
+}
+
+static void write_string(std::string& buffer, const std::string& value)
+{
+    write_value(buffer, (uint32_t)value.size());
+    buffer.append(value);
+}
+
+// reads from the cache file, every read is bounds checked since the file may be truncated
+struct CacheReader
+{
+    const std::string& buffer;
+    size_t position = 0;
+
+    template <typename T>
+    bool read(T& value)
+    {
+        if (this->position + sizeof(T) > this->buffer.size())
+            return false;
+
+        memcpy(&value, this->buffer.data() + this->position, sizeof(T));
+        this->position += sizeof(T);
+        return true;
+    }
+
+    bool read(std::string& value)
+    {
+        uint32_t size;
+        if (!this->read(size) || this->position + size > this->buffer.size())
+            return false;
+
+        value.assign(this->buffer.data() + this->position, size);
+        this->position += size;
+        return true;
+    }
+};
+
+
+
+const std::unordered_set<std::string> AssetIndex::supported_formats
+{
+    ".png", ".jpeg", ".bmp", ".ppm", ".pgm"
+};
+
+
+AssetIndex::AssetIndex(const std::filesystem::path& root): root{root}
+{
+    auto cache_directory = get_system_config_directory() / ".leaf_cache" / "assets";
+
+    std::error_code error;
+    std::filesystem::create_directories(cache_directory, error);
+
+    auto absolute_root = std::filesystem::absolute(root, error).lexically_normal().generic_string();
+    this->cache_path = cache_directory / fmt::format("{:016x}.index", hash_string(absolute_root));
+
+    this->load_cache();
+
+    for (auto& [path, asset]: this->assets)
+        this->publish(ChangeType::Added, asset);
+}
+
+AssetIndex::~AssetIndex()
+{
+    // only complete scans are saved, otherwise files not reported yet would be forgotten
+    if (this->dirty && this->scan_finished)
+        this->save_cache();
+}
+
+
+void AssetIndex::enqueue(const std::shared_ptr<AssetIndex>& index, std::vector<FileWatcher::Event> events)
+{
+    {
+        std::lock_guard lock{index->pending_mutex};
+        std::move(events.begin(), events.end(), std::back_inserter(index->pending));
+
+        // a single task processes everything so events keep their order
+        if (index->processing)
+            return;
+        index->processing = true;
+    }
+
+    thread_pool.submit([index]()
+    {
+        while (true)
+        {
+            std::vector<FileWatcher::Event> events;
+
+            {
+                std::lock_guard lock{index->pending_mutex};
+                std::swap(events, index->pending);
+
+                if (events.empty())
+                {
+                    index->processing = false;
+                    return;
+                }
+            }
+
+            for (auto& event: events)
+                index->process(event);
+
+            if (index->dirty && index->scan_finished && std::chrono::steady_clock::now() - index->last_save > AssetIndex::save_interval)
+                index->save_cache();
+        }
+    });
+}
+
+std::vector<AssetIndex::Change> AssetIndex::poll_changes()
+{
+    std::lock_guard lock{this->changes_mutex};
+
+    std::vector<Change> output;
+    std::swap(output, this->changes);
+
+    return output;
+}
+
+bool AssetIndex::is_supported(const std::filesystem::path& path)
+{
+    return AssetIndex::supported_formats.find(path.extension().string()) != AssetIndex::supported_formats.end();
+}
+
+
+void AssetIndex::process(const FileWatcher::Event& event)
+{
+    auto path = event.path.string();
+
+    switch (event.type)
+    {
+        case FileWatcher::EventType::Created:
+        case FileWatcher::EventType::Modified:
+            if (AssetIndex::is_supported(event.path))
+            {
+                this->seen.insert(path);
+                this->revalidate(path);
+            }
+            break;
+
+        case FileWatcher::EventType::Removed:
+            this->remove(path);
+            break;
+
+        case FileWatcher::EventType::ScanFinished:
+        {
+            // cached files the scan didn't find were removed while the program was closed
+            std::vector<std::string> missing;
+            for (auto& [asset_path, asset]: this->assets)
+                if (this->seen.find(asset_path) == this->seen.end())
+                    missing.push_back(asset_path);
+
+            for (auto& asset_path: missing)
+                this->remove(asset_path);
+
+            this->seen.clear();
+            this->scan_finished = true;
+            this->dirty = true;
+            break;
+        }
+    }
+}
+
+void AssetIndex::revalidate(const std::string& path)
+{
+    std::error_code error;
+    auto write_time = (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    if (error)
+        return;
+
+    auto file_size = (uint64_t)std::filesystem::file_size(path, error);
+    if (error)
+        return;
+
+    // unchanged since it was cached, nothing is read
+    auto cached = this->assets.find(path);
+    if (cached != this->assets.end() && cached->second.write_time == write_time && cached->second.file_size == file_size)
+        return;
+
+    auto asset = AssetIndex::read_asset(path);
+    if (asset.has_value() == false)
+    {
+        this->remove(path);
+        return;
+    }
+
+    this->dirty = true;
+
+    if (cached == this->assets.end())
+    {
+        this->assets.emplace(path, asset.value());
+        this->publish(ChangeType::Added, asset.value());
+        return;
+    }
+
+    // a touched file with the same content only needs new metadata
+    auto content_changed = cached->second.content_hash != asset->content_hash || cached->second.size != asset->size;
+    cached->second = asset.value();
+
+    if (content_changed)
+        this->publish(ChangeType::Modified, asset.value());
+}
+
+void AssetIndex::remove(const std::string& path)
+{
+    if (auto asset = this->assets.find(path); asset != this->assets.end())
+    {
+        this->publish(ChangeType::Removed, asset->second);
+        this->assets.erase(asset);
+        this->dirty = true;
+        return;
+    }
+
+    // a removed directory takes every asset below it
+    auto prefix = (std::filesystem::path{path} / "").string();
+
+    for (auto asset = this->assets.begin(); asset != this->assets.end();)
+    {
+        if (asset->first.compare(0, prefix.size(), prefix) == 0)
+        {
+            this->publish(ChangeType::Removed, asset->second);
+            asset = this->assets.erase(asset);
+            this->dirty = true;
+        }
+        else
+            ++asset;
+    }
+}
+
+void AssetIndex::publish(ChangeType type, const Asset& asset)
+{
+    std::lock_guard lock{this->changes_mutex};
+    this->changes.push_back(Change{type, asset});
+}
+
+
+void AssetIndex::load_cache()
+{
+    std::ifstream file{this->cache_path, std::ios::binary};
+    if (file.is_open() == false)
+        return;
+
+    std::string buffer{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+    CacheReader reader{buffer};
+
+    char magic[4];
+    uint32_t version;
+    uint64_t count;
+
+    if (!reader.read(magic) || memcmp(magic, ASSET_INDEX_MAGIC, sizeof(magic)) != 0)
+        return;
+    if (!reader.read(version) || version != AssetIndex::cache_version || !reader.read(count))
+        return;
+
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        Asset asset;
+        std::string relative_path;
+
+        bool complete = reader.read(relative_path)
+            && reader.read(asset.size.x) && reader.read(asset.size.y)
+            && reader.read(asset.format)
+            && reader.read(asset.write_time) && reader.read(asset.file_size) && reader.read(asset.content_hash);
+
+        if (!complete)
+        {
+            warn(fmt::format("asset cache '{}' is truncated, it will be rebuilt", this->cache_path.string()));
+            this->assets.clear();
+            return;
+        }
+
+        asset.path = (this->root / std::filesystem::path{relative_path}.make_preferred()).string();
+        this->assets.emplace(asset.path, std::move(asset));
+    }
+}
+
+void AssetIndex::save_cache()
+{
+    std::string buffer;
+    buffer.append(ASSET_INDEX_MAGIC, sizeof(ASSET_INDEX_MAGIC));
+    write_value(buffer, AssetIndex::cache_version);
+    write_value(buffer, (uint64_t)this->assets.size());
+
+    // paths are stored relative to the root so moving the library keeps working
+    for (auto& [path, asset]: this->assets)
+    {
+        write_string(buffer, std::filesystem::path{path}.lexically_relative(this->root).generic_string());
+        write_value(buffer, asset.size.x);
+        write_value(buffer, asset.size.y);
+        write_string(buffer, asset.format);
+        write_value(buffer, asset.write_time);
+        write_value(buffer, asset.file_size);
+        write_value(buffer, asset.content_hash);
+    }
+
+    auto temporary_path = this->cache_path;
+    temporary_path += ".tmp";
+
+    {
+        std::ofstream file{temporary_path, std::ios::binary};
+        if (!file.write(buffer.data(), buffer.size()))
+        {
+            warn(fmt::format("could not write asset cache '{}'", temporary_path.string()));
+            return;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary_path, this->cache_path, error);
+
+    this->dirty = false;
+    this->last_save = std::chrono::steady_clock::now();
+}
+
+
+std::optional<AssetIndex::Asset> AssetIndex::read_asset(const std::string& path)
+{
+    std::error_code error;
+
+    Asset asset;
+    asset.path = path;
+    asset.write_time = (int64_t)std::filesystem::last_write_time(path, error).time_since_epoch().count();
+    asset.file_size = (uint64_t)std::filesystem::file_size(path, error);
+
+    if (error)
+        return std::nullopt;
+
+    // only the header is parsed for the size
+    auto size = Image::read_size(path);
+    if (size.has_value() == false)
+        return std::nullopt;
+
+    asset.size = size.value();
+
+    asset.format = std::filesystem::path{path}.extension().string();
+    std::transform(asset.format.begin(), asset.format.end(), asset.format.begin(), [](unsigned char c){ return std::tolower(c); });
+
+    auto content = try_read_file(path);
+    if (content.has_value() == false)
+        return std::nullopt;
+
+    asset.content_hash = hash_bytes(content->data(), content->size());
+
+    return asset;
+}
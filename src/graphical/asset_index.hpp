@@ -0,0 +1,101 @@
+#pragma once
+
+
+// local
+#include "utils/file_watcher.hpp"
+
+// extern
+#include <glm/vec2.hpp>
+
+// builtin
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+
+// metadata of every image under a folder, persisted between sessions so the
+// library can be listed and laid out right away and without decoding pixels
+class AssetIndex
+{
+    public:
+
+        struct Asset
+        {
+            std::string path;
+            glm::u64vec2 size = {0, 0};
+            std::string format;
+            int64_t write_time = 0;
+            uint64_t file_size = 0;
+            uint64_t content_hash = 0;
+        };
+
+        enum class ChangeType
+        {
+            Added,
+            Modified,
+            Removed
+        };
+
+        struct Change
+        {
+            ChangeType type;
+            Asset asset;
+        };
+
+        static const std::unordered_set<std::string> supported_formats;
+
+    private:
+
+        inline static const uint32_t cache_version = 1;
+        inline static const std::chrono::steady_clock::duration save_interval = std::chrono::seconds(5);
+
+        std::filesystem::path root;
+        std::filesystem::path cache_path;
+
+        // only touched by the task processing watcher events
+        std::unordered_map<std::string, Asset> assets;
+        std::unordered_set<std::string> seen;
+        bool scan_finished = false;
+        bool dirty = false;
+        std::chrono::steady_clock::time_point last_save = std::chrono::steady_clock::now();
+
+        std::mutex pending_mutex;
+        std::vector<FileWatcher::Event> pending;
+        bool processing = false;
+
+        std::mutex changes_mutex;
+        std::vector<Change> changes;
+
+    public:
+
+        // cached assets are reported as "Added" right away, files are revalidated as the watcher reports them
+        AssetIndex(const std::filesystem::path& root);
+        AssetIndex(const AssetIndex&) = delete;
+        AssetIndex& operator=(const AssetIndex&) = delete;
+        ~AssetIndex();
+
+        // the index must outlive the events, hence the shared_ptr
+        static void enqueue(const std::shared_ptr<AssetIndex>& index, std::vector<FileWatcher::Event> events);
+        std::vector<Change> poll_changes();
+
+        static bool is_supported(const std::filesystem::path& path);
+
+    private:
+
+        void process(const FileWatcher::Event& event);
+        void revalidate(const std::string& path);
+        void remove(const std::string& path);
+        void publish(ChangeType type, const Asset& asset);
+
+        void load_cache();
+        void save_cache();
+
+        static std::optional<Asset> read_asset(const std::string& path);
+};
@@ -4,6 +4,10 @@
 // local
 #include "config.hpp"
 #include "utils/asserts.hpp"
+#include "graphical/sprite.hpp"
+
+// builtin
+#include <cstdlib>
 
 
 
@@ -31,22 +35,14 @@ void GraphicContext::init()
         panic("error while creating window");
 
 
-    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
-    this->export_window = glfwCreateWindow(640, 480, "", NULL, NULL);
-
-    if (this->export_window == nullptr)
-        panic("error while creating export window");
+    this->reserve_export_contexts(1);
 
 
     glfwMakeContextCurrent(this->window);
 
 
 
-    auto version = gladLoadGL(glfwGetProcAddress);
-    if (version == 0)
-        panic("failed  to initialize opengl context");
-    else
-        notice(fmt::format("opengl version: {}.{}", GLAD_VERSION_MAJOR(version), GLAD_VERSION_MINOR(version)));
+    this->load_opengl();
 
     // enable vsync
     glfwSwapInterval(config.graphic_config.vsync);
@@ -74,18 +70,63 @@ void GraphicContext::init()
 }
 
 
+void GraphicContext::init_headless()
+{
+    leaf_assert(this->initialized == false);
+
+    glfwSetErrorCallback(glfw_error_callback);
+
+    // without a display server the null platform still creates contexts through osmesa
+    #if defined(__linux__) && defined(GLFW_PLATFORM_NULL)
+        if (std::getenv("DISPLAY") == nullptr && std::getenv("WAYLAND_DISPLAY") == nullptr)
+        {
+            glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+            notice("no display available, rendering with osmesa");
+        }
+    #endif
+
+    if (!glfwInit())
+        panic("glfw launch error");
+
+    this->headless = true;
+
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 0);
+
+    // only owns the context the sprites are uploaded from, it is never shown
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    this->window = glfwCreateWindow(64, 64, "Leaf", NULL, NULL);
+
+    if (this->window == nullptr)
+        panic("error while creating the offscreen context");
+
+    this->reserve_export_contexts(1);
+
+    glfwMakeContextCurrent(this->window);
+    this->load_opengl();
+
+    this->initialized = true;
+}
+
+
 void GraphicContext::destroy()
 {
     leaf_assert(this->initialized == true);
 
     // destroy imgui context
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
+    if (this->headless == false)
+    {
+        ImGui_ImplOpenGL3_Shutdown();
+        ImGui_ImplGlfw_Shutdown();
+        ImGui::DestroyContext();
+    }
 
     // destroy opengl/SDL context
     glfwDestroyWindow(this->window);
-    glfwDestroyWindow(this->export_window);
+    for (auto export_window: this->export_windows)
+        glfwDestroyWindow(export_window);
+    this->export_windows.clear();
     glfwTerminate();
 
     this->initialized = false;
@@ -94,6 +135,9 @@ void GraphicContext::destroy()
 
 void GraphicContext::start_frame()
 {
+    // upload the sprites decoded since the last frame
+    sprite_manager.update();
+
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -116,14 +160,93 @@ void GraphicContext::display_frame()
 }
 
 
+void GraphicContext::load_opengl()
+{
+    auto version = gladLoadGL(glfwGetProcAddress);
+    if (version == 0)
+        panic("failed  to initialize opengl context");
+    else
+        notice(fmt::format("opengl version: {}.{}", GLAD_VERSION_MAJOR(version), GLAD_VERSION_MINOR(version)));
+
+    this->fence_sync = (decltype(this->fence_sync))glfwGetProcAddress("glFenceSync");
+    this->wait_sync = (decltype(this->wait_sync))glfwGetProcAddress("glWaitSync");
+    this->delete_sync = (decltype(this->delete_sync))glfwGetProcAddress("glDeleteSync");
+}
+
+
+void GraphicContext::reserve_export_contexts(size_t count)
+{
+    // shares textures with the main window, so exports use the sprites already loaded
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+
+    while (this->export_windows.size() < count)
+    {
+        auto export_window = glfwCreateWindow(640, 480, "", NULL, this->window);
+
+        if (export_window == nullptr)
+            panic("error while creating export window");
+
+        this->export_windows.push_back(export_window);
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, this->headless ? GLFW_FALSE : GLFW_TRUE);
+}
+
+
 void GraphicContext::make_current_main_context()
 {
     glfwMakeContextCurrent(this->window);
 }
 
-void GraphicContext::make_current_export_context()
+void GraphicContext::make_current_export_context(size_t index)
+{
+    leaf_assert(index < this->export_windows.size());
+
+    glfwMakeContextCurrent(this->export_windows[index]);
+}
+
+void GraphicContext::release_current_context()
+{
+    glfwMakeContextCurrent(nullptr);
+}
+
+
+GLsync GraphicContext::create_fence()
+{
+    const GLenum SYNC_GPU_COMMANDS_COMPLETE = 0x9117;
+
+    // without sync objects the only option is waiting for the uploads right away
+    if (this->fence_sync == nullptr || this->wait_sync == nullptr || this->delete_sync == nullptr)
+    {
+        glFinish();
+        return nullptr;
+    }
+
+    auto fence = this->fence_sync(SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+    // the other context can only see the fence once it has been flushed
+    glFlush();
+
+    return fence;
+}
+
+void GraphicContext::wait_fence(GLsync fence)
 {
-    glfwMakeContextCurrent(this->export_window);
+    const GLuint64 TIMEOUT_IGNORED = 0xFFFFFFFFFFFFFFFFull;
+
+    if (fence == nullptr)
+        return;
+
+    // waits on the gpu, the calling thread keeps going
+    this->wait_sync(fence, 0, TIMEOUT_IGNORED);
+}
+
+void GraphicContext::delete_fence(GLsync fence)
+{
+    if (fence == nullptr)
+        return;
+
+    this->delete_sync(fence);
 }
 
 
@@ -16,6 +16,7 @@
 
 // builtin
 #include <optional>
+#include <vector>
 
 
 inline void glfw_error_callback(int error, const char* description)
@@ -28,24 +29,53 @@ class GraphicContext
     public:
 
         GLFWwindow* window = nullptr;
-        GLFWwindow* export_window = nullptr;
+        std::vector<GLFWwindow*> export_windows;
         std::optional<std::string_view> glsl_version;
 
         ImGuiIO* imgui_io = nullptr;
         
         bool initialized = false;
 
+        // no window or imgui, only the contexts used to render exports
+        bool headless = false;
+
+    private:
+
+        // sync objects are core since 3.2, above what is loaded here, so they may be missing
+        GLsync (GLAD_API_PTR *fence_sync)(GLenum condition, GLbitfield flags) = nullptr;
+        void (GLAD_API_PTR *wait_sync)(GLsync sync, GLbitfield flags, GLuint64 timeout) = nullptr;
+        void (GLAD_API_PTR *delete_sync)(GLsync sync) = nullptr;
+
+    private:
+
+        void load_opengl();
+
     public:
 
         void init();
+        void init_headless();
         void destroy();
 
         void start_frame();
         void end_frame(ImVec4 clear_color);
         void display_frame();
 
+        // windows can only be created from the main thread, so the ui creates the
+        // contexts of an export before starting it. they are kept for the next one
+        void reserve_export_contexts(size_t count);
+
         void make_current_main_context();
-        void make_current_export_context();
+        void make_current_export_context(size_t index = 0);
+
+        // a context can only be current on one thread at a time
+        void release_current_context();
+
+        // every context shares its objects, a fence created after an upload on one
+        // context and waited on by another makes the upload visible there. each
+        // context waits on it by itself, it is deleted once all of them did
+        GLsync create_fence();
+        void wait_fence(GLsync fence);
+        void delete_fence(GLsync fence);
 
         ~GraphicContext();
 };
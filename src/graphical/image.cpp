@@ -0,0 +1,126 @@
+// header
+#include "image.hpp"
+
+// extern
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+// builtin
+#include <algorithm>
+
+
+
+uint64_t Image::byte_size() const
+{
+    return this->size.x * this->size.y * Image::CHANNELS;
+}
+
+Image Image::downscale(uint64_t max_side) const
+{
+    if (this->size.x <= max_side && this->size.y <= max_side)
+        return *this;
+
+    auto longest = std::max(this->size.x, this->size.y);
+    auto new_size = glm::u64vec2{
+        std::max<uint64_t>((this->size.x * max_side) / longest, 1),
+        std::max<uint64_t>((this->size.y * max_side) / longest, 1)
+    };
+
+    auto output = Image::allocate(new_size);
+
+    const auto source = this->pixels.get();
+    auto destination = output.pixels.get();
+
+    // box filter, colors weighted by alpha so transparent pixels don't darken the edges
+    for (uint64_t y = 0; y < new_size.y; ++y)
+    {
+        auto source_y0 = (y * this->size.y) / new_size.y;
+        auto source_y1 = std::max(((y + 1) * this->size.y) / new_size.y, source_y0 + 1);
+
+        for (uint64_t x = 0; x < new_size.x; ++x)
+        {
+            auto source_x0 = (x * this->size.x) / new_size.x;
+            auto source_x1 = std::max(((x + 1) * this->size.x) / new_size.x, source_x0 + 1);
+
+            uint64_t color[3] = {0, 0, 0};
+            uint64_t alpha = 0;
+
+            for (auto sy = source_y0; sy < source_y1; ++sy)
+            {
+                auto row = source + (sy * this->size.x + source_x0) * Image::CHANNELS;
+
+                for (auto sx = source_x0; sx < source_x1; ++sx, row += Image::CHANNELS)
+                {
+                    color[0] += row[0] * row[3];
+                    color[1] += row[1] * row[3];
+                    color[2] += row[2] * row[3];
+                    alpha += row[3];
+                }
+            }
+
+            auto count = (source_x1 - source_x0) * (source_y1 - source_y0);
+            auto pixel = destination + (y * new_size.x + x) * Image::CHANNELS;
+
+            for (size_t channel = 0; channel < 3; ++channel)
+                pixel[channel] = alpha == 0 ? 0 : (uint8_t)(color[channel] / alpha);
+            pixel[3] = (uint8_t)(alpha / count);
+        }
+    }
+
+    return output;
+}
+
+
+Image Image::allocate(glm::u64vec2 size)
+{
+    Image image;
+    image.size = size;
+    image.pixels = std::shared_ptr<uint8_t>{new uint8_t[image.byte_size()], std::default_delete<uint8_t[]>()};
+
+    return image;
+}
+
+std::optional<Image> Image::decode(const std::string& path)
+{
+    int width;
+    int height;
+    uint8_t* pixels = stbi_load(path.c_str(), &width, &height, NULL, STBI_rgb_alpha);
+
+    if (pixels == nullptr)
+        return std::nullopt;
+
+    Image image;
+    image.size = {width, height};
+    image.pixels = std::shared_ptr<uint8_t>{pixels, stbi_image_free};
+
+    return image;
+}
+
+std::optional<Image> Image::decode(const uint8_t* data, size_t size)
+{
+    int width;
+    int height;
+    uint8_t* pixels = stbi_load_from_memory(data, size, &width, &height, NULL, STBI_rgb_alpha);
+
+    if (pixels == nullptr)
+        return std::nullopt;
+
+    Image image;
+    image.size = {width, height};
+    image.pixels = std::shared_ptr<uint8_t>{pixels, stbi_image_free};
+
+    return image;
+}
+
+std::optional<glm::u64vec2> Image::read_size(const std::string& path)
+{
+    // only parses the header, no pixel is decoded
+    int width;
+    int height;
+    int channels;
+
+    if (stbi_info(path.c_str(), &width, &height, &channels) == 0)
+        return std::nullopt;
+
+    return glm::u64vec2{width, height};
+}
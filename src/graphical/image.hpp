@@ -0,0 +1,30 @@
+#pragma once
+
+
+// builtin
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+// extern
+#include <glm/vec2.hpp>
+
+
+
+// decoded RGBA8 pixels living in RAM
+struct Image
+{
+    glm::u64vec2 size = {0, 0};
+    std::shared_ptr<uint8_t> pixels;
+
+    static constexpr uint64_t CHANNELS = 4;
+
+    uint64_t byte_size() const;
+    Image downscale(uint64_t max_side) const;
+
+    static Image allocate(glm::u64vec2 size);
+    static std::optional<Image> decode(const std::string& path);
+    static std::optional<Image> decode(const uint8_t* data, size_t size);
+    static std::optional<glm::u64vec2> read_size(const std::string& path);
+};
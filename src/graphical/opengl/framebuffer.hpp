@@ -19,16 +19,21 @@ class Framebuffer
         std::optional<GLuint> texture_id;
         uint64_t width;
         uint64_t height;
+        GLint internal_format;
+
+        // alpha is blended as coverage, so drawing over a transparent clear leaves
+        // premultiplied colors that can be saved with their transparency
+        bool premultiplied = false;
     
     public:
 
-        Framebuffer(uint64_t _width, uint64_t _height): width{_width}, height{_height}
+        Framebuffer(uint64_t _width, uint64_t _height, GLint _internal_format = GL_RGBA): width{_width}, height{_height}, internal_format{_internal_format}
         {
             this->texture_id = 0;
             glGenTextures(1, &this->texture_id.value());
             glBindTexture(GL_TEXTURE_2D, this->texture_id.value());
 
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, this->width, this->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            glTexImage2D(GL_TEXTURE_2D, 0, this->internal_format, this->width, this->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
             glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
@@ -54,6 +59,8 @@ class Framebuffer
 
             this->width = framebuffer.width;
             this->height = framebuffer.height;
+            this->internal_format = framebuffer.internal_format;
+            this->premultiplied = framebuffer.premultiplied;
         }
 
         Framebuffer& operator=(Framebuffer&& framebuffer)
@@ -71,6 +78,8 @@ class Framebuffer
 
             this->width = framebuffer.width;
             this->height = framebuffer.height;
+            this->internal_format = framebuffer.internal_format;
+            this->premultiplied = framebuffer.premultiplied;
 
             return *this;
         }
@@ -96,7 +105,7 @@ class Framebuffer
 
         void resize(uint64_t new_width, uint64_t new_height)
         {
-            *this = Framebuffer{new_width, new_height};
+            *this = Framebuffer{new_width, new_height, this->internal_format};
         }
 
         void clear(const glm::u8vec4 color)
@@ -114,6 +123,16 @@ class Framebuffer
             return {this->width, this->height};
         }
 
+        void set_premultiplied(bool _premultiplied)
+        {
+            this->premultiplied = _premultiplied;
+        }
+
+        bool is_premultiplied()
+        {
+            return this->premultiplied;
+        }
+
         GLuint get_texture_id()
         {
             return this->texture_id.value();
@@ -42,11 +42,16 @@ void render_sprite(const Sprite& sprite, glm::vec2 position, glm::vec2 size, dou
 
 void render_sprite(const Sprite& sprite, glm::vec2 position, const glm::vec2 size, double angle, glm::vec2 pivot, Framebuffer& framebuffer)
 {
-    const auto func = [&sprite, position, size]()
+    render_texture(sprite.id.value(), position, size, angle, pivot, framebuffer);
+}
+
+void render_texture(GLuint texture_id, glm::vec2 position, const glm::vec2 size, double angle, glm::vec2 pivot, Framebuffer& framebuffer)
+{
+    const auto func = [texture_id, position, size]()
     {
         // carrega a textura
         glEnable(GL_TEXTURE_2D);
-        glBindTexture(GL_TEXTURE_2D, sprite.id.value());
+        glBindTexture(GL_TEXTURE_2D, texture_id);
 
         glBegin(GL_QUADS);
 
@@ -81,7 +86,11 @@ void render(std::function<void(void)> func, double angle, glm::vec2 pivot, Frame
     glEnable(GL_BLEND);
     glDisable(GL_LIGHTING);
     glDisable(GL_DEPTH_TEST);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    if (framebuffer.is_premultiplied())
+        glBlendFuncSeparate(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+    else
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
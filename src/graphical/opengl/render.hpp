@@ -13,5 +13,6 @@
 
 void render_sprite(const Sprite& sprite, glm::vec2 position, glm::vec2 size, double angle, Framebuffer& framebuffer);
 void render_sprite(const Sprite& sprite, glm::vec2 position, glm::vec2 size, double angle, glm::vec2 pivot, Framebuffer& framebuffer);
+void render_texture(GLuint texture_id, glm::vec2 position, glm::vec2 size, double angle, glm::vec2 pivot, Framebuffer& framebuffer);
 void render_color(const glm::u8vec4 color, const glm::vec2 position, glm::vec2 size, double angle, Framebuffer& framebuffer);
 void render_color(const glm::u8vec4 color, const glm::vec2 position, glm::vec2 size, double angle, glm::vec2 pivot, Framebuffer& framebuffer);
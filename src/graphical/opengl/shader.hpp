@@ -0,0 +1,135 @@
+#pragma once
+
+
+// local
+#include "graphical/graphics.hpp"
+#include "utils/log.hpp"
+
+// builtin
+#include <algorithm>
+#include <optional>
+#include <string>
+#include <vector>
+
+
+
+class ShaderProgram
+{
+    private:
+
+        GLuint id = 0;
+
+    public:
+
+        // the fragment shader's output must be named "output_color". a driver that
+        // can't build it leaves the program invalid instead of failing, see "is_valid"
+        ShaderProgram(const std::string& vertex_source, const std::string& fragment_source)
+        {
+            auto vertex_shader = ShaderProgram::compile(GL_VERTEX_SHADER, vertex_source);
+            auto fragment_shader = ShaderProgram::compile(GL_FRAGMENT_SHADER, fragment_source);
+
+            if (vertex_shader.has_value() == false || fragment_shader.has_value() == false)
+            {
+                if (vertex_shader.has_value())
+                    glDeleteShader(vertex_shader.value());
+                if (fragment_shader.has_value())
+                    glDeleteShader(fragment_shader.value());
+
+                return;
+            }
+
+            this->id = glCreateProgram();
+            glAttachShader(this->id, vertex_shader.value());
+            glAttachShader(this->id, fragment_shader.value());
+            glBindFragDataLocation(this->id, 0, "output_color");
+            glLinkProgram(this->id);
+
+            // the program keeps them alive while it is attached
+            glDeleteShader(vertex_shader.value());
+            glDeleteShader(fragment_shader.value());
+
+            GLint linked = GL_FALSE;
+            glGetProgramiv(this->id, GL_LINK_STATUS, &linked);
+
+            if (linked == GL_FALSE)
+            {
+                warn(fmt::format("could not link shader program: {}", ShaderProgram::get_program_log(this->id)));
+
+                glDeleteProgram(this->id);
+                this->id = 0;
+            }
+        }
+
+        ~ShaderProgram()
+        {
+            if (this->id != 0)
+                glDeleteProgram(this->id);
+        }
+
+        ShaderProgram(const ShaderProgram&) = delete;
+        ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+
+
+        // false if a shader didn't compile or the program didn't link, the reason was logged
+        bool is_valid()
+        {
+            return this->id != 0;
+        }
+
+        void bind()
+        {
+            glUseProgram(this->id);
+        }
+
+        void unbind()
+        {
+            glUseProgram(0);
+        }
+
+        GLint get_uniform_location(const std::string& name)
+        {
+            return glGetUniformLocation(this->id, name.c_str());
+        }
+
+    private:
+
+        static std::optional<GLuint> compile(GLenum type, const std::string& source)
+        {
+            auto shader = glCreateShader(type);
+            auto source_data = source.c_str();
+
+            glShaderSource(shader, 1, &source_data, nullptr);
+            glCompileShader(shader);
+
+            GLint compiled = GL_FALSE;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+
+            if (compiled == GL_FALSE)
+            {
+                GLint length = 0;
+                glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
+
+                std::vector<char> message(std::max(length, 1), '\0');
+                glGetShaderInfoLog(shader, message.size(), nullptr, message.data());
+
+                warn(fmt::format("could not compile shader: {}", message.data()));
+                glDeleteShader(shader);
+
+                return std::nullopt;
+            }
+
+            return shader;
+        }
+
+        static std::string get_program_log(GLuint program)
+        {
+            GLint length = 0;
+            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length);
+
+            std::vector<char> message(std::max(length, 1), '\0');
+            glGetProgramInfoLog(program, message.size(), nullptr, message.data());
+
+            return message.data();
+        }
+};
@@ -0,0 +1,98 @@
+#pragma once
+
+
+// local
+#include "graphical/image.hpp"
+
+// extern
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+// builtin
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+
+
+enum class Sampling
+{
+    NEAREST,
+    BILINEAR
+};
+
+// a rotated rectangle, textured when it has an image and filled with "color" otherwise
+struct SoftwareQuad
+{
+    std::optional<Image> image;
+    glm::u8vec4 color;
+
+    glm::vec2 position;
+    glm::vec2 size;
+    double angle;
+    glm::vec2 pivot;
+
+    Sampling sampling;
+};
+
+
+// RGBA8 pixels in RAM, rows in the same order glReadPixels returns them from a
+// Framebuffer, so both backends produce the same image for the same calls.
+// quads are queued and drawn together, each band of rows by its own thread
+class SoftwareFramebuffer
+{
+    private:
+
+        uint64_t width;
+        uint64_t height;
+        std::vector<uint8_t> pixels;
+        std::vector<SoftwareQuad> pending;
+
+        // same as on the opengl framebuffer
+        bool premultiplied = false;
+
+    public:
+
+        SoftwareFramebuffer(uint64_t _width, uint64_t _height): width{_width}, height{_height}, pixels(_width * _height * Image::CHANNELS, 0)
+        {
+        }
+
+        void clear(const glm::u8vec4 color)
+        {
+            this->pending.clear();
+
+            for (uint64_t i = 0; i < this->pixels.size(); i += Image::CHANNELS)
+            {
+                this->pixels[i + 0] = color.r;
+                this->pixels[i + 1] = color.g;
+                this->pixels[i + 2] = color.b;
+                this->pixels[i + 3] = color.a;
+            }
+        }
+
+        void push(SoftwareQuad quad)
+        {
+            this->pending.push_back(std::move(quad));
+        }
+
+        // draws the queued quads in order, "parallel" spreads the bands over the
+        // thread pool, callers already rendering a frame per thread turn it off
+        void flush(bool parallel = true);
+
+        // flushes first
+        const uint8_t* get_pixels()
+        {
+            this->flush();
+            return this->pixels.data();
+        }
+
+        glm::u64vec2 get_size()
+        {
+            return {this->width, this->height};
+        }
+
+        void set_premultiplied(bool _premultiplied)
+        {
+            this->premultiplied = _premultiplied;
+        }
+};
@@ -0,0 +1,332 @@
+// header
+#include "render.hpp"
+
+// local
+#include "utils/thread_pool.hpp"
+
+// builtin
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <future>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+#endif
+
+
+
+// rows drawn by one task, small enough to spread a frame over every core
+static const uint64_t BAND_HEIGHT = 32;
+
+
+// maps the center of a pixel back into the quad, "u" and "v" go from 0 to 1 across it
+struct QuadMapping
+{
+    // u = u_origin + u_dx * x + u_dy * y
+    double u_origin, u_dx, u_dy;
+    double v_origin, v_dx, v_dy;
+
+    // pixels the rotated quad may cover, the maximums are exclusive
+    int64_t min_x, min_y, max_x, max_y;
+};
+
+
+static std::optional<QuadMapping> map_quad(const SoftwareQuad& quad, glm::u64vec2 framebuffer_size)
+{
+    if (quad.size.x == 0 || quad.size.y == 0)
+        return std::nullopt;
+
+    const double radians = quad.angle * 3.14159265358979323846 / 180;
+    const double c = std::cos(radians);
+    const double s = std::sin(radians);
+
+    const glm::dvec2 pivot = quad.pivot;
+    const glm::dvec2 size = quad.size;
+    const glm::dvec2 top_left = (glm::dvec2)quad.position - size / 2.0;
+
+    // the opengl path rotates the vertices around the pivot, here the pixels are
+    // rotated back instead: local = pivot + rotate(-angle, pixel - pivot)
+    QuadMapping output;
+    output.u_dx = c / size.x;
+    output.u_dy = s / size.x;
+    output.u_origin = (pivot.x - c * pivot.x - s * pivot.y - top_left.x) / size.x;
+
+    output.v_dx = -s / size.y;
+    output.v_dy = c / size.y;
+    output.v_origin = (pivot.y + s * pivot.x - c * pivot.y - top_left.y) / size.y;
+
+    // pixel centers are half a pixel in
+    output.u_origin += (output.u_dx + output.u_dy) / 2;
+    output.v_origin += (output.v_dx + output.v_dy) / 2;
+
+    glm::dvec2 min{INFINITY, INFINITY};
+    glm::dvec2 max{-INFINITY, -INFINITY};
+
+    for (auto corner: {top_left, top_left + glm::dvec2{size.x, 0}, top_left + size, top_left + glm::dvec2{0, size.y}})
+    {
+        auto offset = corner - pivot;
+        auto rotated = pivot + glm::dvec2{c * offset.x - s * offset.y, s * offset.x + c * offset.y};
+
+        min = {std::min(min.x, rotated.x), std::min(min.y, rotated.y)};
+        max = {std::max(max.x, rotated.x), std::max(max.y, rotated.y)};
+    }
+
+    output.min_x = std::max<int64_t>((int64_t)std::floor(min.x), 0);
+    output.min_y = std::max<int64_t>((int64_t)std::floor(min.y), 0);
+    output.max_x = std::min<int64_t>((int64_t)std::ceil(max.x), framebuffer_size.x);
+    output.max_y = std::min<int64_t>((int64_t)std::ceil(max.y), framebuffer_size.y);
+
+    if (output.min_x >= output.max_x || output.min_y >= output.max_y)
+        return std::nullopt;
+
+    return output;
+}
+
+
+static uint32_t load_pixel(const uint8_t* pixels, uint64_t width, uint64_t x, uint64_t y)
+{
+    uint32_t output;
+    std::memcpy(&output, pixels + (y * width + x) * Image::CHANNELS, sizeof(output));
+    return output;
+}
+
+static uint32_t sample_nearest(const Image& image, float u, float v)
+{
+    auto x = std::min<uint64_t>((uint64_t)(u * image.size.x), image.size.x - 1);
+    auto y = std::min<uint64_t>((uint64_t)(v * image.size.y), image.size.y - 1);
+
+    return load_pixel(image.pixels.get(), image.size.x, x, y);
+}
+
+// clamped to the edges, weights have 8 bits of precision
+static uint32_t sample_bilinear(const Image& image, float u, float v)
+{
+    const float x = u * image.size.x - 0.5f;
+    const float y = v * image.size.y - 0.5f;
+
+    const auto x0 = (int64_t)std::floor(x);
+    const auto y0 = (int64_t)std::floor(y);
+    const auto weight_x = (uint32_t)((x - x0) * 256);
+    const auto weight_y = (uint32_t)((y - y0) * 256);
+
+    const auto clamp_x = [&](int64_t value){ return (uint64_t)std::clamp<int64_t>(value, 0, image.size.x - 1); };
+    const auto clamp_y = [&](int64_t value){ return (uint64_t)std::clamp<int64_t>(value, 0, image.size.y - 1); };
+
+    const uint32_t taps[4] = {
+        load_pixel(image.pixels.get(), image.size.x, clamp_x(x0), clamp_y(y0)),
+        load_pixel(image.pixels.get(), image.size.x, clamp_x(x0 + 1), clamp_y(y0)),
+        load_pixel(image.pixels.get(), image.size.x, clamp_x(x0), clamp_y(y0 + 1)),
+        load_pixel(image.pixels.get(), image.size.x, clamp_x(x0 + 1), clamp_y(y0 + 1))
+    };
+
+    uint32_t output = 0;
+
+    for (uint32_t channel = 0; channel < 4; ++channel)
+    {
+        const auto shift = channel * 8;
+        const auto top = ((taps[0] >> shift) & 0xFF) * (256 - weight_x) + ((taps[1] >> shift) & 0xFF) * weight_x;
+        const auto bottom = ((taps[2] >> shift) & 0xFF) * (256 - weight_x) + ((taps[3] >> shift) & 0xFF) * weight_x;
+
+        output |= ((top * (256 - weight_y) + bottom * weight_y + 32768) >> 16) << shift;
+    }
+
+    return output;
+}
+
+static uint32_t sample(const SoftwareQuad& quad, float u, float v)
+{
+    if (quad.image.has_value() == false)
+    {
+        uint32_t color;
+        std::memcpy(&color, &quad.color, sizeof(color));
+        return color;
+    }
+
+    if (quad.sampling == Sampling::BILINEAR)
+        return sample_bilinear(quad.image.value(), u, v);
+    else
+        return sample_nearest(quad.image.value(), u, v);
+}
+
+
+// source over, like glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA) on every channel,
+// or with GL_ONE for the alpha when the framebuffer is premultiplied
+static uint8_t blend_channel(uint32_t source, uint32_t destination, uint32_t factor, uint32_t alpha)
+{
+    auto value = source * factor + destination * (255 - alpha) + 128;
+    return (uint8_t)((value + (value >> 8)) >> 8);
+}
+
+static void blend_pixel(uint32_t source, uint8_t* destination, bool premultiplied)
+{
+    const uint32_t alpha = source >> 24;
+
+    for (uint32_t channel = 0; channel < 3; ++channel)
+        destination[channel] = blend_channel((source >> (channel * 8)) & 0xFF, destination[channel], alpha, alpha);
+
+    destination[3] = blend_channel(alpha, destination[3], premultiplied ? 255 : alpha, alpha);
+}
+
+#if defined(__SSE2__) || defined(_M_X64)
+
+// four pixels at once in 16 bit lanes, same rounding as "blend_channel"
+static __m128i blend_sse2(__m128i source, __m128i destination, bool premultiplied)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i full = _mm_set1_epi16(255);
+    const __m128i half = _mm_set1_epi16(128);
+
+    // the alpha lanes of the source factor, 255 when premultiplied
+    const __m128i color_lanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+    const __m128i alpha_factor = premultiplied ? _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0) : zero;
+
+    const auto blend_half = [&](__m128i source, __m128i destination)
+    {
+        __m128i alpha = _mm_shufflelo_epi16(source, _MM_SHUFFLE(3, 3, 3, 3));
+        alpha = _mm_shufflehi_epi16(alpha, _MM_SHUFFLE(3, 3, 3, 3));
+
+        __m128i factor = premultiplied ? _mm_or_si128(_mm_and_si128(alpha, color_lanes), alpha_factor) : alpha;
+
+        __m128i value = _mm_add_epi16(_mm_mullo_epi16(source, factor), _mm_mullo_epi16(destination, _mm_sub_epi16(full, alpha)));
+        value = _mm_add_epi16(value, half);
+
+        return _mm_srli_epi16(_mm_add_epi16(value, _mm_srli_epi16(value, 8)), 8);
+    };
+
+    __m128i low = blend_half(_mm_unpacklo_epi8(source, zero), _mm_unpacklo_epi8(destination, zero));
+    __m128i high = blend_half(_mm_unpackhi_epi8(source, zero), _mm_unpackhi_epi8(destination, zero));
+
+    return _mm_packus_epi16(low, high);
+}
+
+#endif
+
+
+static void draw_span(const SoftwareQuad& quad, const QuadMapping& mapping, int64_t y, uint8_t* row, bool premultiplied)
+{
+    const double row_u = mapping.u_origin + mapping.u_dy * y;
+    const double row_v = mapping.v_origin + mapping.v_dy * y;
+
+    int64_t x = mapping.min_x;
+
+    #if defined(__SSE2__) || defined(_M_X64)
+
+        const __m128 steps = _mm_set_ps(3, 2, 1, 0);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1);
+        const __m128 u_step = _mm_set1_ps((float)mapping.u_dx);
+        const __m128 v_step = _mm_set1_ps((float)mapping.v_dx);
+
+        for (; x + 4 <= mapping.max_x; x += 4)
+        {
+            const __m128 u = _mm_add_ps(_mm_set1_ps((float)(row_u + mapping.u_dx * x)), _mm_mul_ps(u_step, steps));
+            const __m128 v = _mm_add_ps(_mm_set1_ps((float)(row_v + mapping.v_dx * x)), _mm_mul_ps(v_step, steps));
+
+            const __m128 inside = _mm_and_ps(
+                _mm_and_ps(_mm_cmpge_ps(u, zero), _mm_cmplt_ps(u, one)),
+                _mm_and_ps(_mm_cmpge_ps(v, zero), _mm_cmplt_ps(v, one))
+            );
+
+            const int mask = _mm_movemask_ps(inside);
+            if (mask == 0)
+                continue;
+
+            alignas(16) float us[4];
+            alignas(16) float vs[4];
+            _mm_store_ps(us, u);
+            _mm_store_ps(vs, v);
+
+            // the texels are gathered one by one, outside pixels stay transparent and leave the destination as it is
+            alignas(16) uint32_t source[4] = {0, 0, 0, 0};
+            for (int lane = 0; lane < 4; ++lane)
+                if (mask & (1 << lane))
+                    source[lane] = sample(quad, us[lane], vs[lane]);
+
+            auto destination = (__m128i*)(row + x * Image::CHANNELS);
+            _mm_storeu_si128(destination, blend_sse2(_mm_load_si128((const __m128i*)source), _mm_loadu_si128(destination), premultiplied));
+        }
+
+    #endif
+
+    for (; x < mapping.max_x; ++x)
+    {
+        const auto u = (float)(row_u + mapping.u_dx * x);
+        const auto v = (float)(row_v + mapping.v_dx * x);
+
+        if (u < 0 || u >= 1 || v < 0 || v >= 1)
+            continue;
+
+        blend_pixel(sample(quad, u, v), row + x * Image::CHANNELS, premultiplied);
+    }
+}
+
+
+void SoftwareFramebuffer::flush(bool parallel)
+{
+    if (this->pending.empty())
+        return;
+
+    std::vector<std::optional<QuadMapping>> mappings;
+    mappings.reserve(this->pending.size());
+
+    for (auto& quad: this->pending)
+        mappings.push_back(map_quad(quad, this->get_size()));
+
+    // every band draws every quad in order, so the blending order is the same as
+    // drawing them one after the other
+    const auto draw_band = [this, &mappings](uint64_t band)
+    {
+        const auto band_start = (int64_t)(band * BAND_HEIGHT);
+        const auto band_end = (int64_t)std::min((band + 1) * BAND_HEIGHT, this->height);
+
+        for (size_t i = 0; i < this->pending.size(); ++i)
+        {
+            if (mappings[i].has_value() == false)
+                continue;
+
+            auto& mapping = mappings[i].value();
+
+            for (auto y = std::max(band_start, mapping.min_y); y < std::min(band_end, mapping.max_y); ++y)
+                draw_span(this->pending[i], mapping, y, this->pixels.data() + y * this->width * Image::CHANNELS, this->premultiplied);
+        }
+    };
+
+    const uint64_t band_count = (this->height + BAND_HEIGHT - 1) / BAND_HEIGHT;
+
+    if (parallel && band_count > 1)
+    {
+        std::vector<std::future<void>> bands;
+        for (uint64_t band = 0; band < band_count; ++band)
+            bands.push_back(thread_pool.submit([&draw_band, band](){ draw_band(band); }));
+
+        for (auto& band: bands)
+            band.get();
+    }
+    else
+    {
+        for (uint64_t band = 0; band < band_count; ++band)
+            draw_band(band);
+    }
+
+    this->pending.clear();
+}
+
+
+void render_image(const Image& image, glm::vec2 position, glm::vec2 size, double angle, glm::vec2 pivot, SoftwareFramebuffer& framebuffer, Sampling sampling)
+{
+    if (image.size.x == 0 || image.size.y == 0)
+        return;
+
+    framebuffer.push(SoftwareQuad{image, {255, 255, 255, 255}, position, size, angle, pivot, sampling});
+}
+
+void render_color(const glm::u8vec4 color, const glm::vec2 position, glm::vec2 size, double angle, SoftwareFramebuffer& framebuffer)
+{
+    render_color(color, position, size, angle, glm::vec2{position + (size / glm::vec2{2, 2})}, framebuffer);
+}
+
+void render_color(const glm::u8vec4 color, const glm::vec2 position, glm::vec2 size, double angle, glm::vec2 pivot, SoftwareFramebuffer& framebuffer)
+{
+    framebuffer.push(SoftwareQuad{std::nullopt, color, position, size, angle, pivot, Sampling::NEAREST});
+}
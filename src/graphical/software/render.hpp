@@ -0,0 +1,18 @@
+#pragma once
+
+
+// local
+#include "graphical/image.hpp"
+#include "framebuffer.hpp"
+
+// extern
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+
+
+
+// same geometry and blending as the opengl versions in "graphical/opengl/render.hpp",
+// for machines without a gpu. the quads are only drawn once the framebuffer is flushed
+void render_image(const Image& image, glm::vec2 position, glm::vec2 size, double angle, glm::vec2 pivot, SoftwareFramebuffer& framebuffer, Sampling sampling = Sampling::NEAREST);
+void render_color(const glm::u8vec4 color, const glm::vec2 position, glm::vec2 size, double angle, SoftwareFramebuffer& framebuffer);
+void render_color(const glm::u8vec4 color, const glm::vec2 position, glm::vec2 size, double angle, glm::vec2 pivot, SoftwareFramebuffer& framebuffer);
@@ -1,56 +1,85 @@
 // header
 #include "sprite.hpp"
 
-// extern
-#define STB_IMAGE_IMPLEMENTATION
-#include "stb_image.h"
+// local
+#include "utils/file_io.hpp"
+#include "utils/hash.hpp"
+#include "utils/thread_pool.hpp"
 
 // builtin
+#include <cstring>
 #include <filesystem>
 
 
 
-Sprite::Sprite(std::string const _path): path{std::move(_path)}
+Texture::Texture(const Image& image, uint64_t content_hash, std::optional<GLuint> pixel_buffer): size{image.size}, content_hash{content_hash}
 {
-    if (!std::filesystem::exists(_path) || !std::filesystem::is_regular_file(_path))
-        panic("file does not exists");
-
-    int width;
-    int height;
-    uint8_t* image_texture = stbi_load(path.c_str(), &width, &height, NULL, STBI_rgb_alpha);
-    this->size.x = width;
-    this->size.y = height;
-    
-    leaf_runtime_assert(image_texture != nullptr);
-
-    this->id = 0;
-    glGenTextures(1, &this->id.value());
-    glBindTexture(GL_TEXTURE_2D, this->id.value());
+    glGenTextures(1, &this->id);
+    glBindTexture(GL_TEXTURE_2D, this->id);
 
     // Setup filtering parameters for display
+    // (no mipmaps are generated, nearest minification never samples them)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
     if (GL_UNPACK_ROW_LENGTH)
         glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
-    
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, this->size.x, this->size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, image_texture);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    stbi_image_free(image_texture);
+
+    const void* source = image.pixels.get();
+
+    // stage the pixels in a pixel buffer so the driver can copy them asynchronously
+    if (pixel_buffer.has_value())
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pixel_buffer.value());
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, image.byte_size(), nullptr, GL_STREAM_DRAW);
+
+        auto mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, image.byte_size(), GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+        if (mapped != nullptr)
+        {
+            memcpy(mapped, image.pixels.get(), image.byte_size());
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+            source = nullptr;
+        }
+        else
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, this->size.x, this->size.y, 0, GL_RGBA, GL_UNSIGNED_BYTE, source);
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
 }
 
-Sprite::Sprite(Sprite&& sprite)
+Texture::~Texture()
 {
-    std::swap(this->id, sprite.id);
-    std::swap(this->size.x, sprite.size.x);
-    std::swap(this->size.y, sprite.size.y);
-    std::swap(this->path, sprite.path);
+    glDeleteTextures(1, &this->id);
 }
 
-Sprite::~Sprite()
-{   
-    if (this->id.has_value())
-        glDeleteTextures(1, &this->id.value());
+uint64_t Texture::byte_size() const
+{
+    return this->size.x * this->size.y * Image::CHANNELS;
+}
+
+
+
+Sprite::Sprite(std::string const _path, glm::u64vec2 _size, GLuint placeholder_id): id{placeholder_id}, size{_size}, path{std::move(_path)}
+{
+}
+
+
+void Sprite::attach(std::shared_ptr<Texture> texture)
+{
+    leaf_assert(this->ready == false);
+
+    this->id = texture->id;
+    this->size = texture->size;
+    this->texture = std::move(texture);
+    this->ready = true;
+}
+
+uint64_t Sprite::byte_size() const
+{
+    return this->size.x * this->size.y * Image::CHANNELS;
 }
 
 
@@ -63,23 +92,463 @@ bool SpriteManager::sprite_exists(const std::string& path)
 
 void SpriteManager::load_sprite(const std::string& path)
 {
-    this->sprites.insert({path, Sprite{path}});
+    if (auto entry = this->sprites.find(path); entry != this->sprites.end())
+        this->erase(entry);
+
+    auto content = std::filesystem::is_regular_file(path) ? try_read_file(path) : std::nullopt;
+    if (content.has_value() == false)
+    {
+        this->insert_failed(path, Usage::Project, fmt::format("could not read image '{}'", path));
+        return;
+    }
+
+    auto content_hash = hash_bytes(content->data(), content->size());
+    auto texture = this->find_texture(content_hash);
+
+    if (texture != nullptr)
+        this->stats.dedupe_hits += 1;
+    else
+    {
+        auto image = Image::decode((const uint8_t*)content->data(), content->size());
+        if (image.has_value() == false)
+        {
+            this->insert_failed(path, Usage::Project, fmt::format("could not decode image '{}'", path));
+            return;
+        }
+
+        texture = this->create_texture(image.value(), content_hash);
+    }
+
+    this->insert(path, Sprite{path, texture->size, this->get_placeholder_id()}, Usage::Project);
+    this->attach(this->sprites.at(path), texture);
+}
+
+void SpriteManager::request_sprite(const std::string& path, Usage usage)
+{
+    if (this->sprite_exists(path))
+        return;
+
+    // the header is read right away so layouts don't jump when the pixels arrive
+    auto size = std::filesystem::is_regular_file(path) ? Image::read_size(path) : std::nullopt;
+    if (size.has_value() == false)
+    {
+        this->insert_failed(path, usage, fmt::format("could not read image '{}'", path));
+        return;
+    }
+
+    this->insert(path, Sprite{path, size.value(), this->get_placeholder_id()}, usage);
+
+    this->deferred_decodes.push_back(path);
+    this->submit_deferred_decodes();
+}
+
+const Sprite& SpriteManager::get_sprite(const std::string& path, Usage usage)
+{
+    if (this->sprite_exists(path))
+        this->stats.hits += 1;
+    else
+    {
+        this->stats.misses += 1;
+        this->request_sprite(path, usage);
+    }
+
+    return this->touch(path, usage).sprite;
 }
 
-const Sprite& SpriteManager::get_sprite(const std::string& path)
+const Sprite& SpriteManager::get_ready_sprite(const std::string& path)
 {
-    if (this->sprite_exists(path) == false)
+    // a failed one is only tried again once the watcher reloads it
+    if (auto entry = this->sprites.find(path); entry == this->sprites.end() || (entry->second.sprite.ready == false && entry->second.sprite.failed == false))
+    {
+        this->stats.misses += 1;
         this->load_sprite(path);
-        
-    return this->sprites[path];
+    }
+    else
+        this->stats.hits += 1;
+
+    return this->touch(path, Usage::Project).sprite;
+}
+
+void SpriteManager::reload_sprite(const std::string& path)
+{
+    auto entry = this->sprites.find(path);
+    if (entry == this->sprites.end())
+        return;
+
+    // a removed or unreadable file keeps its last texture until it is freed
+    if (!std::filesystem::is_regular_file(path) || !Image::read_size(path).has_value())
+        return;
+
+    auto usage = entry->second.browser_only ? Usage::Browser : Usage::Project;
+    this->erase(entry);
+    this->request_sprite(path, usage);
+}
+
+void SpriteManager::insert_failed(const std::string& path, Usage usage, const std::string& message)
+{
+    warn(message);
+
+    // the size of the placeholder, the file didn't tell its own
+    auto sprite = Sprite{path, {1, 1}, this->get_placeholder_id()};
+    sprite.failed = true;
+
+    this->insert(path, std::move(sprite), usage);
 }
 
 void SpriteManager::free_sprite(const std::string& path)
 {
-    this->sprites.erase(path);
+    if (auto entry = this->sprites.find(path); entry != this->sprites.end())
+        this->erase(entry);
 }
 
 void SpriteManager::clear()
 {
     this->sprites.clear();
+    this->textures.clear();
+    this->decoding.clear();
+    this->lru.clear();
+    this->deferred_decodes.clear();
+    this->stats = Stats{};
+
+    // results of decodes still in flight go to the old queue and are dropped
+    this->decoded = std::make_shared<DecodeQueue>();
+
+    if (this->placeholder_id.has_value())
+        glDeleteTextures(1, &this->placeholder_id.value());
+    this->placeholder_id = std::nullopt;
+
+    if (this->upload_buffers.empty() == false)
+        glDeleteBuffers(this->upload_buffers.size(), this->upload_buffers.data());
+    this->upload_buffers.clear();
+}
+
+
+void SpriteManager::update()
+{
+    this->frame += 1;
+
+    std::vector<Hashed> hashed;
+    std::vector<Decoded> images;
+
+    {
+        std::lock_guard lock{this->decoded->mutex};
+        std::swap(hashed, this->decoded->hashed);
+
+        auto& pending = this->decoded->images;
+
+        auto count = std::min(pending.size(), SpriteManager::max_uploads_per_frame);
+        std::move(pending.begin(), pending.begin() + count, std::back_inserter(images));
+        pending.erase(pending.begin(), pending.begin() + count);
+    }
+
+    for (auto& result: hashed)
+        this->process_hashed(std::move(result));
+
+    for (auto& result: images)
+        this->process_decoded(std::move(result));
+
+    this->submit_deferred_decodes();
+    this->evict();
+}
+
+
+void SpriteManager::set_pinned(std::unordered_set<std::string> paths)
+{
+    this->pinned = std::move(paths);
+}
+
+void SpriteManager::set_budget(uint64_t gpu_bytes, uint64_t cpu_bytes)
+{
+    this->gpu_budget = gpu_bytes;
+    this->cpu_budget = cpu_bytes;
+}
+
+SpriteManager::Stats SpriteManager::get_stats()
+{
+    return this->stats;
+}
+
+
+SpriteManager::Entry& SpriteManager::touch(const std::string& path, Usage usage)
+{
+    auto& entry = this->sprites.at(path);
+
+    this->lru.splice(this->lru.begin(), this->lru, entry.lru_position);
+    entry.last_used_frame = this->frame;
+
+    if (usage == Usage::Project)
+        entry.browser_only = false;
+
+    return entry;
+}
+
+void SpriteManager::insert(const std::string& path, Sprite sprite, Usage usage)
+{
+    leaf_assert(this->sprite_exists(path) == false);
+
+    this->lru.push_front(path);
+
+    this->sprites.emplace(path, Entry{std::move(sprite), this->lru.begin(), this->frame, usage == Usage::Browser});
+}
+
+void SpriteManager::erase(std::unordered_map<std::string, Entry>::iterator entry)
+{
+    // the texture is only freed with its last sprite
+    if (entry->second.sprite.ready)
+    {
+        auto shared = this->textures.find(entry->second.sprite.texture->content_hash);
+        auto bytes = shared->second.texture->byte_size();
+
+        shared->second.users -= 1;
+
+        if (shared->second.users != 0)
+            this->stats.deduplicated_bytes -= bytes;
+        else
+        {
+            this->stats.resident_gpu_bytes -= bytes;
+            this->textures.erase(shared);
+        }
+    }
+
+    this->lru.erase(entry->second.lru_position);
+    this->sprites.erase(entry);
+}
+
+void SpriteManager::attach(Entry& entry, std::shared_ptr<Texture> texture)
+{
+    auto& shared = this->textures.at(texture->content_hash);
+
+    shared.users += 1;
+    if (shared.users > 1)
+        this->stats.deduplicated_bytes += texture->byte_size();
+
+    entry.sprite.attach(std::move(texture));
+}
+
+void SpriteManager::submit_hash(const std::string& path)
+{
+    auto reserved_bytes = this->sprites.at(path).sprite.byte_size();
+    this->stats.resident_cpu_bytes += reserved_bytes;
+
+    thread_pool.submit([path, reserved_bytes, decoded = this->decoded]()
+    {
+        Hashed hashed{path, reserved_bytes, 0, nullptr};
+
+        if (auto content = try_read_file(path); content.has_value())
+        {
+            hashed.content_hash = hash_bytes(content->data(), content->size());
+            hashed.content = std::make_shared<std::string>(std::move(content.value()));
+        }
+
+        std::lock_guard lock{decoded->mutex};
+        decoded->hashed.push_back(std::move(hashed));
+    });
+}
+
+void SpriteManager::submit_deferred_decodes()
+{
+    // decoded pixels wait in RAM until they are uploaded, so only as many
+    // decodes as fit in the cpu budget are in flight at once
+    while (this->deferred_decodes.empty() == false)
+    {
+        const auto& path = this->deferred_decodes.front();
+
+        auto entry = this->sprites.find(path);
+        if (entry == this->sprites.end() || entry->second.sprite.ready)
+        {
+            this->deferred_decodes.pop_front();
+            continue;
+        }
+
+        auto bytes = entry->second.sprite.byte_size();
+        if (this->stats.resident_cpu_bytes != 0 && this->stats.resident_cpu_bytes + bytes > this->cpu_budget)
+            break;
+
+        this->submit_hash(path);
+        this->deferred_decodes.pop_front();
+    }
+}
+
+void SpriteManager::process_hashed(Hashed hashed)
+{
+    // freed or synchronously loaded while it was being read
+    auto entry = this->sprites.find(hashed.path);
+    if (entry == this->sprites.end() || entry->second.sprite.ready)
+    {
+        this->stats.resident_cpu_bytes -= hashed.reserved_bytes;
+        return;
+    }
+
+    // removed or replaced since it was requested, the watcher reloads it if it comes back
+    if (hashed.content == nullptr)
+    {
+        this->stats.resident_cpu_bytes -= hashed.reserved_bytes;
+        warn(fmt::format("could not read image '{}'", hashed.path));
+        entry->second.sprite.failed = true;
+        return;
+    }
+
+    // an identical file is already resident
+    if (auto texture = this->find_texture(hashed.content_hash); texture != nullptr)
+    {
+        this->stats.resident_cpu_bytes -= hashed.reserved_bytes;
+        this->stats.dedupe_hits += 1;
+        this->attach(entry->second, std::move(texture));
+        return;
+    }
+
+    // or is being decoded for another path
+    if (auto waiting = this->decoding.find(hashed.content_hash); waiting != this->decoding.end())
+    {
+        this->stats.resident_cpu_bytes -= hashed.reserved_bytes;
+        this->stats.dedupe_hits += 1;
+        waiting->second.push_back(hashed.path);
+        return;
+    }
+
+    this->decoding[hashed.content_hash] = {hashed.path};
+
+    thread_pool.submit([content_hash = hashed.content_hash, reserved_bytes = hashed.reserved_bytes, content = hashed.content, decoded = this->decoded]()
+    {
+        auto image = Image::decode((const uint8_t*)content->data(), content->size());
+
+        std::lock_guard lock{decoded->mutex};
+        decoded->images.push_back(Decoded{content_hash, reserved_bytes, std::move(image)});
+    });
+}
+
+void SpriteManager::process_decoded(Decoded decoded)
+{
+    this->stats.resident_cpu_bytes -= decoded.reserved_bytes;
+
+    // dropped by clear() while it was decoding
+    auto waiting = this->decoding.find(decoded.content_hash);
+    if (waiting == this->decoding.end())
+        return;
+
+    auto paths = std::move(waiting->second);
+    this->decoding.erase(waiting);
+
+    // may have been loaded synchronously in the meantime
+    auto texture = this->find_texture(decoded.content_hash);
+
+    for (auto& path: paths)
+    {
+        auto entry = this->sprites.find(path);
+        if (entry == this->sprites.end() || entry->second.sprite.ready)
+            continue;
+
+        if (texture == nullptr)
+        {
+            // half written when it was read, the watcher reloads it once it's complete
+            if (decoded.image.has_value() == false)
+            {
+                warn(fmt::format("could not decode image '{}'", path));
+                entry->second.sprite.failed = true;
+                continue;
+            }
+
+            texture = this->create_texture(decoded.image.value(), decoded.content_hash);
+        }
+
+        this->attach(entry->second, texture);
+    }
+}
+
+void SpriteManager::evict()
+{
+    const auto find_victim = [this](bool browser_only)
+    {
+        for (auto path = this->lru.rbegin(); path != this->lru.rend(); ++path)
+        {
+            auto entry = this->sprites.find(*path);
+            auto& value = entry->second;
+
+            // sprites drawn on the last frame would just be requested again
+            if (value.sprite.ready == false || value.last_used_frame + 1 >= this->frame)
+                continue;
+
+            if (this->pinned.find(*path) != this->pinned.end())
+                continue;
+
+            if (browser_only && value.browser_only == false)
+                continue;
+
+            return entry;
+        }
+
+        return this->sprites.end();
+    };
+
+    while (this->stats.resident_gpu_bytes > this->gpu_budget)
+    {
+        auto victim = find_victim(true);
+
+        if (victim == this->sprites.end())
+            victim = find_victim(false);
+
+        if (victim == this->sprites.end())
+            break;
+
+        this->erase(victim);
+        this->stats.evictions += 1;
+    }
+}
+
+
+std::shared_ptr<Texture> SpriteManager::find_texture(uint64_t content_hash)
+{
+    if (auto shared = this->textures.find(content_hash); shared != this->textures.end())
+        return shared->second.texture;
+
+    return nullptr;
+}
+
+std::shared_ptr<Texture> SpriteManager::create_texture(const Image& image, uint64_t content_hash)
+{
+    leaf_assert(this->textures.find(content_hash) == this->textures.end());
+
+    auto texture = std::make_shared<Texture>(image, content_hash, this->get_upload_buffer());
+
+    this->textures.emplace(content_hash, SharedTexture{texture, 0});
+    this->stats.resident_gpu_bytes += texture->byte_size();
+
+    return texture;
+}
+
+
+GLuint SpriteManager::get_placeholder_id()
+{
+    if (this->placeholder_id.has_value())
+        return this->placeholder_id.value();
+
+    const uint8_t pixel[Image::CHANNELS] = {200, 200, 200, 120};
+
+    this->placeholder_id = 0;
+    glGenTextures(1, &this->placeholder_id.value());
+    glBindTexture(GL_TEXTURE_2D, this->placeholder_id.value());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixel);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return this->placeholder_id.value();
+}
+
+std::optional<GLuint> SpriteManager::get_upload_buffer()
+{
+    // pixel buffers and glMapBufferRange are core since 3.0
+    if (!GLAD_GL_VERSION_3_0)
+        return std::nullopt;
+
+    if (this->upload_buffers.empty())
+    {
+        this->upload_buffers.resize(SpriteManager::upload_buffer_count);
+        glGenBuffers(this->upload_buffers.size(), this->upload_buffers.data());
+    }
+
+    auto buffer = this->upload_buffers[this->next_upload_buffer];
+    this->next_upload_buffer = (this->next_upload_buffer + 1) % this->upload_buffers.size();
+
+    return buffer;
 }
@@ -3,11 +3,41 @@
 
 // local
 #include "graphics.hpp"
+#include "image.hpp"
 #include "utils/asserts.hpp"
 
 // extern
 #include <glm/vec2.hpp>
 
+// builtin
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+
+
+// GL texture shared by every sprite whose file has the same content
+struct Texture
+{
+    public:
+
+        GLuint id = 0;
+        glm::u64vec2 size;
+        uint64_t content_hash;
+
+    public:
+
+        Texture(const Image& image, uint64_t content_hash, std::optional<GLuint> pixel_buffer = std::nullopt);
+        Texture(const Texture&) = delete;
+        Texture& operator=(const Texture&) = delete;
+        ~Texture();
+
+        uint64_t byte_size() const;
+};
 
 
 struct Sprite
@@ -19,23 +49,116 @@ struct Sprite
 
         std::string path;
 
+        // false while the texture is still being decoded, in that case "id" points to the placeholder
+        bool ready = false;
+
+        // the file couldn't be read or decoded, it keeps the placeholder until it's reloaded
+        bool failed = false;
+
+        std::shared_ptr<Texture> texture;
+
     public:
 
-        Sprite(const std::string _path);
+        Sprite(const std::string _path, glm::u64vec2 _size, GLuint placeholder_id);
         Sprite() = default;
-        Sprite(Sprite&&);
+        Sprite(Sprite&&) = default;
         Sprite& operator=(const Sprite&) = delete;
         Sprite& operator=(Sprite&&) = delete;
-        ~Sprite();
+
+        void attach(std::shared_ptr<Texture> texture);
+        uint64_t byte_size() const;
 
 };
 
 
 class SpriteManager
 {
+    public:
+
+        // textures only requested by the asset browser are evicted first
+        enum class Usage
+        {
+            Project,
+            Browser
+        };
+
+        struct Stats
+        {
+            uint64_t resident_gpu_bytes = 0;
+            uint64_t resident_cpu_bytes = 0;
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+            uint64_t evictions = 0;
+
+            // sprites that reused the texture of an identical file, and the memory that saved
+            uint64_t dedupe_hits = 0;
+            uint64_t deduplicated_bytes = 0;
+        };
+
     private:
 
-        std::unordered_map<std::string, Sprite> sprites;
+        // files are hashed first, only content that isn't resident yet is decoded
+        struct Hashed
+        {
+            std::string path;
+            uint64_t reserved_bytes;
+            uint64_t content_hash;
+            std::shared_ptr<std::string> content;
+        };
+
+        struct Decoded
+        {
+            uint64_t content_hash;
+            uint64_t reserved_bytes;
+            std::optional<Image> image;
+        };
+
+        struct DecodeQueue
+        {
+            std::mutex mutex;
+            std::vector<Hashed> hashed;
+            std::vector<Decoded> images;
+        };
+
+        struct Entry
+        {
+            Sprite sprite;
+            std::list<std::string>::iterator lru_position;
+            uint64_t last_used_frame = 0;
+            bool browser_only = true;
+        };
+
+        struct SharedTexture
+        {
+            std::shared_ptr<Texture> texture;
+            uint64_t users = 0;
+        };
+
+        inline static const size_t max_uploads_per_frame = 8;
+        inline static const size_t upload_buffer_count = 4;
+        inline static const uint64_t default_gpu_budget = 1024ull * 1024 * 1024;
+        inline static const uint64_t default_cpu_budget = 256ull * 1024 * 1024;
+
+        std::unordered_map<std::string, Entry> sprites;
+        std::shared_ptr<DecodeQueue> decoded = std::make_shared<DecodeQueue>();
+
+        // content hash to texture, and to the paths waiting for a texture being decoded
+        std::unordered_map<uint64_t, SharedTexture> textures;
+        std::unordered_map<uint64_t, std::vector<std::string>> decoding;
+
+        // most recently used first
+        std::list<std::string> lru;
+        std::unordered_set<std::string> pinned;
+        std::deque<std::string> deferred_decodes;
+        uint64_t frame = 0;
+
+        uint64_t gpu_budget = SpriteManager::default_gpu_budget;
+        uint64_t cpu_budget = SpriteManager::default_cpu_budget;
+        Stats stats;
+
+        std::optional<GLuint> placeholder_id;
+        std::vector<GLuint> upload_buffers;
+        size_t next_upload_buffer = 0;
 
     public:
 
@@ -43,10 +166,40 @@ class SpriteManager
 
         bool sprite_exists(const std::string& path);
         void load_sprite(const std::string& path);
-        const Sprite& get_sprite(const std::string& path);
+        void request_sprite(const std::string& path, Usage usage = Usage::Project);
+        const Sprite& get_sprite(const std::string& path, Usage usage = Usage::Project);
+        const Sprite& get_ready_sprite(const std::string& path);
+        void reload_sprite(const std::string& path);
         void free_sprite(const std::string& path);
         void clear();
 
+        void update();
+
+        void set_pinned(std::unordered_set<std::string> paths);
+        void set_budget(uint64_t gpu_bytes, uint64_t cpu_bytes);
+        Stats get_stats();
+
+    private:
+
+        Entry& touch(const std::string& path, Usage usage);
+        void insert(const std::string& path, Sprite sprite, Usage usage);
+
+        // the file is missing or broken, the entry keeps the placeholder so it isn't read every frame
+        void insert_failed(const std::string& path, Usage usage, const std::string& message);
+        void erase(std::unordered_map<std::string, Entry>::iterator entry);
+        void attach(Entry& entry, std::shared_ptr<Texture> texture);
+        void submit_hash(const std::string& path);
+        void submit_deferred_decodes();
+        void process_hashed(Hashed hashed);
+        void process_decoded(Decoded decoded);
+        void evict();
+
+        std::shared_ptr<Texture> find_texture(uint64_t content_hash);
+        std::shared_ptr<Texture> create_texture(const Image& image, uint64_t content_hash);
+
+        GLuint get_placeholder_id();
+        std::optional<GLuint> get_upload_buffer();
 };
 
-thread_local inline SpriteManager sprite_manager;
+// only used from the ui thread, other threads hold references to its textures instead
+inline SpriteManager sprite_manager;
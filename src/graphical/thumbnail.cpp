@@ -0,0 +1,372 @@
+// header
+#include "thumbnail.hpp"
+
+// local
+#include "utils/hash.hpp"
+#include "utils/log.hpp"
+#include "utils/system.hpp"
+#include "utils/thread_pool.hpp"
+
+// builtin
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <thread>
+
+
+
+struct ThumbnailFileHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+};
+
+static const char THUMBNAIL_MAGIC[4] = {'L', 'T', 'H', 'M'};
+static const uint32_t THUMBNAIL_VERSION = 1;
+
+// every edit of an asset leaves its old thumbnail behind, the cache is pruned when opened
+static const uintmax_t MAX_CACHE_BYTES = 256 * 1024 * 1024;
+static const auto MAX_CACHE_AGE = std::chrono::hours{24 * 30};
+
+// older ones were left by a crash, newer ones may still be written by another instance
+static const auto TEMPORARY_AGE = std::chrono::hours{1};
+
+
+
+ThumbnailCache::ThumbnailCache(): cache_directory{get_system_config_directory() / ".leaf_cache" / "thumbnails"}
+{
+    std::error_code error;
+    std::filesystem::create_directories(this->cache_directory, error);
+
+    if (error)
+        warn(fmt::format("could not create thumbnail cache directory '{}': {}", this->cache_directory.string(), error.message()));
+    else
+        ThumbnailCache::prune(this->cache_directory);
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    this->clear();
+}
+
+
+ThumbnailCache::Thumbnail ThumbnailCache::get(const std::string& path)
+{
+    this->request(path);
+
+    auto& entry = this->entries.at(path);
+    entry.last_used_frame = this->frame;
+
+    Thumbnail thumbnail;
+    thumbnail.size = entry.size;
+    thumbnail.failed = entry.failed;
+
+    if (entry.ready == false)
+        return thumbnail;
+
+    auto page = entry.slot.value() / ThumbnailCache::cells_per_page;
+    auto cell = entry.slot.value() % ThumbnailCache::cells_per_page;
+    auto x = (cell % ThumbnailCache::cells_per_row) * ThumbnailCache::cell_size + 1;
+    auto y = (cell / ThumbnailCache::cells_per_row) * ThumbnailCache::cell_size + 1;
+
+    const auto atlas_size = (float)ThumbnailCache::atlas_size;
+
+    thumbnail.texture_id = this->pages[page];
+    thumbnail.uv0 = {x / atlas_size, y / atlas_size};
+    thumbnail.uv1 = {(x + entry.size.x) / atlas_size, (y + entry.size.y) / atlas_size};
+    thumbnail.ready = true;
+
+    return thumbnail;
+}
+
+void ThumbnailCache::request(const std::string& path)
+{
+    if (this->entries.find(path) != this->entries.end())
+        return;
+
+    auto generation = this->next_generation++;
+    this->entries.insert({path, Entry{generation}});
+
+    thread_pool.submit([path, generation, cache_directory = this->cache_directory, results = this->results]()
+    {
+        auto image = ThumbnailCache::generate(path, cache_directory);
+
+        std::lock_guard lock{results->mutex};
+        results->results.push_back(Result{path, generation, std::move(image)});
+    });
+}
+
+void ThumbnailCache::invalidate(const std::string& path)
+{
+    auto entry = this->entries.find(path);
+    if (entry == this->entries.end())
+        return;
+
+    if (entry->second.slot.has_value())
+        this->free_slots.push_back(entry->second.slot.value());
+
+    this->entries.erase(entry);
+}
+
+void ThumbnailCache::clear()
+{
+    this->entries.clear();
+    this->free_slots.clear();
+    this->waiting.clear();
+    this->results = std::make_shared<ResultQueue>();
+
+    if (this->pages.empty() == false)
+        glDeleteTextures(this->pages.size(), this->pages.data());
+    this->pages.clear();
+}
+
+
+void ThumbnailCache::update()
+{
+    this->frame += 1;
+
+    {
+        std::lock_guard lock{this->results->mutex};
+        std::move(this->results->results.begin(), this->results->results.end(), std::back_inserter(this->waiting));
+        this->results->results.clear();
+    }
+
+    size_t uploads = 0;
+    auto result = this->waiting.begin();
+
+    for (; result != this->waiting.end() && uploads < ThumbnailCache::max_uploads_per_frame; ++result)
+    {
+        // invalidated or cleared while it was being generated
+        auto entry = this->entries.find(result->path);
+        if (entry == this->entries.end() || entry->second.generation != result->generation)
+            continue;
+
+        // retried when the watcher invalidates the entry, a file caught mid-copy is
+        // modified again once it's complete
+        if (result->image.has_value() == false)
+        {
+            warn(fmt::format("could not generate a thumbnail for '{}'", result->path));
+            entry->second.failed = true;
+            continue;
+        }
+
+        auto slot = this->allocate_slot();
+        if (slot.has_value() == false)
+            break;
+
+        entry->second.slot = slot;
+        this->upload(entry->second, result->image.value());
+        uploads += 1;
+    }
+
+    this->waiting.erase(this->waiting.begin(), result);
+}
+
+
+std::optional<size_t> ThumbnailCache::allocate_slot()
+{
+    if (this->free_slots.empty() && this->pages.size() < ThumbnailCache::max_pages)
+    {
+        GLuint page;
+        glGenTextures(1, &page);
+        glBindTexture(GL_TEXTURE_2D, page);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, ThumbnailCache::atlas_size, ThumbnailCache::atlas_size, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        auto first_slot = this->pages.size() * ThumbnailCache::cells_per_page;
+        this->pages.push_back(page);
+
+        for (size_t slot = first_slot + ThumbnailCache::cells_per_page; slot > first_slot; --slot)
+            this->free_slots.push_back(slot - 1);
+    }
+
+    if (this->free_slots.empty() == false)
+    {
+        auto slot = this->free_slots.back();
+        this->free_slots.pop_back();
+        return slot;
+    }
+
+    // atlas is full, reuse the cell of the thumbnail that has been offscreen the longest
+    auto victim = this->entries.end();
+    for (auto entry = this->entries.begin(); entry != this->entries.end(); ++entry)
+    {
+        if (entry->second.ready == false || entry->second.last_used_frame + 1 >= this->frame)
+            continue;
+
+        if (victim == this->entries.end() || entry->second.last_used_frame < victim->second.last_used_frame)
+            victim = entry;
+    }
+
+    if (victim == this->entries.end())
+        return std::nullopt;
+
+    auto slot = victim->second.slot;
+    this->entries.erase(victim);
+
+    return slot;
+}
+
+void ThumbnailCache::upload(Entry& entry, const Image& image)
+{
+    // the whole cell is written so the padding of a previous occupant is cleared
+    std::vector<uint8_t> cell(ThumbnailCache::cell_size * ThumbnailCache::cell_size * Image::CHANNELS, 0);
+
+    for (uint64_t y = 0; y < image.size.y; ++y)
+        memcpy(
+            cell.data() + ((y + 1) * ThumbnailCache::cell_size + 1) * Image::CHANNELS,
+            image.pixels.get() + (y * image.size.x) * Image::CHANNELS,
+            image.size.x * Image::CHANNELS
+        );
+
+    auto page = entry.slot.value() / ThumbnailCache::cells_per_page;
+    auto index = entry.slot.value() % ThumbnailCache::cells_per_page;
+    auto x = (index % ThumbnailCache::cells_per_row) * ThumbnailCache::cell_size;
+    auto y = (index / ThumbnailCache::cells_per_row) * ThumbnailCache::cell_size;
+
+    glBindTexture(GL_TEXTURE_2D, this->pages[page]);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, ThumbnailCache::cell_size, ThumbnailCache::cell_size, GL_RGBA, GL_UNSIGNED_BYTE, cell.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    entry.size = image.size;
+    entry.ready = true;
+}
+
+
+std::optional<Image> ThumbnailCache::generate(const std::string& path, const std::filesystem::path& cache_directory)
+{
+    std::error_code error;
+    auto write_time = std::filesystem::last_write_time(path, error);
+    if (error)
+        return std::nullopt;
+
+    auto file_size = std::filesystem::file_size(path, error);
+    if (error)
+        return std::nullopt;
+
+    // any change to the file gives it a new cache entry, stale ones are simply never read again
+    auto key = hash_string(path);
+    key = hash_combine(key, (uint64_t)write_time.time_since_epoch().count());
+    key = hash_combine(key, (uint64_t)file_size);
+
+    auto cache_path = cache_directory / fmt::format("{:016x}.thumbnail", key);
+
+    if (auto cached = ThumbnailCache::read_cached(cache_path); cached.has_value())
+        return cached;
+
+    auto image = Image::decode(path);
+    if (image.has_value() == false)
+        return std::nullopt;
+
+    auto thumbnail = image->downscale(ThumbnailCache::thumbnail_size);
+    ThumbnailCache::write_cached(cache_path, thumbnail);
+
+    return thumbnail;
+}
+
+std::optional<Image> ThumbnailCache::read_cached(const std::filesystem::path& path)
+{
+    std::ifstream file{path, std::ios::binary};
+    if (file.is_open() == false)
+        return std::nullopt;
+
+    ThumbnailFileHeader header;
+    if (!file.read((char*)&header, sizeof(header)))
+        return std::nullopt;
+
+    if (memcmp(header.magic, THUMBNAIL_MAGIC, sizeof(THUMBNAIL_MAGIC)) != 0 || header.version != THUMBNAIL_VERSION)
+        return std::nullopt;
+
+    if (header.width == 0 || header.height == 0 || header.width > ThumbnailCache::thumbnail_size || header.height > ThumbnailCache::thumbnail_size)
+        return std::nullopt;
+
+    auto image = Image::allocate({header.width, header.height});
+    if (!file.read((char*)image.pixels.get(), image.byte_size()))
+        return std::nullopt;
+
+    // the write time is when it was last used, pruning goes by it
+    std::error_code error;
+    std::filesystem::last_write_time(path, std::filesystem::file_time_type::clock::now(), error);
+
+    return image;
+}
+
+void ThumbnailCache::write_cached(const std::filesystem::path& path, const Image& image)
+{
+    ThumbnailFileHeader header;
+    memcpy(header.magic, THUMBNAIL_MAGIC, sizeof(THUMBNAIL_MAGIC));
+    header.version = THUMBNAIL_VERSION;
+    header.width = image.size.x;
+    header.height = image.size.y;
+
+    // written under a temporary name so a concurrent reader never sees half a file
+    auto temporary_path = path;
+    temporary_path += fmt::format(".{}.tmp", std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+    bool written = false;
+    {
+        std::ofstream file{temporary_path, std::ios::binary};
+        file.write((const char*)&header, sizeof(header));
+        file.write((const char*)image.pixels.get(), image.byte_size());
+
+        file.close();
+        written = file.good();
+    }
+
+    std::error_code error;
+    if (written)
+        std::filesystem::rename(temporary_path, path, error);
+
+    if (written == false || error)
+        std::filesystem::remove(temporary_path, error);
+}
+
+void ThumbnailCache::prune(const std::filesystem::path& cache_directory)
+{
+    struct CachedFile
+    {
+        std::filesystem::path path;
+        std::filesystem::file_time_type last_used;
+        uintmax_t size;
+    };
+
+    std::vector<CachedFile> files;
+    const auto now = std::filesystem::file_time_type::clock::now();
+
+    std::error_code error;
+    for (auto entry = std::filesystem::directory_iterator{cache_directory, error}; error.value() == 0 && entry != std::filesystem::directory_iterator{}; entry.increment(error))
+    {
+        std::error_code entry_error;
+        auto last_used = entry->last_write_time(entry_error);
+        auto size = entry->file_size(entry_error);
+
+        if (entry_error)
+            continue;
+
+        bool temporary = entry->path().extension() == ".tmp";
+        if (now - last_used > (temporary ? TEMPORARY_AGE : MAX_CACHE_AGE))
+            std::filesystem::remove(entry->path(), entry_error);
+        else if (temporary == false)
+            files.push_back(CachedFile{entry->path(), last_used, size});
+    }
+
+    // the least recently used go once the rest fill the cache
+    std::sort(files.begin(), files.end(), [](auto& a, auto& b){ return a.last_used > b.last_used; });
+
+    uintmax_t total = 0;
+    for (auto& file: files)
+    {
+        total += file.size;
+
+        if (total > MAX_CACHE_BYTES)
+            std::filesystem::remove(file.path, error);
+    }
+}
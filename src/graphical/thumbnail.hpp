@@ -0,0 +1,106 @@
+#pragma once
+
+
+// local
+#include "graphics.hpp"
+#include "image.hpp"
+
+// extern
+#include <glm/vec2.hpp>
+
+// builtin
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+
+
+// downscaled copies of images for the asset browser, generated on the
+// worker pool, persisted on disk and packed into shared atlas textures
+class ThumbnailCache
+{
+    public:
+
+        inline static const uint64_t thumbnail_size = 96;
+
+        struct Thumbnail
+        {
+            GLuint texture_id = 0;
+            ImVec2 uv0 = {0, 0};
+            ImVec2 uv1 = {1, 1};
+            glm::u64vec2 size = {ThumbnailCache::thumbnail_size, ThumbnailCache::thumbnail_size};
+            bool ready = false;
+
+            // could not be decoded, stays that way until the file changes
+            bool failed = false;
+        };
+
+    private:
+
+        struct Result
+        {
+            std::string path;
+            uint64_t generation;
+            std::optional<Image> image;
+        };
+
+        struct ResultQueue
+        {
+            std::mutex mutex;
+            std::vector<Result> results;
+        };
+
+        struct Entry
+        {
+            uint64_t generation;
+            std::optional<size_t> slot = std::nullopt;
+            glm::u64vec2 size = {ThumbnailCache::thumbnail_size, ThumbnailCache::thumbnail_size};
+            uint64_t last_used_frame = 0;
+            bool ready = false;
+            bool failed = false;
+        };
+
+        // one texel of transparent padding around every cell avoids bleeding with linear filtering
+        inline static const uint64_t cell_size = ThumbnailCache::thumbnail_size + 2;
+        inline static const uint64_t atlas_size = 2048;
+        inline static const uint64_t cells_per_row = ThumbnailCache::atlas_size / ThumbnailCache::cell_size;
+        inline static const uint64_t cells_per_page = ThumbnailCache::cells_per_row * ThumbnailCache::cells_per_row;
+        inline static const size_t max_pages = 8;
+        inline static const size_t max_uploads_per_frame = 32;
+
+        std::unordered_map<std::string, Entry> entries;
+        std::vector<GLuint> pages;
+        std::vector<size_t> free_slots;
+        std::vector<Result> waiting;
+        std::shared_ptr<ResultQueue> results = std::make_shared<ResultQueue>();
+        std::filesystem::path cache_directory;
+        uint64_t next_generation = 0;
+        uint64_t frame = 0;
+
+    public:
+
+        ThumbnailCache();
+        ThumbnailCache(const ThumbnailCache&) = delete;
+        ThumbnailCache& operator=(const ThumbnailCache&) = delete;
+        ~ThumbnailCache();
+
+        Thumbnail get(const std::string& path);
+        void request(const std::string& path);
+        void invalidate(const std::string& path);
+        void clear();
+
+        void update();
+
+    private:
+
+        std::optional<size_t> allocate_slot();
+        void upload(Entry& entry, const Image& image);
+
+        static std::optional<Image> generate(const std::string& path, const std::filesystem::path& cache_directory);
+        static std::optional<Image> read_cached(const std::filesystem::path& path);
+        static void write_cached(const std::filesystem::path& path, const Image& image);
+
+        // drops the thumbnails unused for a while and the least recently used above the size limit
+        static void prune(const std::filesystem::path& cache_directory);
+};
@@ -1,11 +1,19 @@
-
 // local
 #include "application.hpp"
+#include "cli/render_command.hpp"
+
+// builtin
+#include <string>
+#include <vector>
 
 
 
-int main()
+int main(int argc, char** argv)
 {
+    // batch renders run without a display, so they skip the application entirely
+    if (argc > 1 && std::string{argv[1]} == "render")
+        return (int)run_render_command(std::vector<std::string>{argv + 2, argv + argc});
+
     notice(fmt::format("system config dir: {}", get_system_config_directory().string()));
     Application{}.run();
 }
@@ -130,6 +130,7 @@ class Node: public std::enable_shared_from_this<Node> {
     friend class boost::serialization::access;
     friend NodeTree;
     template<class Archive> friend void boost::serialization::serialize(Archive&, Node&, const unsigned int);
+    friend class BinaryProjectFormat;
 
     friend AddNode;
     friend RemoveNode;
@@ -212,6 +213,7 @@ class NodeTree
 {   
 
     template<class Archive> friend void boost::serialization::serialize(Archive&, NodeTree&, const unsigned int);
+    friend class BinaryProjectFormat;
 
     private:
 
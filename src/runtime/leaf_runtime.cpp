@@ -0,0 +1,326 @@
+// header
+#include "leaf_runtime.hpp"
+
+// builtin
+#include <cmath>
+#include <cstring>
+#include <utility>
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+
+
+namespace leaf_runtime
+{
+
+    // the same curves as the editor's, without pow since sampling is dominated by them
+    static double ease(uint8_t easing, double value)
+    {
+        switch ((Easing)easing)
+        {
+            case Easing::QUAD:  return value * value;
+            case Easing::CUBIC: return value * value * value;
+            case Easing::QUART: return (value * value) * (value * value);
+            case Easing::QUINT: return (value * value) * (value * value) * value;
+            case Easing::SINE:  return 1.0 - std::cos((value * 3.14159265358979323846) / 2.0);
+            case Easing::CIRC:  return 1.0 - std::sqrt(1.0 - value * value);
+            default:            return value;
+        }
+    }
+
+    static double dequantize(uint16_t value, float minimum, float range)
+    {
+        return minimum + (double)value / format::QUANTIZATION_STEPS * range;
+    }
+
+    // same rules as the editor: before the first key the node keeps its own value, after
+    // the last one it holds it, and in between it eases from the earlier key to the next
+    static void sample_track(const format::Track& track, const format::Key* keys, double time, float* output, int components)
+    {
+        if (track.key_count == 0)
+            return;
+
+        auto first = keys + track.first_key;
+        auto last = first + track.key_count;
+
+        // compared against the quantized times instead of dequantizing every key
+        double step = track.time_range > 0 ? (time - track.start_time) / track.time_range * format::QUANTIZATION_STEPS : (time >= track.start_time ? 0 : -1);
+
+        // first key after "step"
+        auto low = first;
+        auto count = track.key_count;
+
+        while (count > 0)
+        {
+            auto half = count / 2;
+
+            if (low[half].time <= step)
+            {
+                low += half + 1;
+                count -= half + 1;
+            }
+            else
+                count = half;
+        }
+
+        if (low == first)
+            return;
+
+        auto& from = *(low - 1);
+        auto& to = low == last ? from : *low;
+
+        // eased once for every component
+        auto factor = from.time == to.time ? 1.0 : ease(from.easing, (step - from.time) / (to.time - from.time));
+
+        for (int component = 0; component < components; ++component)
+        {
+            auto start = dequantize(from.value[component], track.minimum[component], track.range[component]);
+            auto target = dequantize(to.value[component], track.minimum[component], track.range[component]);
+
+            output[component] = (float)(start + (target - start) * factor);
+        }
+    }
+
+
+
+    Animation::Animation(Animation&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    Animation& Animation::operator=(Animation&& other) noexcept
+    {
+        if (this == &other)
+            return *this;
+
+        this->close();
+
+        this->data = std::exchange(other.data, nullptr);
+        this->size = std::exchange(other.size, 0);
+        this->mapped = std::exchange(other.mapped, false);
+        this->header = std::exchange(other.header, nullptr);
+        this->nodes = std::exchange(other.nodes, nullptr);
+        this->keys = std::exchange(other.keys, nullptr);
+        this->strings = std::exchange(other.strings, nullptr);
+
+        return *this;
+    }
+
+    Animation::~Animation()
+    {
+        this->close();
+    }
+
+
+    bool Animation::open(const char* path)
+    {
+        this->close();
+
+        #ifdef _WIN32
+
+            auto file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+            if (file == INVALID_HANDLE_VALUE)
+                return false;
+
+            LARGE_INTEGER file_size;
+            if (GetFileSizeEx(file, &file_size) == FALSE || file_size.QuadPart == 0)
+            {
+                CloseHandle(file);
+                return false;
+            }
+
+            // the view keeps the mapping alive, both handles can go right away
+            auto mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            CloseHandle(file);
+
+            if (mapping == nullptr)
+                return false;
+
+            auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+
+            if (view == nullptr)
+                return false;
+
+            this->data = (const uint8_t*)view;
+            this->size = (size_t)file_size.QuadPart;
+
+        #else
+
+            int file = ::open(path, O_RDONLY);
+            if (file < 0)
+                return false;
+
+            struct stat status;
+            if (fstat(file, &status) != 0 || status.st_size == 0)
+            {
+                ::close(file);
+                return false;
+            }
+
+            // the mapping keeps the file alive, the descriptor can go right away
+            auto view = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+            ::close(file);
+
+            if (view == MAP_FAILED)
+                return false;
+
+            this->data = (const uint8_t*)view;
+            this->size = (size_t)status.st_size;
+
+        #endif
+
+        this->mapped = true;
+
+        if (this->validate() == false)
+        {
+            this->close();
+            return false;
+        }
+
+        return true;
+    }
+
+    bool Animation::open(const void* _data, size_t _size)
+    {
+        this->close();
+
+        if (_data == nullptr || (uintptr_t)_data % alignof(uint32_t) != 0)
+            return false;
+
+        this->data = (const uint8_t*)_data;
+        this->size = _size;
+
+        if (this->validate() == false)
+        {
+            this->close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void Animation::close()
+    {
+        if (this->mapped)
+        {
+            #ifdef _WIN32
+                UnmapViewOfFile(this->data);
+            #else
+                munmap((void*)this->data, this->size);
+            #endif
+        }
+
+        this->data = nullptr;
+        this->size = 0;
+        this->mapped = false;
+
+        this->header = nullptr;
+        this->nodes = nullptr;
+        this->keys = nullptr;
+        this->strings = nullptr;
+    }
+
+
+    bool Animation::is_open() const
+    {
+        return this->header != nullptr;
+    }
+
+    uint32_t Animation::get_node_count() const
+    {
+        return this->header->node_count;
+    }
+
+    float Animation::get_length() const
+    {
+        return this->header->length;
+    }
+
+    std::string_view Animation::get_sprite(uint32_t node) const
+    {
+        return {this->strings + this->nodes[node].sprite_offset, this->nodes[node].sprite_length};
+    }
+
+
+    void Animation::sample(double time, Pose* poses) const
+    {
+        for (uint32_t node = 0; node < this->header->node_count; ++node)
+            this->sample(node, time, poses[node]);
+    }
+
+    void Animation::sample(uint32_t node, double time, Pose& pose) const
+    {
+        auto& record = this->nodes[node];
+
+        pose.position[0] = record.position[0];
+        pose.position[1] = record.position[1];
+        pose.scale[0] = record.scale[0];
+        pose.scale[1] = record.scale[1];
+        pose.rotation = record.rotation;
+        pose.pivot[0] = record.pivot[0];
+        pose.pivot[1] = record.pivot[1];
+
+        sample_track(record.tracks[format::POSITION], this->keys, time, pose.position, 2);
+        sample_track(record.tracks[format::SCALE], this->keys, time, pose.scale, 2);
+        sample_track(record.tracks[format::ROTATION], this->keys, time, &pose.rotation, 1);
+        sample_track(record.tracks[format::PIVOT], this->keys, time, pose.pivot, 2);
+    }
+
+
+    // everything is checked once here so sampling can trust the offsets
+    bool Animation::validate()
+    {
+        if (this->size < sizeof(format::Header))
+            return false;
+
+        auto header = (const format::Header*)this->data;
+
+        if (std::memcmp(header->magic, format::MAGIC, sizeof(format::MAGIC)) != 0 || header->version != format::VERSION)
+            return false;
+
+        auto expected_size = sizeof(format::Header)
+            + (uint64_t)header->node_count * sizeof(format::Node)
+            + (uint64_t)header->key_count * sizeof(format::Key)
+            + header->string_bytes;
+
+        if (expected_size > this->size)
+            return false;
+
+        auto nodes = (const format::Node*)(this->data + sizeof(format::Header));
+        auto keys = (const format::Key*)(nodes + header->node_count);
+
+        for (uint32_t i = 0; i < header->node_count; ++i)
+        {
+            auto& node = nodes[i];
+
+            if ((uint64_t)node.sprite_offset + node.sprite_length > header->string_bytes)
+                return false;
+
+            for (auto& track: node.tracks)
+                if ((uint64_t)track.first_key + track.key_count > header->key_count)
+                    return false;
+        }
+
+        for (uint32_t i = 0; i < header->key_count; ++i)
+            if (keys[i].easing >= (uint8_t)Easing::COUNT)
+                return false;
+
+        this->header = header;
+        this->nodes = nodes;
+        this->keys = keys;
+        this->strings = (const char*)(keys + header->key_count);
+
+        return true;
+    }
+
+}
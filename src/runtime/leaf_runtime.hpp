@@ -0,0 +1,164 @@
+#pragma once
+
+
+// builtin
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+
+
+// player for the animations baked by leaf's runtime export. depends on nothing but the
+// standard library, so it can be dropped into a game or an engine as is
+namespace leaf_runtime
+{
+
+    // same order as "easing_ids" in the editor, ids are stored in the files
+    enum class Easing: uint8_t
+    {
+        LINEAR = 0,
+        QUAD,
+        CUBIC,
+        QUART,
+        QUINT,
+        SINE,
+        CIRC,
+
+        COUNT
+    };
+
+
+    // the file is these records back to back, little endian: a Header, "node_count" Nodes,
+    // "key_count" Keys and then the sprite paths in utf-8, without terminators
+    namespace format
+    {
+        inline constexpr char MAGIC[8] = {'L', 'E', 'A', 'F', 'A', 'N', 'I', 'M'};
+        inline constexpr uint32_t VERSION = 1;
+
+        // times and values are stored as fractions of their track's range in these steps
+        inline constexpr uint32_t QUANTIZATION_STEPS = 65535;
+
+        enum TrackIndex
+        {
+            POSITION = 0,
+            SCALE,
+            ROTATION,
+            PIVOT,
+
+            TRACK_COUNT
+        };
+
+        struct Header
+        {
+            char magic[8];
+            uint32_t version;
+            uint32_t node_count;
+            uint32_t key_count;
+            uint32_t string_bytes;
+            float length;
+            uint32_t reserved;
+        };
+
+        // keys sorted by time, a key's value is "minimum + value / QUANTIZATION_STEPS * range"
+        // and its time "start_time + time / QUANTIZATION_STEPS * time_range"
+        struct Track
+        {
+            uint32_t first_key;
+            uint32_t key_count;
+
+            float start_time;
+            float time_range;
+            float minimum[2];
+            float range[2];
+        };
+
+        // rotation keys only use the first component
+        struct Key
+        {
+            uint16_t time;
+            uint8_t easing;
+            uint8_t reserved;
+            uint16_t value[2];
+        };
+
+        // the transforms before the first key of each track, in drawing order
+        struct Node
+        {
+            uint32_t sprite_offset;
+            uint32_t sprite_length;
+
+            float position[2];
+            float scale[2];
+            float rotation;
+            float pivot[2];
+
+            Track tracks[TRACK_COUNT];
+        };
+
+        static_assert(sizeof(Header) == 32);
+        static_assert(sizeof(Track) == 32);
+        static_assert(sizeof(Key) == 8);
+        static_assert(sizeof(Node) == 164);
+    }
+
+
+    // rotation is in radians around "pivot", which is relative to "position"
+    struct Pose
+    {
+        float position[2];
+        float scale[2];
+        float rotation;
+        float pivot[2];
+    };
+
+
+    // a baked animation, mapped instead of read so opening is cheap and several
+    // processes share the pages. sampling never allocates and can run on any number
+    // of threads at once, every rig playing the animation only needs its own poses
+    class Animation
+    {
+        private:
+
+            const uint8_t* data = nullptr;
+            size_t size = 0;
+            bool mapped = false;
+
+            const format::Header* header = nullptr;
+            const format::Node* nodes = nullptr;
+            const format::Key* keys = nullptr;
+            const char* strings = nullptr;
+
+        public:
+
+            Animation() = default;
+            Animation(const Animation&) = delete;
+            Animation& operator=(const Animation&) = delete;
+            Animation(Animation&& other) noexcept;
+            Animation& operator=(Animation&& other) noexcept;
+            ~Animation();
+
+            // false if the file can't be mapped or isn't a valid animation of this version
+            bool open(const char* path);
+
+            // reads from memory owned by the caller, aligned to 4 bytes, which must outlive the animation
+            bool open(const void* data, size_t size);
+
+            void close();
+
+            bool is_open() const;
+            uint32_t get_node_count() const;
+            float get_length() const;
+
+            // relative to the animation file
+            std::string_view get_sprite(uint32_t node) const;
+
+            // writes "get_node_count" poses
+            void sample(double time, Pose* poses) const;
+            void sample(uint32_t node, double time, Pose& pose) const;
+
+        private:
+
+            bool validate();
+    };
+
+}
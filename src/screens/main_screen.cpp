@@ -6,6 +6,7 @@
 #include <chrono>
 #include <imgui.h>
 #include <thread>
+#include <unordered_set>
 
 // local
 #include "screens/projects_screen.hpp"
@@ -15,9 +16,11 @@
 #include "sections/node_renderer.hpp"
 #include "sections/viewport.hpp"
 #include "sections/main_bar.hpp"
+#include "export/export_queue.hpp"
 
 #include "dialogs/file_browser.hpp"
 #include "dialogs/choise.hpp"
+#include "dialogs/alert.hpp"
 
 #include "graphical/graphics.hpp"
 #include "graphical/sprite.hpp"
@@ -223,6 +226,7 @@ std::tuple<bool, void*, nlohmann::json> main_screen(nlohmann::json)
             "Don't Save"
         }
     };
+    std::optional<Alert> save_failed;
 
 
     // window size
@@ -307,6 +311,18 @@ std::tuple<bool, void*, nlohmann::json> main_screen(nlohmann::json)
         //Update anim time
         anim_data.update(ImGui::GetIO().DeltaTime);
 
+        //Start queued exports and collect finished ones
+        export_queue.update();
+
+        //Keep the textures used by the project out of the sprite cache eviction
+        std::unordered_set<std::string> project_sprites;
+        node_tree->run_on_nodes([&project_sprites](Node& node)
+        {
+            if (node.texture_path.has_value())
+                project_sprites.insert(node.texture_path.value());
+        });
+        sprite_manager.set_pinned(std::move(project_sprites));
+
         //Render windows
         action_bar.render();
         viewport.render();
@@ -339,8 +355,14 @@ std::tuple<bool, void*, nlohmann::json> main_screen(nlohmann::json)
         {
             if(quit_input.value() == "Save & Exit") 
             {
-                serialize_project(config.current_project.header.path);
-                should_stop = true;
+                // the editor stays open so the work isn't lost
+                if (auto error = serialize_project(config.current_project.header.path); error.has_value())
+                {
+                    save_failed = Alert{"Could not save##save_failed", error.value()};
+                    save_failed->open();
+                }
+                else
+                    should_stop = true;
             }
             else if(quit_input.value() == "Don't Save")
             {
@@ -348,6 +370,9 @@ std::tuple<bool, void*, nlohmann::json> main_screen(nlohmann::json)
             }
         }
 
+        if (save_failed.has_value() && save_failed->run().ended())
+            save_failed = std::nullopt;
+
         graphic_context.end_frame(clear_color);
         graphic_context.display_frame();
     }
@@ -7,6 +7,7 @@
 #include "screens/main_screen.hpp"
 #include "dialogs/file_browser.hpp"
 #include "dialogs/preferences.hpp"
+#include "export/export_queue.hpp"
 #include "utils/serialization.hpp"
 
 // builtin
@@ -32,6 +33,8 @@ Alert no_path_provided   {"No Path Provided","Please choose a path for your proj
 Alert name_already_in_use{
     "Name already in use",
     "There's already a project with the given name on the choosen folder.\nPlease choose another one"};
+std::optional<Alert> project_not_created;
+std::optional<Alert> project_not_opened;
 
 
 std::optional<std::string> leaf_project_file_filter(std::filesystem::path path)
@@ -57,6 +60,9 @@ std::tuple<bool, void*, nlohmann::json> projects_screen(nlohmann::json)
     auto return_value = std::tuple<bool, void*, nlohmann::json>{false, nullptr, nlohmann::json::object()};
     bool should_stop = false;
 
+    // opened after the table, outside of its ids
+    std::optional<std::string> open_error;
+
     // remove inexistent projects
     auto new_end = std::remove_if(config.projects.begin(), config.projects.end(), [](auto& project)
     {
@@ -77,6 +83,9 @@ std::tuple<bool, void*, nlohmann::json> projects_screen(nlohmann::json)
 
         // create dockspace
         ImGui::DockSpaceOverViewport();
+
+        // finished exports are collected here too, queued ones wait for their project
+        export_queue.update();
     
         ImGui::Begin("Projects", nullptr, ImGuiWindowFlags_AlwaysAutoResize);
 
@@ -175,9 +184,13 @@ std::tuple<bool, void*, nlohmann::json> projects_screen(nlohmann::json)
 
                 if(row_clicked)
                 {
-                    load_project(project->path);
-                    return_value = {true, (void*)main_screen, nlohmann::json::object()};
-                    should_stop = true;
+                    open_error = load_project(project->path);
+
+                    if (open_error.has_value() == false)
+                    {
+                        return_value = {true, (void*)main_screen, nlohmann::json::object()};
+                        should_stop = true;
+                    }
                 }
 
                 ImGui::PopID();
@@ -208,7 +221,17 @@ std::tuple<bool, void*, nlohmann::json> projects_screen(nlohmann::json)
         }
 
         auto import_path = import_project_browser.run();
-        if(import_path.has_value())  import_project(import_path.value());
+        if(import_path.has_value())  open_error = import_project(import_path.value());
+
+        if (open_error.has_value())
+        {
+            project_not_opened = Alert{"Could not open the project", open_error.value()};
+            project_not_opened->open();
+            open_error = std::nullopt;
+        }
+
+        if (project_not_opened.has_value() && project_not_opened->run().ended())
+            project_not_opened = std::nullopt;
 
         ImGui::End();
 
@@ -265,9 +288,13 @@ bool render_create_popup()
             if(project_name.empty())                     no_name_provided.open();
             else if(project_folder.empty())              no_path_provided.open();
             else if(std::filesystem::exists(final_path)) name_already_in_use.open();
+            else if(auto error = create_project(project_name,project_folder); error.has_value())
+            {
+                project_not_created = Alert{"Could not create the project", error.value()};
+                project_not_created->open();
+            }
             else
             {
-                create_project(project_name,project_folder);
                 name_buffer = std::array<char, 666>{};
                 project_folder = std::string{};
                 project_name   = std::string{};
@@ -278,6 +305,7 @@ bool render_create_popup()
         no_name_provided.run();
         no_path_provided.run();
         name_already_in_use.run();
+        if(project_not_created.has_value() && project_not_created->run().ended()) project_not_created = std::nullopt;
 
         /* 
         auto state = FileBrowser::State::get_default();
@@ -292,7 +320,7 @@ bool render_create_popup()
     
 }
 
-void create_project(const std::string& name,const std::string& folder)
+std::optional<std::string> create_project(const std::string& name,const std::string& folder)
 {
     std::filesystem::path folder_path{folder};
     std::filesystem::path file_path  {fmt::format("{}.leafproject", name)};
@@ -304,14 +332,20 @@ void create_project(const std::string& name,const std::string& folder)
 
 
     config.current_project.header = ApplicationConfig::Project::Header{name,final_path,boost::posix_time::second_clock::local_time(), {height, width}};
-    config.projects.push_back(config.current_project.header);
 
-    serialize_project(final_path);
+    // only listed once it exists
+    auto error = serialize_project(final_path);
+    if (error.has_value() == false)
+        config.projects.push_back(config.current_project.header);
 
+    return error;
 }
 
-void import_project(const std::string& path)
+std::optional<std::string> import_project(const std::string& path)
 {
-    load_project(path);
-    config.projects.push_back(config.current_project.header);
+    auto error = load_project(path);
+    if (error.has_value() == false)
+        config.projects.push_back(config.current_project.header);
+
+    return error;
 }
\ No newline at end of file
@@ -4,10 +4,16 @@
 // extern
 #include <nlohmann/json.hpp>
 
+// builtin
+#include <optional>
+#include <string>
+
 
 
 
 std::tuple<bool, void*, nlohmann::json> projects_screen(nlohmann::json config);
-void create_project(const std::string& name,const std::string& folder);
-void import_project(const std::string& path);
+// why it couldn't be saved, it isn't opened or listed then
+std::optional<std::string> create_project(const std::string& name,const std::string& folder);
+// why it couldn't be opened, it isn't listed then
+std::optional<std::string> import_project(const std::string& path);
 bool render_create_popup();
\ No newline at end of file
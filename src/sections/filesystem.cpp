@@ -2,7 +2,7 @@
 #include "filesystem.hpp"
 
 // builtin
-#include <chrono>
+#include <algorithm>
 #include <string_view>
 #include <system_error>
 
@@ -10,17 +10,12 @@
 #include "graphical/custom_widgets.hpp"
 
 
-const std::unordered_set<std::string> Filesystem::supported_image_formats
-{
-    ".png", ".jpeg", ".bmp", ".ppm", ".pgm"
-};
-
 Filesystem::Filesystem(const std::string& path): current_path{path}, file_browser{path, FileBrowser::Type::Folder}
 {
     this->input_buffer = new std::array<char, 6666>{};
     strcpy(input_buffer->data(), "");
 
-    this->reload_search_paths();
+    this->open_folder(this->current_path);
 }
 
 Filesystem::~Filesystem()
@@ -31,10 +26,15 @@ Filesystem::~Filesystem()
 
 void Filesystem::render()
 {
+    this->thumbnail_cache.update();
+
     ImGui::Begin("##Filesystem",NULL,SECTION_FLAGS);
     CustomImGui::Title("Assets");
 
-    if ((std::chrono::system_clock::now() - this->last_search_path_update) > this->search_paths_update_time)
+    this->process_file_events();
+
+    // the index is updated in the background, results are refreshed once it changes
+    if (this->search_index->get_version() != this->search_index_version)
         this->reload_search_paths();
 
     if (ImGui::InputText("sprite name", this->input_buffer->data(), this->input_buffer->size()))
@@ -50,107 +50,230 @@ void Filesystem::render()
     if (auto output = this->file_browser.run(); output.has_value())
     {
         this->current_path = output.value();
-        this->reload_search_paths();
+        this->open_folder(this->current_path);
     }
 
-    uint64_t indent = 6;
-    uint64_t window_width = ImGui::GetWindowWidth();
-    uint64_t min_images_per_row = (window_width - indent) / (this->max_icon_width + indent);
-    
-    uint64_t max_image_width;
-    if (min_images_per_row != 0)
-        max_image_width = this->max_icon_width;
-    else
-    {
-        min_images_per_row = 1;
-        max_image_width = ImGui::GetWindowWidth() - indent;
-    }
+    auto stats = sprite_manager.get_stats();
+    ImGui::TextDisabled("textures: %.1f MiB, hits: %lu, misses: %lu, evictions: %lu",
+        (double)stats.resident_gpu_bytes / (1024 * 1024), (unsigned long)stats.hits, (unsigned long)stats.misses, (unsigned long)stats.evictions);
+    ImGui::TextDisabled("duplicates: %lu, %.1f MiB saved", (unsigned long)stats.dedupe_hits, (double)stats.deduplicated_bytes / (1024 * 1024));
 
+    ImGui::BeginChild("assets", {0, 0});
 
-    ImGui::BeginGroup();
+    // fixed size cells, so the layout is known without loading anything
+    const float spacing = ImGui::GetStyle().ItemSpacing.x;
+    const float available_width = ImGui::GetContentRegionAvail().x;
 
-    for (size_t idx = 0; idx < this->search_paths.size(); ++idx)
-    {
-        
-        auto& sprite = this->get_sprite(this->search_paths[idx].string());
-        auto size = this->get_image_render_size(max_image_width, sprite);
+    uint64_t images_per_row = std::max<uint64_t>((available_width + spacing) / (this->max_icon_width + spacing), 1);
+    float cell_width = std::min<float>(this->max_icon_width, available_width);
+    float row_height = cell_width + ImGui::GetTextLineHeightWithSpacing() + ImGui::GetStyle().ItemSpacing.y;
 
-        ImGui::SameLine();
-        if (ImGui::GetWindowWidth() - ImGui::GetCursorPos().x < size.x || idx == 0)
-            ImGui::NewLine();
+    uint64_t row_count = (this->search_paths.size() + images_per_row - 1) / images_per_row;
 
+    ImGuiListClipper clipper;
+    clipper.Begin(row_count, row_height);
 
-        ImGui::BeginGroup();
+    std::optional<uint64_t> first_visible_row;
+    uint64_t last_visible_row = 0;
 
-        ImGui::Image((void*)(uintptr_t)sprite.id.value(), size);
-        
-        if (ImGui::BeginDragDropSource(ImGuiDragDropFlags_SourceAllowNullID))
+    while (clipper.Step())
+    {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
         {
-            ImGui::SetDragDropPayload("sprite", sprite.path.data(), sprite.path.size());
-
-            ImGui::Image((void*)(uintptr_t)sprite.id.value(), size);
-            ImGui::EndDragDropSource();
+            if (first_visible_row.has_value() == false || (uint64_t)row < first_visible_row.value())
+                first_visible_row = row;
+            last_visible_row = std::max<uint64_t>(last_visible_row, row + 1);
+
+            auto first = row * images_per_row;
+            auto last = std::min<uint64_t>(first + images_per_row, this->search_paths.size());
+
+            for (auto idx = first; idx < last; ++idx)
+            {
+                if (idx != first)
+                    ImGui::SameLine();
+
+                // search results can briefly lag behind the index
+                auto asset = this->assets.find(this->search_paths[idx]);
+                if (asset != this->assets.end())
+                    this->render_asset(asset->second, cell_width);
+                else
+                    ImGui::Dummy({cell_width, row_height - ImGui::GetStyle().ItemSpacing.y});
+            }
         }
+    }
 
-        ImGui::PushTextWrapPos(ImGui::GetCursorPosX() + size.x);
-        ImGui::TextWrapped("%s", this->search_paths[idx].filename().string().c_str());
+    clipper.End();
 
+    // rows just outside the scroll window get their thumbnails generated ahead of time
+    if (first_visible_row.has_value())
+    {
+        auto prefetch_begin = first_visible_row.value() > this->prefetch_rows ? first_visible_row.value() - this->prefetch_rows : 0;
+        auto prefetch_end = std::min<uint64_t>(last_visible_row + this->prefetch_rows, row_count);
 
-        ImGui::EndGroup();
+        for (auto row = prefetch_begin; row < prefetch_end; ++row)
+        {
+            if (row >= first_visible_row.value() && row < last_visible_row)
+                continue;
 
+            auto last = std::min<uint64_t>((row + 1) * images_per_row, this->search_paths.size());
+            for (auto idx = row * images_per_row; idx < last; ++idx)
+                this->thumbnail_cache.request(this->search_paths[idx]);
+        }
     }
-    ImGui::EndGroup();
+
+    ImGui::EndChild();
 
     ImGui::End();
 }
 
 
-void Filesystem::reload_search_paths()
+void Filesystem::open_folder(const std::filesystem::path& path)
 {
-    this->search_paths.clear();
+    this->assets.clear();
+    this->search_index = std::make_shared<SearchIndex>();
 
-    if (std::string_view{this->input_buffer->data()} == "")
-    {
-        for (auto path: std::filesystem::directory_iterator{this->current_path})
-            if (path.is_regular_file() && this->supported_image_formats.find(path.path().extension().string()) != this->supported_image_formats.end())
-                this->search_paths.push_back(path.path());
-    }
-    else
+    // cached metadata shows the library right away, the watcher's scan then revalidates it
+    this->asset_index = std::make_shared<AssetIndex>(path);
+    this->watcher = std::make_unique<FileWatcher>(path, true);
+
+    this->process_file_events();
+}
+
+void Filesystem::process_file_events()
+{
+    if (auto events = this->watcher->poll_events(); events.empty() == false)
+        AssetIndex::enqueue(this->asset_index, std::move(events));
+
+    auto asset_changes = this->asset_index->poll_changes();
+    if (asset_changes.empty())
+        return;
+
+    std::vector<SearchIndex::Change> changes;
+
+    for (auto& change: asset_changes)
     {
-        for (auto path: std::filesystem::directory_iterator{this->current_path})
+        auto& path = change.asset.path;
+
+        switch (change.type)
         {
-            if (!path.is_regular_file() || !(this->supported_image_formats.find(path.path().extension().string()) != this->supported_image_formats.end()))
-                continue;
-                
-            auto name = path.path().filename().string();
-            if (name.find(this->input_buffer->data()) != name.npos)
-                this->search_paths.push_back(path.path());
+            case AssetIndex::ChangeType::Added:
+                this->thumbnail_cache.invalidate(path);
+                changes.push_back({path, std::filesystem::path{path}.lexically_relative(this->current_path).generic_string()});
+                this->assets[path] = std::move(change.asset);
+                break;
+
+            case AssetIndex::ChangeType::Modified:
+                this->thumbnail_cache.invalidate(path);
+                sprite_manager.reload_sprite(path);
+                this->assets[path] = std::move(change.asset);
+                break;
+
+            case AssetIndex::ChangeType::Removed:
+                this->thumbnail_cache.invalidate(path);
+                changes.push_back({path, std::nullopt});
+                this->assets.erase(path);
+                break;
         }
     }
 
-    this->last_search_path_update = std::chrono::system_clock::now();
+    if (changes.empty() == false)
+        SearchIndex::enqueue(this->search_index, std::move(changes));
+
+    this->reload_search_paths();
 }
 
-const Sprite& Filesystem::get_sprite(const std::string& filename)
+void Filesystem::reload_search_paths()
 {
-    if (!sprite_manager.sprite_exists(filename))
-        sprite_manager.load_sprite(filename);
+    this->search_paths.clear();
+
+    this->search_index_version = this->search_index->get_version();
+
+    std::string_view query = this->input_buffer->data();
 
-    return sprite_manager.get_sprite(filename);
+    if (query.empty())
+        for (auto& [path, asset]: this->assets)
+            this->search_paths.push_back(path);
+    else
+        for (auto& path: this->search_index->search(query, this->max_search_results))
+            this->search_paths.push_back(path);
 }
 
+void Filesystem::render_asset(const AssetIndex::Asset& asset, float cell_width)
+{
+    auto& path = asset.path;
+    auto filename = std::filesystem::path{path}.filename().string();
+
+    // the indexed size is known before the thumbnail exists, so nothing moves once it arrives
+    auto thumbnail = this->thumbnail_cache.get(path);
+    auto size = this->get_image_render_size(cell_width, asset.size);
+
+    ImGui::BeginGroup();
+
+    // centered inside the cell so every cell has the same footprint
+    auto position = ImGui::GetCursorScreenPos();
+    ImVec2 image_position = {position.x + (cell_width - size.x) / 2, position.y + (cell_width - size.y) / 2};
+
+    if (thumbnail.ready)
+        ImGui::GetWindowDrawList()->AddImage((void*)(uintptr_t)thumbnail.texture_id, image_position, {image_position.x + size.x, image_position.y + size.y}, thumbnail.uv0, thumbnail.uv1);
+    else if (thumbnail.failed)
+    {
+        // a cross over the placeholder, the file is retried when it changes
+        ImVec2 end = {image_position.x + size.x, image_position.y + size.y};
+        auto draw_list = ImGui::GetWindowDrawList();
 
+        draw_list->AddRectFilled(image_position, end, IM_COL32(200, 60, 60, 40));
+        draw_list->AddLine(image_position, end, IM_COL32(200, 60, 60, 160), 2);
+        draw_list->AddLine(ImVec2{end.x, image_position.y}, ImVec2{image_position.x, end.y}, IM_COL32(200, 60, 60, 160), 2);
+    }
+    else
+        ImGui::GetWindowDrawList()->AddRectFilled(image_position, {image_position.x + size.x, image_position.y + size.y}, IM_COL32(200, 200, 200, 40));
+
+    ImGui::InvisibleButton(path.c_str(), {cell_width, cell_width});
+
+    if (ImGui::BeginDragDropSource(ImGuiDragDropFlags_SourceAllowNullID))
+    {
+        ImGui::SetDragDropPayload("sprite", path.data(), path.size());
+
+        if (thumbnail.ready)
+            ImGui::Image((void*)(uintptr_t)thumbnail.texture_id, size, thumbnail.uv0, thumbnail.uv1);
+        ImGui::EndDragDropSource();
+    }
+    else if (ImGui::IsItemHovered())
+    {
+        // full resolution only on demand
+        auto& sprite = sprite_manager.get_sprite(path, SpriteManager::Usage::Browser);
+        auto preview_size = this->get_image_render_size(this->preview_size, asset.size);
+
+        ImGui::BeginTooltip();
+        ImGui::Image((void*)(uintptr_t)sprite.id.value(), preview_size);
+        ImGui::Text("%s", filename.c_str());
+        ImGui::TextDisabled("%lux%lu %s, %.1f KiB", (unsigned long)asset.size.x, (unsigned long)asset.size.y, asset.format.c_str(), (double)asset.file_size / 1024);
+        ImGui::EndTooltip();
+    }
+
+    // a single line keeps every row the same height
+    auto name = filename;
+    if (ImGui::CalcTextSize(name.c_str()).x > cell_width)
+    {
+        while (name.empty() == false && ImGui::CalcTextSize((name + "...").c_str()).x > cell_width)
+            name.pop_back();
+        name += "...";
+    }
+    ImGui::TextUnformatted(name.c_str());
+
+    ImGui::EndGroup();
+}
 
-ImVec2 Filesystem::get_image_render_size(uint64_t max, const Sprite& image)
+ImVec2 Filesystem::get_image_render_size(float max, glm::u64vec2 size)
 {
-    if (image.size.x > image.size.y)
+    if (size.x > size.y)
     {
-        auto proportion = (float)image.size.y / (float)image.size.x;
+        auto proportion = (float)size.y / (float)size.x;
         return {(float)max, (float)max * proportion};
     }
     else
     {
-        auto proportion = (float)image.size.x / (float)image.size.y;
+        auto proportion = (float)size.x / (float)size.y;
         return {(float)max * proportion, (float)max};
     }
 }
\ No newline at end of file
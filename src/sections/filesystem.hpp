@@ -4,13 +4,17 @@
 // local
 #include "graphical/graphics.hpp"
 #include "graphical/sprite.hpp"
+#include "graphical/thumbnail.hpp"
+#include "graphical/asset_index.hpp"
 #include "dialogs/file_browser.hpp"
+#include "utils/file_watcher.hpp"
+#include "utils/search_index.hpp"
 #include "section.hpp"
 
 // builtin
 #include <filesystem>
-#include <unordered_set>
-#include <chrono>
+#include <map>
+#include <memory>
 
 
 
@@ -19,15 +23,22 @@ class Filesystem : public Section
 {
     private:
 
-        static const std::unordered_set<std::string> supported_image_formats;
-        inline static const std::chrono::system_clock::duration search_paths_update_time = std::chrono::seconds(2);
-
         std::filesystem::path current_path;
         std::array<char, 6666>* input_buffer = nullptr;
-        std::chrono::system_clock::time_point last_search_path_update = std::chrono::system_clock::now();
         const uint64_t max_icon_width = 96;
-        std::vector<std::filesystem::path> search_paths;
+        const uint64_t preview_size = 256;
+        const uint64_t prefetch_rows = 2;
+        const size_t max_search_results = 1000;
+        std::vector<std::string> search_paths;
+
+        // images below the current folder, kept up to date by the watcher
+        std::map<std::string, AssetIndex::Asset> assets;
+        std::shared_ptr<AssetIndex> asset_index;
+        std::unique_ptr<FileWatcher> watcher;
+        std::shared_ptr<SearchIndex> search_index = std::make_shared<SearchIndex>();
+        uint64_t search_index_version = 0;
         FileBrowser file_browser;
+        ThumbnailCache thumbnail_cache;
 
     public:
 
@@ -38,7 +49,9 @@ class Filesystem : public Section
 
     private:
 
+        void open_folder(const std::filesystem::path& path);
+        void process_file_events();
         void reload_search_paths();
-        const Sprite& get_sprite(const std::string& filename);
-        ImVec2 get_image_render_size(uint64_t max, const Sprite& image);
+        void render_asset(const AssetIndex::Asset& asset, float cell_width);
+        ImVec2 get_image_render_size(float max, glm::u64vec2 size);
 };
\ No newline at end of file
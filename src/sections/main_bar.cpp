@@ -14,6 +14,7 @@ bool MainBar::render()
     bool shall_quit = false;
     bool shall_open_quit = false;
     bool shall_open_preferences = false;
+    bool shall_open_save_failed = false;
 
     if(ImGui::BeginMainMenuBar())
     {
@@ -23,9 +24,13 @@ bool MainBar::render()
             {
                 shall_open_preferences = true;
             }
+            if(ImGui::MenuItem("Export queue"))
+            {
+                export_queue_window.open();
+            }
             if(ImGui::MenuItem("Save"))
             {
-                serialize_project(config.current_project.header.path);
+                shall_open_save_failed = !this->save();
             }
             if(ImGui::MenuItem("Quit"))
             {
@@ -43,9 +48,13 @@ bool MainBar::render()
     {
         if(quit_input.value() == "Save & Exit") 
         {
-            serialize_project(config.current_project.header.path);
-            unload_project();
-            shall_quit = true;
+            if (this->save())
+            {
+                unload_project();
+                shall_quit = true;
+            }
+            else
+                shall_open_save_failed = true;
         }
         else if(quit_input.value() == "Don't Save")
         {
@@ -54,8 +63,24 @@ bool MainBar::render()
         }
     }
 
+    export_queue_window.render();
+
     if(shall_open_preferences)   preferences_dialog.open();
-    if(preferences_dialog.run().ended()) serialize_project(config.current_project.header.path);
+    if(preferences_dialog.run().ended()) shall_open_save_failed = !this->save();
+
+    // opened out here, a popup opened inside the menu would be looked up under its id
+    if(shall_open_save_failed) this->save_failed->open();
+    if(this->save_failed.has_value() && this->save_failed->run().ended()) this->save_failed = std::nullopt;
 
     return shall_quit;
+}
+
+bool MainBar::save()
+{
+    auto error = serialize_project(config.current_project.header.path);
+    if (error.has_value() == false)
+        return true;
+
+    this->save_failed = Alert{"Could not save##save_failed", error.value()};
+    return false;
 }
\ No newline at end of file
@@ -17,6 +17,8 @@
 #include "node_tree.hpp"
 #include "dialogs/preferences.hpp"
 #include "dialogs/choise.hpp"
+#include "dialogs/alert.hpp"
+#include "dialogs/export_queue.hpp"
 
 
 
@@ -29,7 +31,13 @@ class MainBar
             "Don't Save"}
         };
     PreferencesDialog preferences_dialog{};
+    ExportQueueWindow export_queue_window{};
+    std::optional<Alert> save_failed;
 
     public:
         bool render();
+
+    private:
+        // shows why it failed, the project stays open
+        bool save();
 };
\ No newline at end of file
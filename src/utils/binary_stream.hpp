@@ -0,0 +1,186 @@
+#pragma once
+
+
+// local
+#include "utils/asserts.hpp"
+#include "utils/log.hpp"
+
+// builtin
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+
+
+// appends plain values to a buffer as they are in memory, so little endian on
+// everything leaf runs on. arrays are copied in one go instead of value by value
+class BinaryWriter
+{
+    private:
+
+        std::vector<uint8_t> buffer;
+
+    public:
+
+        void write_bytes(const void* data, size_t size)
+        {
+            auto offset = this->buffer.size();
+            this->buffer.resize(offset + size);
+
+            if (size > 0)
+                std::memcpy(this->buffer.data() + offset, data, size);
+        }
+
+        template <typename T>
+        void write(const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            this->write_bytes(&value, sizeof(T));
+        }
+
+        template <typename T>
+        void write_array(const T* values, size_t count)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            this->write_bytes(values, sizeof(T) * count);
+        }
+
+        void write_string(const std::string& value)
+        {
+            this->write((uint32_t)value.size());
+            this->write_bytes(value.data(), value.size());
+        }
+
+        // overwrites a value written earlier, for offsets only known once what follows is written
+        template <typename T>
+        void write_at(size_t offset, const T& value)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            leaf_runtime_assert(offset + sizeof(T) <= this->buffer.size());
+
+            std::memcpy(this->buffer.data() + offset, &value, sizeof(T));
+        }
+
+        // zeros up to the next multiple of "alignment"
+        void align(size_t alignment)
+        {
+            this->buffer.resize((this->buffer.size() + alignment - 1) / alignment * alignment, 0);
+        }
+
+        void reserve(size_t size)
+        {
+            this->buffer.reserve(size);
+        }
+
+        size_t get_size()
+        {
+            return this->buffer.size();
+        }
+
+        const std::vector<uint8_t>& get_buffer()
+        {
+            return this->buffer;
+        }
+};
+
+
+// reads back what a BinaryWriter wrote. reading past the end of a truncated file
+// reads zeros instead of garbage and keeps why, every read after it reads nothing
+class BinaryReader
+{
+    private:
+
+        const uint8_t* data;
+        size_t size;
+        size_t offset = 0;
+
+        std::optional<std::string> error;
+
+    public:
+
+        BinaryReader(const void* _data, size_t _size): data{(const uint8_t*)_data}, size{_size}
+        {
+        }
+
+        // nullptr once it failed
+        const uint8_t* read_bytes(size_t count)
+        {
+            if (this->error.has_value())
+                return nullptr;
+
+            if (count > this->size - this->offset)
+            {
+                this->fail(fmt::format("unexpected end of data, {} bytes needed at {} of {}", count, this->offset, this->size));
+                return nullptr;
+            }
+
+            auto output = this->data + this->offset;
+            this->offset += count;
+
+            return output;
+        }
+
+        template <typename T>
+        T read()
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+
+            T value{};
+            if (auto bytes = this->read_bytes(sizeof(T)); bytes != nullptr)
+                std::memcpy(&value, bytes, sizeof(T));
+
+            return value;
+        }
+
+        template <typename T>
+        void read_array(T* values, size_t count)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+
+            // checked before multiplying, a corrupted count could wrap around
+            if (this->error.has_value() == false && count > (this->size - this->offset) / sizeof(T))
+                this->fail(fmt::format("unexpected end of data, {} values of {} bytes needed at {} of {}", count, sizeof(T), this->offset, this->size));
+
+            if (count == 0)
+                return;
+
+            if (auto bytes = this->read_bytes(sizeof(T) * count); bytes != nullptr)
+                std::memcpy(values, bytes, sizeof(T) * count);
+        }
+
+        std::string read_string()
+        {
+            auto length = this->read<uint32_t>();
+            auto bytes = this->read_bytes(length);
+
+            if (bytes == nullptr)
+                return {};
+
+            return std::string{(const char*)bytes, length};
+        }
+
+        // for what the data says being wrong, the first failure is the one kept
+        void fail(std::string message)
+        {
+            if (this->error.has_value() == false)
+                this->error = std::move(message);
+        }
+
+        std::optional<std::string> get_error()
+        {
+            return this->error;
+        }
+
+        size_t get_offset()
+        {
+            return this->offset;
+        }
+
+        size_t get_remaining()
+        {
+            return this->size - this->offset;
+        }
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+
+// builtin
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <optional>
+
+
+
+// FIFO between two threads, producers block once it is full so a fast stage
+// can't run ahead of a slow one and pile up memory
+template <typename T>
+class BoundedQueue
+{
+    private:
+
+        std::deque<T> items;
+        size_t capacity;
+        bool closed = false;
+
+        std::mutex mutex;
+        std::condition_variable not_empty;
+        std::condition_variable not_full;
+
+    public:
+
+        BoundedQueue(size_t capacity): capacity{std::max<size_t>(capacity, 1)}
+        {
+        }
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        // false if the queue was closed, the item is dropped in that case
+        bool push(T item)
+        {
+            {
+                std::unique_lock lock{this->mutex};
+                this->not_full.wait(lock, [this](){ return this->closed || this->items.size() < this->capacity; });
+
+                if (this->closed)
+                    return false;
+
+                this->items.push_back(std::move(item));
+            }
+
+            this->not_empty.notify_one();
+            return true;
+        }
+
+        // std::nullopt once the queue is closed and every item was taken
+        std::optional<T> pop()
+        {
+            std::optional<T> item;
+
+            {
+                std::unique_lock lock{this->mutex};
+                this->not_empty.wait(lock, [this](){ return this->closed || this->items.empty() == false; });
+
+                if (this->items.empty())
+                    return std::nullopt;
+
+                item = std::move(this->items.front());
+                this->items.pop_front();
+            }
+
+            this->not_full.notify_one();
+            return item;
+        }
+
+        std::optional<T> try_pop()
+        {
+            std::optional<T> item;
+
+            {
+                std::lock_guard lock{this->mutex};
+
+                if (this->items.empty())
+                    return std::nullopt;
+
+                item = std::move(this->items.front());
+                this->items.pop_front();
+            }
+
+            this->not_full.notify_one();
+            return item;
+        }
+
+        // wakes every waiting thread, items already queued can still be popped
+        void close()
+        {
+            {
+                std::lock_guard lock{this->mutex};
+                this->closed = true;
+            }
+
+            this->not_empty.notify_all();
+            this->not_full.notify_all();
+        }
+};
@@ -35,6 +35,27 @@ std::string read_file(const std::string& path)
     return output;
 }
 
+std::optional<std::string> try_read_file(const std::string& path)
+{
+    std::ifstream file{path, std::ios::binary | std::ios::ate};
+    if (file.is_open() == false)
+        return std::nullopt;
+
+    // a directory or a special file can't tell its size
+    auto size = file.tellg();
+    if (size < 0)
+        return std::nullopt;
+
+    std::string output;
+    output.resize((size_t)size);
+
+    file.seekg(0);
+    if (!file.read(output.data(), output.size()))
+        return std::nullopt;
+
+    return output;
+}
+
 void write_file(const std::string& path, void* data, size_t size)
 {
     std::ofstream file {path};
@@ -44,3 +65,16 @@ void write_file(const std::string& path, void* data, size_t size)
 
     file.write((char*)data, size);
 }
+
+bool try_write_file(const std::string& path, const void* data, size_t size)
+{
+    std::ofstream file{path, std::ios::binary};
+    if (file.is_open() == false)
+        return false;
+
+    file.write((const char*)data, size);
+    file.close();
+
+    // also catches a write cut short by a full disk, only reported once flushed
+    return file.fail() == false;
+}
@@ -2,9 +2,14 @@
 
 
 // builtin
+#include <optional>
 #include <string>
 
 
 
 std::string read_file(const std::string& path);
+// binary read for worker threads, failures are reported instead of panicking
+std::optional<std::string> try_read_file(const std::string& path);
 void write_file(const std::string& path, void* data, size_t size);
+// binary write for worker threads, false if the file couldn't be opened or completely written
+bool try_write_file(const std::string& path, const void* data, size_t size);
@@ -0,0 +1,273 @@
+// header
+#include "file_watcher.hpp"
+
+// local
+#include "utils/log.hpp"
+
+// builtin
+#include <system_error>
+#include <unordered_map>
+
+#if defined(__linux__)
+#include <climits>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+
+
+FileWatcher::FileWatcher(const std::filesystem::path& directory, bool recursive): directory{directory}, recursive{recursive}
+{
+    #if defined(__linux__)
+    this->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    this->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (this->inotify_fd == -1 || this->wake_fd == -1)
+        warn(fmt::format("could not initialize inotify, '{}' won't be watched", directory.string()));
+    #endif
+
+    this->thread = std::thread{[this](){ this->watch(); }};
+}
+
+FileWatcher::~FileWatcher()
+{
+    this->stopping = true;
+
+    #if defined(__linux__)
+    if (this->wake_fd != -1)
+    {
+        uint64_t value = 1;
+        [[maybe_unused]] auto written = write(this->wake_fd, &value, sizeof(value));
+    }
+    #endif
+
+    {
+        std::lock_guard lock{this->mutex};
+        this->condition.notify_all();
+    }
+
+    this->thread.join();
+
+    #if defined(__linux__)
+    if (this->inotify_fd != -1)
+        close(this->inotify_fd);
+    if (this->wake_fd != -1)
+        close(this->wake_fd);
+    #endif
+}
+
+
+std::vector<FileWatcher::Event> FileWatcher::poll_events()
+{
+    std::lock_guard lock{this->mutex};
+
+    std::vector<Event> output;
+    std::swap(output, this->events);
+
+    return output;
+}
+
+const std::filesystem::path& FileWatcher::get_directory()
+{
+    return this->directory;
+}
+
+
+void FileWatcher::push(EventType type, const std::filesystem::path& path)
+{
+    std::lock_guard lock{this->mutex};
+    this->events.push_back(Event{type, path});
+}
+
+void FileWatcher::scan(const std::filesystem::path& path)
+{
+    std::error_code error;
+
+    if (this->recursive)
+    {
+        auto options = std::filesystem::directory_options::skip_permission_denied;
+        for (auto entry = std::filesystem::recursive_directory_iterator{path, options, error}; !error && entry != std::filesystem::recursive_directory_iterator{}; entry.increment(error))
+        {
+            std::error_code entry_error;
+            if (entry->is_regular_file(entry_error))
+                this->push(EventType::Created, entry->path());
+        }
+    }
+    else
+    {
+        for (auto entry = std::filesystem::directory_iterator{path, error}; !error && entry != std::filesystem::directory_iterator{}; entry.increment(error))
+        {
+            std::error_code entry_error;
+            if (entry->is_regular_file(entry_error))
+                this->push(EventType::Created, entry->path());
+        }
+    }
+}
+
+
+#if defined(__linux__)
+
+void FileWatcher::add_watch(const std::filesystem::path& path)
+{
+    auto mask = IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+    auto descriptor = inotify_add_watch(this->inotify_fd, path.c_str(), mask);
+    if (descriptor == -1)
+    {
+        warn(fmt::format("could not watch '{}'", path.string()));
+        return;
+    }
+
+    this->watched_directories[descriptor] = path;
+
+    if (this->recursive == false)
+        return;
+
+    std::error_code error;
+    for (auto entry = std::filesystem::directory_iterator{path, error}; !error && entry != std::filesystem::directory_iterator{}; entry.increment(error))
+    {
+        std::error_code entry_error;
+        if (entry->is_directory(entry_error) && !entry->is_symlink(entry_error))
+            this->add_watch(entry->path());
+    }
+}
+
+void FileWatcher::watch()
+{
+    if (this->inotify_fd == -1 || this->wake_fd == -1)
+    {
+        this->scan(this->directory);
+        this->push(EventType::ScanFinished, this->directory);
+        return;
+    }
+
+    // the watches are already in place, so nothing created during the scan is missed
+    this->add_watch(this->directory);
+    this->scan(this->directory);
+    this->push(EventType::ScanFinished, this->directory);
+
+    alignas(inotify_event) char buffer[16 * (sizeof(inotify_event) + NAME_MAX + 1)];
+
+    while (this->stopping == false)
+    {
+        pollfd descriptors[2] = {{this->inotify_fd, POLLIN, 0}, {this->wake_fd, POLLIN, 0}};
+        if (poll(descriptors, 2, -1) == -1)
+            continue;
+
+        if (descriptors[1].revents & POLLIN)
+            return;
+
+        ssize_t length;
+        while ((length = read(this->inotify_fd, buffer, sizeof(buffer))) > 0)
+        {
+            for (char* pointer = buffer; pointer < buffer + length; pointer += sizeof(inotify_event) + ((inotify_event*)pointer)->len)
+            {
+                auto event = (inotify_event*)pointer;
+
+                auto directory = this->watched_directories.find(event->wd);
+                if (directory == this->watched_directories.end())
+                    continue;
+
+                if (event->mask & IN_IGNORED)
+                {
+                    this->watched_directories.erase(directory);
+                    continue;
+                }
+
+                if (event->len == 0)
+                    continue;
+
+                auto path = directory->second / event->name;
+
+                if (event->mask & IN_ISDIR)
+                {
+                    if (this->recursive == false)
+                        continue;
+
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    {
+                        this->add_watch(path);
+                        this->scan(path);
+                    }
+                    if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                        this->push(EventType::Removed, path);
+
+                    continue;
+                }
+
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    this->push(EventType::Created, path);
+                if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+                    this->push(EventType::Modified, path);
+                if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+                    this->push(EventType::Removed, path);
+            }
+        }
+    }
+}
+
+#else
+
+void FileWatcher::watch()
+{
+    struct FileState
+    {
+        std::filesystem::file_time_type write_time;
+        uintmax_t size;
+    };
+
+    std::unordered_map<std::string, FileState> files;
+    bool first_scan = true;
+
+    while (this->stopping == false)
+    {
+        std::unordered_map<std::string, FileState> current;
+
+        auto visit = [&](const std::filesystem::directory_entry& entry)
+        {
+            std::error_code entry_error;
+            if (!entry.is_regular_file(entry_error))
+                return;
+
+            FileState state{entry.last_write_time(entry_error), entry.file_size(entry_error)};
+            auto path = entry.path().string();
+
+            if (auto previous = files.find(path); previous == files.end())
+                this->push(EventType::Created, path);
+            else if (previous->second.write_time != state.write_time || previous->second.size != state.size)
+                this->push(EventType::Modified, path);
+
+            current.emplace(path, state);
+        };
+
+        std::error_code error;
+        if (this->recursive)
+        {
+            auto options = std::filesystem::directory_options::skip_permission_denied;
+            for (auto entry = std::filesystem::recursive_directory_iterator{this->directory, options, error}; !error && entry != std::filesystem::recursive_directory_iterator{}; entry.increment(error))
+                visit(*entry);
+        }
+        else
+        {
+            for (auto entry = std::filesystem::directory_iterator{this->directory, error}; !error && entry != std::filesystem::directory_iterator{}; entry.increment(error))
+                visit(*entry);
+        }
+
+        for (auto& [path, state]: files)
+            if (current.find(path) == current.end())
+                this->push(EventType::Removed, path);
+
+        files = std::move(current);
+
+        if (first_scan)
+            this->push(EventType::ScanFinished, this->directory);
+        first_scan = false;
+
+        std::unique_lock lock{this->mutex};
+        this->condition.wait_for(lock, FileWatcher::rescan_interval, [this](){ return this->stopping.load(); });
+    }
+}
+
+#endif
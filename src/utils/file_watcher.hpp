@@ -0,0 +1,77 @@
+#pragma once
+
+
+// builtin
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+
+
+// reports changes to the files of a directory (and optionally its subdirectories)
+// from a background thread, using inotify on linux and a slow rescan everywhere else
+class FileWatcher
+{
+    public:
+
+        enum class EventType
+        {
+            Created,
+            Modified,
+            // also sent for removed directories, with the directory as path
+            Removed,
+            // every file present at startup has been reported
+            ScanFinished
+        };
+
+        struct Event
+        {
+            EventType type;
+            std::filesystem::path path;
+        };
+
+    private:
+
+        inline static const std::chrono::milliseconds rescan_interval = std::chrono::milliseconds(1000);
+
+        std::filesystem::path directory;
+        bool recursive;
+        std::vector<Event> events;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::atomic<bool> stopping = false;
+
+        #if defined(__linux__)
+        int inotify_fd = -1;
+        int wake_fd = -1;
+        std::unordered_map<int, std::filesystem::path> watched_directories;
+        #endif
+
+        std::thread thread;
+
+    public:
+
+        // the current content of the directory is reported as "Created" events
+        FileWatcher(const std::filesystem::path& directory, bool recursive = false);
+        FileWatcher(const FileWatcher&) = delete;
+        FileWatcher& operator=(const FileWatcher&) = delete;
+        ~FileWatcher();
+
+        std::vector<Event> poll_events();
+        const std::filesystem::path& get_directory();
+
+    private:
+
+        void push(EventType type, const std::filesystem::path& path);
+        void scan(const std::filesystem::path& path);
+        void watch();
+
+        #if defined(__linux__)
+        void add_watch(const std::filesystem::path& path);
+        #endif
+};
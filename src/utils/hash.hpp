@@ -0,0 +1,62 @@
+#pragma once
+
+
+// builtin
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+
+
+// MurmurHash64A, fast enough to fingerprint whole image files
+inline uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0xc70f6907ull)
+{
+    const uint64_t m = 0xc6a4a7935bd1e995ull;
+    const int r = 47;
+
+    uint64_t hash = seed ^ (size * m);
+
+    auto bytes = (const uint8_t*)data;
+    auto end = bytes + (size / 8) * 8;
+
+    for (; bytes != end; bytes += 8)
+    {
+        uint64_t k;
+        memcpy(&k, bytes, 8);
+
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+
+        hash ^= k;
+        hash *= m;
+    }
+
+    switch (size & 7)
+    {
+        case 7: hash ^= uint64_t(bytes[6]) << 48; [[fallthrough]];
+        case 6: hash ^= uint64_t(bytes[5]) << 40; [[fallthrough]];
+        case 5: hash ^= uint64_t(bytes[4]) << 32; [[fallthrough]];
+        case 4: hash ^= uint64_t(bytes[3]) << 24; [[fallthrough]];
+        case 3: hash ^= uint64_t(bytes[2]) << 16; [[fallthrough]];
+        case 2: hash ^= uint64_t(bytes[1]) << 8;  [[fallthrough]];
+        case 1: hash ^= uint64_t(bytes[0]);
+                hash *= m;
+    };
+
+    hash ^= hash >> r;
+    hash *= m;
+    hash ^= hash >> r;
+
+    return hash;
+}
+
+inline uint64_t hash_string(std::string_view string, uint64_t seed = 0xc70f6907ull)
+{
+    return hash_bytes(string.data(), string.size(), seed);
+}
+
+inline uint64_t hash_combine(uint64_t hash, uint64_t value)
+{
+    return hash ^ (value + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2));
+}
@@ -0,0 +1,79 @@
+// header
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+    #define WIN32_LEAN_AND_MEAN
+    #define NOMINMAX
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+
+
+std::shared_ptr<const MappedFile> MappedFile::open(const std::filesystem::path& path)
+{
+    #ifdef _WIN32
+
+        auto file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return nullptr;
+
+        LARGE_INTEGER file_size;
+        if (GetFileSizeEx(file, &file_size) == FALSE || file_size.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return nullptr;
+        }
+
+        // the view keeps the mapping alive, both handles can go right away
+        auto mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+
+        if (mapping == nullptr)
+            return nullptr;
+
+        auto view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        CloseHandle(mapping);
+
+        if (view == nullptr)
+            return nullptr;
+
+        return std::shared_ptr<const MappedFile>{new MappedFile{(const uint8_t*)view, (size_t)file_size.QuadPart}};
+
+    #else
+
+        int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0)
+            return nullptr;
+
+        struct stat status;
+        if (fstat(file, &status) != 0 || status.st_size == 0)
+        {
+            ::close(file);
+            return nullptr;
+        }
+
+        // the mapping keeps the file alive, the descriptor can go right away
+        auto view = mmap(nullptr, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+
+        if (view == MAP_FAILED)
+            return nullptr;
+
+        return std::shared_ptr<const MappedFile>{new MappedFile{(const uint8_t*)view, (size_t)status.st_size}};
+
+    #endif
+}
+
+MappedFile::~MappedFile()
+{
+    #ifdef _WIN32
+        UnmapViewOfFile(this->data);
+    #else
+        munmap((void*)this->data, this->size);
+    #endif
+}
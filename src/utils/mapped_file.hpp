@@ -0,0 +1,43 @@
+#pragma once
+
+
+// builtin
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+
+
+
+// a whole file mapped read only, pages are only read from disk when touched.
+// shared so everything still pointing into it keeps it mapped
+class MappedFile
+{
+    private:
+
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+
+        MappedFile(const uint8_t* _data, size_t _size): data{_data}, size{_size}
+        {
+        }
+
+    public:
+
+        // nullptr when the file can't be opened or is empty
+        static std::shared_ptr<const MappedFile> open(const std::filesystem::path& path);
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile();
+
+        const uint8_t* get_data() const
+        {
+            return this->data;
+        }
+
+        size_t get_size() const
+        {
+            return this->size;
+        }
+};
@@ -0,0 +1,145 @@
+// header
+#include "rect_packer.hpp"
+
+// builtin
+#include <algorithm>
+#include <numeric>
+
+
+
+RectPacker::RectPacker(glm::u64vec2 _size): size{_size}, skyline{{0, 0, _size.x}}
+{
+}
+
+
+std::optional<glm::u64vec2> RectPacker::insert(glm::u64vec2 rect)
+{
+    if (rect.x == 0 || rect.y == 0)
+        return glm::u64vec2{0, 0};
+
+    std::optional<size_t> best_index;
+    uint64_t best_top = 0;
+    uint64_t best_width = 0;
+
+    // lowest top first, then the narrowest segment to waste less space next to it
+    for (size_t i = 0; i < this->skyline.size(); ++i)
+    {
+        auto top = this->fit(i, rect);
+        if (top.has_value() == false)
+            continue;
+
+        if (best_index.has_value() == false || top.value() < best_top || (top.value() == best_top && this->skyline[i].width < best_width))
+        {
+            best_index = i;
+            best_top = top.value();
+            best_width = this->skyline[i].width;
+        }
+    }
+
+    if (best_index.has_value() == false)
+        return std::nullopt;
+
+    auto position = glm::u64vec2{this->skyline[best_index.value()].x, best_top - rect.y};
+
+    // the new segment covers the ones below it, partially covered ones are shortened
+    this->skyline.insert(this->skyline.begin() + best_index.value(), Segment{position.x, best_top, rect.x});
+
+    for (size_t i = best_index.value() + 1; i < this->skyline.size();)
+    {
+        auto& previous = this->skyline[i - 1];
+        auto& segment = this->skyline[i];
+
+        if (segment.x >= previous.x + previous.width)
+            break;
+
+        auto shrink = previous.x + previous.width - segment.x;
+        if (shrink < segment.width)
+        {
+            segment.x += shrink;
+            segment.width -= shrink;
+            break;
+        }
+
+        this->skyline.erase(this->skyline.begin() + i);
+    }
+
+    // neighbours at the same height become one segment
+    for (size_t i = 0; i + 1 < this->skyline.size();)
+    {
+        if (this->skyline[i].y == this->skyline[i + 1].y)
+        {
+            this->skyline[i].width += this->skyline[i + 1].width;
+            this->skyline.erase(this->skyline.begin() + i + 1);
+        }
+        else
+            ++i;
+    }
+
+    return position;
+}
+
+std::optional<uint64_t> RectPacker::fit(size_t index, glm::u64vec2 rect)
+{
+    auto x = this->skyline[index].x;
+    if (x + rect.x > this->size.x)
+        return std::nullopt;
+
+    uint64_t y = 0;
+    uint64_t remaining = rect.x;
+
+    for (auto i = index; remaining > 0; ++i)
+    {
+        // "x + rect.x" fits in the width, so the skyline always reaches that far
+        y = std::max(y, this->skyline[i].y);
+        remaining -= std::min(remaining, this->skyline[i].width);
+    }
+
+    if (y + rect.y > this->size.y)
+        return std::nullopt;
+
+    return y + rect.y;
+}
+
+
+std::optional<RectPacker::Packing> RectPacker::pack(const std::vector<glm::u64vec2>& rects, uint64_t padding, uint64_t max_side)
+{
+    // tallest first packs the skyline much tighter
+    std::vector<size_t> order(rects.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b){ return rects[a].y > rects[b].y; });
+
+    uint64_t area = 0;
+    for (auto& rect: rects)
+        area += (rect.x + padding * 2) * (rect.y + padding * 2);
+
+    // grows the width and the height in turns, starting from the smallest side that could hold the area
+    for (glm::u64vec2 size{1, 1}; size.x <= max_side && size.y <= max_side; (size.x <= size.y ? size.x : size.y) *= 2)
+    {
+        if (size.x * size.y < area)
+            continue;
+
+        RectPacker packer{size};
+        Packing output{size, std::vector<glm::u64vec2>(rects.size(), {0, 0})};
+        bool fits = true;
+
+        for (auto index: order)
+        {
+            if (rects[index].x == 0 || rects[index].y == 0)
+                continue;
+
+            auto position = packer.insert(rects[index] + glm::u64vec2{padding * 2, padding * 2});
+            if (position.has_value() == false)
+            {
+                fits = false;
+                break;
+            }
+
+            output.positions[index] = position.value() + glm::u64vec2{padding, padding};
+        }
+
+        if (fits)
+            return output;
+    }
+
+    return std::nullopt;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+
+// extern
+#include <glm/vec2.hpp>
+
+// builtin
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+
+
+// skyline packer, rectangles are placed as low as possible along the top edge of
+// the ones already placed. good enough for atlases and much faster than max rects
+class RectPacker
+{
+    private:
+
+        struct Segment
+        {
+            uint64_t x;
+            uint64_t y;
+            uint64_t width;
+        };
+
+        glm::u64vec2 size;
+        std::vector<Segment> skyline;
+
+    public:
+
+        RectPacker(glm::u64vec2 size);
+
+        // top left corner of the space taken, std::nullopt if it doesn't fit anymore
+        std::optional<glm::u64vec2> insert(glm::u64vec2 rect);
+
+        // the smallest power of two square, or 2:1 rectangle, holding every rect with
+        // "padding" pixels around each one. std::nullopt if a side would exceed "max_side"
+        struct Packing
+        {
+            glm::u64vec2 size;
+            std::vector<glm::u64vec2> positions;
+        };
+
+        static std::optional<Packing> pack(const std::vector<glm::u64vec2>& rects, uint64_t padding, uint64_t max_side);
+
+    private:
+
+        // height of the top of "rect" if it were placed at segment "index"
+        std::optional<uint64_t> fit(size_t index, glm::u64vec2 rect);
+};
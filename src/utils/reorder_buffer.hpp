@@ -0,0 +1,106 @@
+#pragma once
+
+
+// builtin
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <optional>
+
+
+
+// gives back items produced out of order by several threads in index order,
+// producers wait before starting an index too far ahead of the consumer so the
+// items held here stay bounded by the window
+template <typename T>
+class ReorderBuffer
+{
+    private:
+
+        std::map<uint64_t, T> items;
+        uint64_t next_index = 0;
+        size_t window;
+        bool closed = false;
+
+        std::mutex mutex;
+        std::condition_variable next_ready;
+        std::condition_variable window_moved;
+
+    public:
+
+        ReorderBuffer(size_t window): window{std::max<size_t>(window, 1)}
+        {
+        }
+
+        ReorderBuffer(const ReorderBuffer&) = delete;
+        ReorderBuffer& operator=(const ReorderBuffer&) = delete;
+
+        // blocks until "index" is inside the window, false if the buffer was closed
+        bool wait_for_window(uint64_t index)
+        {
+            std::unique_lock lock{this->mutex};
+            this->window_moved.wait(lock, [this, index](){ return this->closed || index < this->next_index + this->window; });
+
+            return this->closed == false;
+        }
+
+        // never blocks, items pushed after the buffer was closed are dropped
+        void push(uint64_t index, T item)
+        {
+            {
+                std::lock_guard lock{this->mutex};
+
+                if (this->closed)
+                    return;
+
+                this->items.emplace(index, std::move(item));
+            }
+
+            this->next_ready.notify_one();
+        }
+
+        // the item after the last one popped, std::nullopt once the buffer is
+        // closed without it
+        std::optional<T> pop()
+        {
+            std::optional<T> item;
+
+            {
+                std::unique_lock lock{this->mutex};
+                this->next_ready.wait(lock, [this](){ return this->closed || this->is_next_ready(); });
+
+                if (this->is_next_ready() == false)
+                    return std::nullopt;
+
+                auto next = this->items.begin();
+                item = std::move(next->second);
+                this->items.erase(next);
+
+                this->next_index += 1;
+            }
+
+            this->window_moved.notify_all();
+            return item;
+        }
+
+        // wakes every waiting thread, items already in order can still be popped
+        void close()
+        {
+            {
+                std::lock_guard lock{this->mutex};
+                this->closed = true;
+            }
+
+            this->next_ready.notify_all();
+            this->window_moved.notify_all();
+        }
+
+    private:
+
+        bool is_next_ready()
+        {
+            return this->items.empty() == false && this->items.begin()->first == this->next_index;
+        }
+};
@@ -0,0 +1,376 @@
+// header
+#include "search_index.hpp"
+
+// local
+#include "utils/thread_pool.hpp"
+
+// builtin
+#include <algorithm>
+#include <cctype>
+
+
+
+void SearchIndex::enqueue(const std::shared_ptr<SearchIndex>& index, std::vector<Change> changes)
+{
+    {
+        std::lock_guard lock{index->pending_mutex};
+        std::move(changes.begin(), changes.end(), std::back_inserter(index->pending));
+
+        // a single task applies everything so changes keep their order
+        if (index->applying)
+            return;
+        index->applying = true;
+    }
+
+    thread_pool.submit([index]()
+    {
+        while (true)
+        {
+            std::vector<Change> changes;
+
+            {
+                std::lock_guard lock{index->pending_mutex};
+                std::swap(changes, index->pending);
+
+                if (changes.empty())
+                {
+                    index->applying = false;
+                    return;
+                }
+            }
+
+            // small batches so searches on the ui thread never wait long for the lock
+            const size_t batch_size = 512;
+
+            for (size_t start = 0; start < changes.size(); start += batch_size)
+            {
+                std::unique_lock lock{index->mutex};
+
+                for (size_t i = start; i < std::min(start + batch_size, changes.size()); ++i)
+                {
+                    if (changes[i].key.has_value())
+                        index->insert_unlocked(changes[i].path, changes[i].key.value());
+                    else
+                        index->erase_unlocked(changes[i].path);
+                }
+
+                index->version += 1;
+            }
+        }
+    });
+}
+
+
+void SearchIndex::insert(const std::string& path, const std::string& key)
+{
+    std::unique_lock lock{this->mutex};
+    this->insert_unlocked(path, key);
+    this->version += 1;
+}
+
+void SearchIndex::erase(const std::string& path)
+{
+    std::unique_lock lock{this->mutex};
+    this->erase_unlocked(path);
+    this->version += 1;
+}
+
+void SearchIndex::clear()
+{
+    std::unique_lock lock{this->mutex};
+
+    this->documents.clear();
+    this->keys.clear();
+    this->masks.clear();
+    this->document_ids.clear();
+    this->postings.clear();
+    this->prefixes.clear();
+    this->dead_documents = 0;
+    this->version += 1;
+}
+
+
+std::vector<std::string> SearchIndex::search(std::string_view query, size_t max_results) const
+{
+    auto normalized_query = SearchIndex::normalize(query);
+    if (normalized_query.empty())
+        return {};
+
+    auto query_mask = SearchIndex::get_mask(normalized_query);
+
+    std::shared_lock lock{this->mutex};
+
+    struct Candidate
+    {
+        uint32_t id;
+        int64_t score;
+    };
+
+    std::vector<Candidate> candidates;
+
+    // documents sharing at least half of the query trigrams, typos included
+    auto trigrams = SearchIndex::get_trigrams(normalized_query);
+    if (trigrams.empty() == false)
+    {
+        std::vector<uint16_t> counts(this->documents.size(), 0);
+        std::vector<uint32_t> matched;
+
+        auto required = std::max<size_t>((trigrams.size() + 1) / 2, 1);
+
+        for (auto trigram: trigrams)
+        {
+            auto posting = this->postings.find(trigram);
+            if (posting == this->postings.end())
+                continue;
+
+            for (auto id: posting->second)
+                if (++counts[id] == required)
+                    matched.push_back(id);
+        }
+
+        for (auto id: matched)
+        {
+            if (this->documents[id].alive == false)
+                continue;
+
+            // subsequence matches always rank above approximate ones
+            auto key = this->get_key(id);
+            auto score = (this->masks[id] & query_mask) == query_mask ? SearchIndex::fuzzy_score(normalized_query, key) : std::nullopt;
+
+            if (score.has_value())
+                candidates.push_back({id, score.value() + 1'000'000});
+            else
+                candidates.push_back({id, (int64_t)counts[id] * 4 - (int64_t)key.size() / 8});
+        }
+    }
+    else
+    {
+        // one or two letters, only documents with a word starting with them
+        auto prefix = normalized_query.size() == 1
+            ? 1u << 24 | (uint8_t)normalized_query[0]
+            : 2u << 24 | (uint32_t)(uint8_t)normalized_query[0] << 8 | (uint8_t)normalized_query[1];
+
+        if (auto posting = this->prefixes.find(prefix); posting != this->prefixes.end())
+        {
+            for (auto id: posting->second)
+            {
+                if (this->documents[id].alive == false)
+                    continue;
+
+                if (auto score = SearchIndex::fuzzy_score(normalized_query, this->get_key(id)); score.has_value())
+                    candidates.push_back({id, score.value() + 1'000'000});
+            }
+        }
+    }
+
+    // abbreviations like "plrwlk" have no trigram in common with their matches
+    if (candidates.empty())
+    {
+        for (uint32_t id = 0; id < this->documents.size(); ++id)
+        {
+            if ((this->masks[id] & query_mask) != query_mask || this->documents[id].alive == false)
+                continue;
+
+            if (auto score = SearchIndex::fuzzy_score(normalized_query, this->get_key(id)); score.has_value())
+                candidates.push_back({id, score.value() + 1'000'000});
+        }
+    }
+
+    auto result_count = std::min(max_results, candidates.size());
+    std::partial_sort(candidates.begin(), candidates.begin() + result_count, candidates.end(), [](const Candidate& a, const Candidate& b)
+    {
+        if (a.score != b.score)
+            return a.score > b.score;
+        return a.id < b.id;
+    });
+
+    std::vector<std::string> output;
+    output.reserve(result_count);
+
+    for (size_t i = 0; i < result_count; ++i)
+        output.push_back(this->documents[candidates[i].id].path);
+
+    return output;
+}
+
+
+size_t SearchIndex::size() const
+{
+    std::shared_lock lock{this->mutex};
+    return this->document_ids.size();
+}
+
+uint64_t SearchIndex::get_version() const
+{
+    return this->version;
+}
+
+
+void SearchIndex::insert_unlocked(const std::string& path, const std::string& key)
+{
+    this->erase_unlocked(path);
+
+    auto id = (uint32_t)this->documents.size();
+    auto normalized_key = SearchIndex::normalize(key);
+
+    // ids only grow, so every posting list stays sorted
+    for (auto trigram: SearchIndex::get_trigrams(normalized_key))
+        this->postings[trigram].push_back(id);
+
+    for (auto prefix: SearchIndex::get_prefixes(normalized_key))
+        this->prefixes[prefix].push_back(id);
+
+    this->documents.push_back(Document{path, (uint32_t)this->keys.size(), (uint32_t)normalized_key.size(), true});
+    this->masks.push_back(SearchIndex::get_mask(normalized_key));
+    this->keys += normalized_key;
+    this->document_ids[path] = id;
+}
+
+void SearchIndex::erase_unlocked(const std::string& path)
+{
+    auto id = this->document_ids.find(path);
+    if (id == this->document_ids.end())
+        return;
+
+    // removed documents are only skipped, postings are rebuilt once they pile up
+    this->documents[id->second].alive = false;
+    this->document_ids.erase(id);
+    this->dead_documents += 1;
+
+    if (this->dead_documents > 1024 && this->dead_documents > this->document_ids.size())
+        this->compact_unlocked();
+}
+
+void SearchIndex::compact_unlocked()
+{
+    auto documents = std::move(this->documents);
+    auto keys = std::move(this->keys);
+
+    this->documents.clear();
+    this->keys.clear();
+    this->masks.clear();
+    this->document_ids.clear();
+    this->postings.clear();
+    this->prefixes.clear();
+    this->dead_documents = 0;
+
+    for (auto& document: documents)
+        if (document.alive)
+            this->insert_unlocked(document.path, keys.substr(document.key_offset, document.key_length));
+}
+
+
+std::string_view SearchIndex::get_key(uint32_t id) const
+{
+    auto& document = this->documents[id];
+    return std::string_view{this->keys}.substr(document.key_offset, document.key_length);
+}
+
+
+std::string SearchIndex::normalize(std::string_view text)
+{
+    std::string output{text};
+
+    for (auto& character: output)
+        character = character == '\\' ? '/' : std::tolower((unsigned char)character);
+
+    return output;
+}
+
+std::vector<uint32_t> SearchIndex::get_trigrams(std::string_view text)
+{
+    std::vector<uint32_t> output;
+
+    for (size_t i = 0; i + 3 <= text.size(); ++i)
+        output.push_back((uint32_t)(uint8_t)text[i] << 16 | (uint32_t)(uint8_t)text[i + 1] << 8 | (uint32_t)(uint8_t)text[i + 2]);
+
+    std::sort(output.begin(), output.end());
+    output.erase(std::unique(output.begin(), output.end()), output.end());
+
+    return output;
+}
+
+std::vector<uint32_t> SearchIndex::get_prefixes(std::string_view text)
+{
+    // the extension is left out, otherwise every ".png" would match "p"
+    auto separator = text.rfind('/');
+    auto extension = text.rfind('.');
+    auto end = extension != text.npos && (separator == text.npos || extension > separator) ? extension : text.size();
+
+    std::vector<uint32_t> output;
+
+    for (size_t i = 0; i < end; ++i)
+    {
+        if (SearchIndex::is_word_start(text, i) == false)
+            continue;
+
+        // the top bits tell one and two letter prefixes apart
+        output.push_back(1u << 24 | (uint8_t)text[i]);
+        if (i + 1 < end)
+            output.push_back(2u << 24 | (uint32_t)(uint8_t)text[i] << 8 | (uint8_t)text[i + 1]);
+    }
+
+    std::sort(output.begin(), output.end());
+    output.erase(std::unique(output.begin(), output.end()), output.end());
+
+    return output;
+}
+
+uint64_t SearchIndex::get_mask(std::string_view text)
+{
+    // one bit per character class, a document can only match if it has every bit of the query
+    uint64_t mask = 0;
+    for (auto character: text)
+        mask |= 1ull << ((uint8_t)character & 63);
+
+    return mask;
+}
+
+std::optional<int64_t> SearchIndex::fuzzy_score(std::string_view query, std::string_view key)
+{
+    auto separator = key.rfind('/');
+    auto name_start = separator == key.npos ? 0 : separator + 1;
+
+    int64_t score = 0;
+    size_t query_position = 0;
+    std::optional<size_t> previous_match;
+
+    for (size_t position = 0; position < key.size() && query_position < query.size(); ++position)
+    {
+        if (key[position] != query[query_position])
+            continue;
+
+        score += 1;
+
+        if (previous_match.has_value() && previous_match.value() + 1 == position)
+            score += 8;
+        else if (previous_match.has_value())
+            score -= std::min<int64_t>(position - previous_match.value() - 1, 8);
+
+        if (SearchIndex::is_word_start(key, position))
+            score += 6;
+        if (position >= name_start)
+            score += 2;
+
+        previous_match = position;
+        query_position += 1;
+    }
+
+    if (query_position != query.size())
+        return std::nullopt;
+
+    // exact substrings of the file name are what people usually type
+    if (auto found = key.find(query, name_start); found != key.npos)
+        score += found == name_start ? 40 : 20;
+
+    return score - (int64_t)key.size() / 8;
+}
+
+bool SearchIndex::is_word_start(std::string_view text, size_t position)
+{
+    if (position == 0)
+        return true;
+
+    auto previous = text[position - 1];
+    return previous == '/' || previous == '_' || previous == '-' || previous == ' ' || previous == '.';
+}
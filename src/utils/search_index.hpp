@@ -0,0 +1,91 @@
+#pragma once
+
+
+// builtin
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+
+
+// trigram index over asset paths with fuzzy ranked matching, changes are
+// applied on the worker pool while the ui thread keeps searching
+class SearchIndex
+{
+    public:
+
+        struct Change
+        {
+            // inserted when "key" is set, erased otherwise
+            std::string path;
+            std::optional<std::string> key;
+        };
+
+    private:
+
+        struct Document
+        {
+            std::string path;
+            uint32_t key_offset;
+            uint32_t key_length;
+            bool alive;
+        };
+
+        // shared by the ui thread and the task applying changes
+        mutable std::shared_mutex mutex;
+        std::vector<Document> documents;
+
+        // keys and character masks are kept contiguous so a full scan stays in cache
+        std::string keys;
+        std::vector<uint64_t> masks;
+        std::unordered_map<std::string, uint32_t> document_ids;
+        std::unordered_map<uint32_t, std::vector<uint32_t>> postings;
+
+        // one and two letter word prefixes, queries too short to have a trigram use these
+        std::unordered_map<uint32_t, std::vector<uint32_t>> prefixes;
+        size_t dead_documents = 0;
+
+        std::mutex pending_mutex;
+        std::vector<Change> pending;
+        bool applying = false;
+
+        std::atomic<uint64_t> version = 0;
+
+    public:
+
+        SearchIndex() = default;
+        SearchIndex(const SearchIndex&) = delete;
+        SearchIndex& operator=(const SearchIndex&) = delete;
+
+        // the index must outlive the changes, hence the shared_ptr
+        static void enqueue(const std::shared_ptr<SearchIndex>& index, std::vector<Change> changes);
+
+        void insert(const std::string& path, const std::string& key);
+        void erase(const std::string& path);
+        void clear();
+
+        std::vector<std::string> search(std::string_view query, size_t max_results) const;
+
+        size_t size() const;
+        uint64_t get_version() const;
+
+    private:
+
+        void insert_unlocked(const std::string& path, const std::string& key);
+        void erase_unlocked(const std::string& path);
+        void compact_unlocked();
+        std::string_view get_key(uint32_t id) const;
+
+        static std::string normalize(std::string_view text);
+        static std::vector<uint32_t> get_trigrams(std::string_view text);
+        static std::vector<uint32_t> get_prefixes(std::string_view text);
+        static uint64_t get_mask(std::string_view text);
+        static bool is_word_start(std::string_view text, size_t position);
+        static std::optional<int64_t> fuzzy_score(std::string_view query, std::string_view key);
+};
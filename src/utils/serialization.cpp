@@ -1,20 +1,112 @@
 #include "serialization.hpp"
 #include "config.hpp"
 #include "node_tree.hpp"
+#include "utils/file_io.hpp"
 #include <chrono>
+#include <stdexcept>
+#include <type_traits>
+
+
+
+// binary project layout, every value as it is in memory (little endian):
+//
+//   magic "LEAFPROJ", u32 version, u64 offset of the track region (version 2)
+//   header       string name, string path, string last access, u64 window width, u64 window height
+//   preferences  i32 video width, i32 video height
+//   animation    f64 preview time, f64 length, u8 loop
+//   root node, its children follow it depth first:
+//     string name, u8 visible, f32x2 position, f32x2 scale, f64 rotation, f32x2 rotation pivot,
+//     u64 layer, u8 has texture, [string texture path]
+//     tracks position, pivot, scale, rotation, each as
+//       u64 offset from the start of the track region, u64 count (version 2)
+//       u64 count, columns (version 1)
+//     u64 child count
+//   track region (version 2), starts and every track in it starts 8 byte aligned:
+//     columns of each track, f64 times[count], values[count] (f32x2, or f64 for rotation), u8 easings[count]
+//
+// opening a version 2 project only reads up to the track region, the columns are
+// read from the mapped file by each KeyFrame when the track is first used
+//
+// strings are a u32 length followed by the bytes
+
+
+static Easing get_easing_from_name(const std::string& name)
+{
+    if (auto easing = easings.find(name); easing != easings.end())
+        return easing->second;
+
+    // names are written from "easings_ref", which spells some of them differently
+    for (auto& [easing, written_name]: easings_ref)
+        if (written_name == name)
+            return easing;
+
+    // only read from a text archive, which throws on bad data anyway and is caught by "load_project"
+    throw std::runtime_error{fmt::format("unknown easing '{}'", name)};
+}
+
+
+// logged here, callers only decide whether to show it
+static std::optional<std::string> warn_error(std::string message)
+{
+    warn(message);
+    return message;
+}
 
-void serialize_project(const std::filesystem::path& path)
+std::optional<std::string> serialize_project(const std::filesystem::path& path, ProjectFormat format)
 {
+    if (format == ProjectFormat::BINARY)
+    {
+        BinaryWriter writer;
+        BinaryProjectFormat::save(writer);
+
+        // the open project may be mapped from "path", replacing the file leaves the
+        // mapping on the old one where writing into it would change tracks not read yet
+        auto temporary_path = path;
+        temporary_path += ".tmp";
+
+        std::error_code error;
+        auto& buffer = writer.get_buffer();
+
+        // a short write on a full disk must not be renamed over the only copy
+        if (try_write_file(temporary_path.string(), buffer.data(), buffer.size()) == false)
+        {
+            std::filesystem::remove(temporary_path, error);
+            return warn_error(fmt::format("could not write '{}'", temporary_path.string()));
+        }
+
+        std::filesystem::rename(temporary_path, path, error);
+
+        // windows doesn't replace a mapped file, read every track so nothing holds it anymore
+        if (error)
+        {
+            KeyFrame::load_all_pending_tracks();
+            std::filesystem::rename(temporary_path, path, error);
+        }
+
+        if (error)
+            return warn_error(fmt::format("could not replace '{}', the project was saved to '{}' instead: {}", path.string(), temporary_path.string(), error.message()));
+
+        return std::nullopt;
+    }
+
     //Update the current root node, and consequently all the node tree
     std::ofstream file{path};
     if (file.bad() || !file.is_open())
-        panic(fmt::format("could not open file '{}'", path.string()));
+        return warn_error(fmt::format("could not open file '{}'", path.string()));
 
-    boost::archive::text_oarchive archive(file);
-    
-	archive << config.current_project;
-    archive << node_tree;
-    archive << anim_data;
+    {
+        boost::archive::text_oarchive archive(file);
+
+        archive << config.current_project;
+        archive << node_tree;
+        archive << anim_data;
+    }
+
+    file.close();
+    if (file.fail())
+        return warn_error(fmt::format("could not write '{}'", path.string()));
+
+    return std::nullopt;
 }
 
 void unload_project()
@@ -25,26 +117,376 @@ void unload_project()
     anim_data = AnimationData{};
 }
 
-void load_project(const std::filesystem::path& path)
+std::optional<std::string> load_project(const std::filesystem::path& path)
 {
-    //Delete the current node tree and load the given one
+    if (std::filesystem::is_regular_file(path) == false)
+        return fmt::format("'{}' does not exist or is not a file", path.string());
+
+    if (get_project_format(path) == ProjectFormat::BINARY)
+    {
+        auto file = MappedFile::open(path);
+        if (file == nullptr)
+            return fmt::format("could not open file '{}'", path.string());
+
+        BinaryReader reader{file->get_data(), file->get_size()};
+        if (auto error = BinaryProjectFormat::load(reader, file); error.has_value())
+            return fmt::format("could not open '{}': {}", path.string(), error.value());
+
+        config.current_project.header.last_access = boost::posix_time::second_clock::local_time();
+        return std::nullopt;
+    }
 
-    if (std::filesystem::exists(path) && !std::filesystem::is_regular_file(path))
-        panic(fmt::format("file '{}' does not exist or is not a file", path.string()));
     std::ifstream file{path};
 
     if (file.bad() || !file.is_open())
-        panic(fmt::format("could not open file '{}'", path.string()));
-    boost::archive::text_iarchive archive(file);
+        return fmt::format("could not open file '{}'", path.string());
+
+    // read aside, boost throws on anything it can't read and the open project must stay
+    ApplicationConfig::Project project;
+    NodeTree* tree = nullptr;
+    AnimationData animation;
+
+    try
+    {
+        boost::archive::text_iarchive archive(file);
+
+        archive >> project;
+        archive >> tree;
+        archive >> animation;
+    }
+    catch (const std::exception& exception)
+    {
+        delete tree;
+        return fmt::format("'{}' is not a leaf project or is corrupted: {}", path.string(), exception.what());
+    }
+
+    delete node_tree;
+    node_tree = tree;
+    config.current_project = std::move(project);
+    anim_data = animation;
 
-	delete node_tree;
-	archive >> config.current_project;
-    archive >> node_tree;
-    archive >> anim_data;
     config.current_project.header.last_access = boost::posix_time::second_clock::local_time();
+    return std::nullopt;
+}
+
+std::optional<ProjectFormat> get_project_format(const std::filesystem::path& path)
+{
+    std::ifstream file{path, std::ios::binary};
+    if (file.bad() || !file.is_open())
+        return std::nullopt;
 
+    char magic[sizeof(BinaryProjectFormat::MAGIC)] = {0};
+    file.read(magic, sizeof(magic));
+
+    if (file.gcount() == sizeof(magic) && std::memcmp(magic, BinaryProjectFormat::MAGIC, sizeof(magic)) == 0)
+        return ProjectFormat::BINARY;
+
+    return ProjectFormat::TEXT;
+}
+
+
+void BinaryProjectFormat::save(BinaryWriter& writer)
+{
+    auto& header = config.current_project.header;
+    auto& preferences = config.current_project.preferences;
+
+    writer.write_bytes(BinaryProjectFormat::MAGIC, sizeof(BinaryProjectFormat::MAGIC));
+    writer.write(BinaryProjectFormat::VERSION);
+
+    // patched once the node tree is written
+    auto region_offset_position = writer.get_size();
+    writer.write<uint64_t>(0);
+
+    writer.write_string(header.name);
+    writer.write_string(header.path.string());
+    writer.write_string(boost::posix_time::to_simple_string(header.last_access));
+    writer.write<uint64_t>(header.window_size.x);
+    writer.write<uint64_t>(header.window_size.y);
+
+    writer.write<int32_t>(preferences.video_resolution[0]);
+    writer.write<int32_t>(preferences.video_resolution[1]);
+
+    writer.write(anim_data.preview_time);
+    writer.write(anim_data.length);
+    writer.write<uint8_t>(anim_data.loop);
+
+    BinaryWriter track_writer;
+    BinaryProjectFormat::write_node(writer, track_writer, *node_tree->root_node);
+
+    writer.align(8);
+    writer.write_at<uint64_t>(region_offset_position, writer.get_size());
+
+    auto& tracks = track_writer.get_buffer();
+    writer.write_bytes(tracks.data(), tracks.size());
 }
 
+std::optional<std::string> BinaryProjectFormat::load(BinaryReader& reader, std::shared_ptr<const MappedFile> file)
+{
+    auto magic = reader.read_bytes(sizeof(BinaryProjectFormat::MAGIC));
+    if (magic == nullptr || std::memcmp(magic, BinaryProjectFormat::MAGIC, sizeof(BinaryProjectFormat::MAGIC)) != 0)
+        return "not a binary leaf project";
+
+    auto version = reader.read<uint32_t>();
+    if (reader.get_error().has_value())
+        return reader.get_error();
+
+    if (version == 0 || version > BinaryProjectFormat::VERSION)
+        return fmt::format("the project is from a newer version of leaf (format {}, this one reads up to {})", version, BinaryProjectFormat::VERSION);
+
+    TrackRegion region{nullptr, 0};
+    if (version >= 2)
+    {
+        region = TrackRegion{std::move(file), reader.read<uint64_t>()};
+
+        if (region.offset > reader.get_offset() + reader.get_remaining())
+            return fmt::format("tracks at {} past the end of the project, it is corrupted", region.offset);
+    }
+
+    ApplicationConfig::Project project;
+    project.header.name = reader.read_string();
+    project.header.path = reader.read_string();
+
+    auto last_access = reader.read_string();
+    if (reader.get_error().has_value())
+        return reader.get_error();
+
+    try
+    {
+        project.header.last_access = boost::posix_time::time_from_string(last_access);
+    }
+    catch (const std::exception&)
+    {
+        return fmt::format("the last access date '{}' is corrupted", last_access);
+    }
+
+    project.header.window_size.x = reader.read<uint64_t>();
+    project.header.window_size.y = reader.read<uint64_t>();
+
+    project.preferences.video_resolution[0] = reader.read<int32_t>();
+    project.preferences.video_resolution[1] = reader.read<int32_t>();
+
+    AnimationData animation;
+    animation.preview_time = reader.read<double>();
+    animation.length = reader.read<double>();
+    animation.loop = reader.read<uint8_t>() != 0;
+
+    // nothing is replaced until the whole tree was read
+    auto root_node = BinaryProjectFormat::read_node(reader, region, nullptr, 0);
+    if (reader.get_error().has_value())
+        return reader.get_error();
+
+    if (region.file != nullptr && reader.get_offset() > region.offset)
+        return "the node tree runs into the tracks, the project is corrupted";
+
+    if (region.file == nullptr && reader.get_remaining() > 0)
+        warn(fmt::format("{} bytes left after the project, they are ignored", reader.get_remaining()));
+
+    delete node_tree;
+    node_tree = new NodeTree{};
+    node_tree->root_node = std::move(root_node);
+
+    config.current_project = std::move(project);
+    anim_data = animation;
+
+    return std::nullopt;
+}
+
+
+void BinaryProjectFormat::write_node(BinaryWriter& writer, BinaryWriter& track_writer, const Node& node)
+{
+    writer.write_string(node.name);
+    writer.write<uint8_t>(node.visible);
+
+    writer.write(node.position);
+    writer.write(node.scale);
+    writer.write(node.rotation);
+    writer.write(node.rotation_pivot);
+
+    writer.write<uint64_t>(node.layer);
+    writer.write<uint8_t>(node.texture_path.has_value());
+    if (node.texture_path.has_value())
+        writer.write_string(node.texture_path.value());
+
+    BinaryProjectFormat::write_keyframe(writer, track_writer, node.keyframe);
+
+    writer.write<uint64_t>(node.children.size());
+    for (auto& child: node.children)
+        BinaryProjectFormat::write_node(writer, track_writer, *child);
+}
+
+std::shared_ptr<Node> BinaryProjectFormat::read_node(BinaryReader& reader, const TrackRegion& region, std::shared_ptr<Node> parent, size_t index)
+{
+    auto node = std::make_shared<Node>(reader.read_string(), index, parent);
+    node->visible = reader.read<uint8_t>() != 0;
+
+    node->position = reader.read<glm::vec2>();
+    node->scale = reader.read<glm::vec2>();
+    node->rotation = reader.read<double>();
+    node->rotation_pivot = reader.read<glm::vec2>();
+
+    node->layer = reader.read<uint64_t>();
+    if (reader.read<uint8_t>() != 0)
+        node->texture_path = reader.read_string();
+
+    BinaryProjectFormat::read_keyframe(reader, region, node->keyframe);
+
+    // a corrupted count stops at the end of the data
+    auto child_count = reader.read<uint64_t>();
+    for (uint64_t i = 0; i < child_count && reader.get_error().has_value() == false; ++i)
+        node->children.push_back(BinaryProjectFormat::read_node(reader, region, node, i));
+
+    return node;
+}
+
+
+void BinaryProjectFormat::write_keyframe(BinaryWriter& writer, BinaryWriter& track_writer, const KeyFrame& keyframe)
+{
+    BinaryProjectFormat::write_track(writer, track_writer, keyframe.position, keyframe.pending[(size_t)Track::POSITION]);
+    BinaryProjectFormat::write_track(writer, track_writer, keyframe.rot_pivot, keyframe.pending[(size_t)Track::PIVOT]);
+    BinaryProjectFormat::write_track(writer, track_writer, keyframe.scale, keyframe.pending[(size_t)Track::SCALE]);
+    BinaryProjectFormat::write_track(writer, track_writer, keyframe.rotation, keyframe.pending[(size_t)Track::ROTATION]);
+}
+
+void BinaryProjectFormat::read_keyframe(BinaryReader& reader, const TrackRegion& region, KeyFrame& keyframe)
+{
+    BinaryProjectFormat::read_track(reader, region, keyframe.position, keyframe.pending[(size_t)Track::POSITION]);
+    BinaryProjectFormat::read_track(reader, region, keyframe.rot_pivot, keyframe.pending[(size_t)Track::PIVOT]);
+    BinaryProjectFormat::read_track(reader, region, keyframe.scale, keyframe.pending[(size_t)Track::SCALE]);
+    BinaryProjectFormat::read_track(reader, region, keyframe.rotation, keyframe.pending[(size_t)Track::ROTATION]);
+
+    keyframe.update_mapped();
+}
+
+
+template <typename Instant>
+static size_t get_instant_size()
+{
+    using Value = std::conditional_t<std::is_same_v<Instant, Vector2Instant>, glm::vec2, double>;
+    return sizeof(double) + sizeof(Value) + sizeof(uint8_t);
+}
+
+template <typename Instant>
+void BinaryProjectFormat::write_track(BinaryWriter& writer, BinaryWriter& track_writer, const std::vector<Instant>& instants, const std::optional<PendingTrack>& pending)
+{
+    track_writer.align(8);
+    writer.write<uint64_t>(track_writer.get_size());
+
+    // a track never read is copied from the file it's still in, without decoding it
+    if (pending.has_value())
+    {
+        writer.write<uint64_t>(pending->count);
+        track_writer.write_bytes(pending->file->get_data() + pending->offset, pending->count * get_instant_size<Instant>());
+        return;
+    }
+
+    writer.write<uint64_t>(instants.size());
+    BinaryProjectFormat::write_track_columns(track_writer, instants);
+}
+
+template <typename Instant>
+void BinaryProjectFormat::read_track(BinaryReader& reader, const TrackRegion& region, std::vector<Instant>& instants, std::optional<PendingTrack>& pending)
+{
+    if (region.file == nullptr)
+    {
+        auto count = reader.read<uint64_t>();
+        BinaryProjectFormat::read_track_columns(reader, count, instants);
+        return;
+    }
+
+    auto offset = reader.read<uint64_t>();
+    auto count = reader.read<uint64_t>();
+
+    if (count == 0)
+        return;
+
+    // checked here so reading the track later can't run past the mapping
+    auto available = region.file->get_size() - region.offset;
+    if (offset > available || count > (available - offset) / get_instant_size<Instant>())
+    {
+        reader.fail(fmt::format("track of {} instants at {} past the end of the project, it is corrupted", count, offset));
+        return;
+    }
+
+    pending = PendingTrack{region.file, region.offset + offset, count};
+}
+
+
+template <typename Instant>
+void BinaryProjectFormat::write_track_columns(BinaryWriter& writer, const std::vector<Instant>& instants)
+{
+    constexpr bool is_vector = std::is_same_v<Instant, Vector2Instant>;
+    using Value = std::conditional_t<is_vector, glm::vec2, double>;
+
+    // gathered into one array per field so each is written with a single copy
+    std::vector<double> times(instants.size());
+    std::vector<Value> values(instants.size());
+    std::vector<uint8_t> easing_column(instants.size());
+
+    for (size_t i = 0; i < instants.size(); ++i)
+    {
+        times[i] = instants[i].time;
+
+        if constexpr (is_vector)
+            values[i] = instants[i].vector;
+        else
+            values[i] = instants[i].value;
+
+        easing_column[i] = get_easing_id(instants[i].easing).value_or(BinaryProjectFormat::NO_EASING);
+    }
+
+    writer.write_array(times.data(), times.size());
+    writer.write_array(values.data(), values.size());
+    writer.write_array(easing_column.data(), easing_column.size());
+}
+
+template <typename Instant>
+void BinaryProjectFormat::read_track_columns(BinaryReader& reader, uint64_t count, std::vector<Instant>& instants)
+{
+    constexpr bool is_vector = std::is_same_v<Instant, Vector2Instant>;
+    using Value = std::conditional_t<is_vector, glm::vec2, double>;
+
+    // checked before allocating, a corrupted count could ask for anything
+    if (count > reader.get_remaining() / get_instant_size<Instant>())
+    {
+        reader.fail(fmt::format("track of {} instants past the end of the project, it is corrupted", count));
+        return;
+    }
+
+    std::vector<double> time_column(count);
+    std::vector<Value> values(count);
+    std::vector<uint8_t> easing_column(count);
+
+    reader.read_array(time_column.data(), count);
+    reader.read_array(values.data(), count);
+    reader.read_array(easing_column.data(), count);
+
+    instants.resize(count);
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto& instant = instants[i];
+        instant.time = time_column[i];
+
+        if constexpr (is_vector)
+            instant.vector = values[i];
+        else
+            instant.value = values[i];
+
+        auto easing = easing_column[i];
+        if (easing != BinaryProjectFormat::NO_EASING && easing >= easing_ids.size())
+        {
+            reader.fail(fmt::format("unknown easing id {}, the project is from a newer version of leaf", easing));
+            easing = BinaryProjectFormat::NO_EASING;
+        }
+
+        instant.easing = easing == BinaryProjectFormat::NO_EASING ? nullptr : easing_ids[easing];
+    }
+}
+
+// KeyFrame reads its pending tracks with these
+template void BinaryProjectFormat::read_track_columns(BinaryReader&, uint64_t, std::vector<Vector2Instant>&);
+template void BinaryProjectFormat::read_track_columns(BinaryReader&, uint64_t, std::vector<DoubleInstant>&);
+
 template<class Archive>
 void boost::serialization::serialize(Archive& archive,NodeTree& node_tree ,const unsigned int)
 {
@@ -75,6 +517,9 @@ void boost::serialization::serialize(Archive& archive,Node& node ,const unsigned
 template<class Archive>
 void boost::serialization::serialize(Archive& archive, KeyFrame& keyframe, const unsigned int)
 {
+    // the text archive has no pending tracks, they're read before saving one
+    keyframe.load_pending_tracks();
+
     archive & keyframe.position;
     archive & keyframe.rot_pivot;
     archive & keyframe.scale;
@@ -98,7 +543,7 @@ void boost::serialization::load(Archive& archive, Vector2Instant& instant, const
 
     std::string easing_name;
     archive >> easing_name;
-    instant.easing = easings.at(easing_name);
+    instant.easing = get_easing_from_name(easing_name);
 }
 
 template<class Archive>
@@ -117,7 +562,7 @@ void boost::serialization::load(Archive& archive, DoubleInstant& instant, const
 
     std::string easing_name;
     archive >> easing_name;
-    instant.easing = easings.at(easing_name);
+    instant.easing = get_easing_from_name(easing_name);
 }
 
 
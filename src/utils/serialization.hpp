@@ -5,7 +5,10 @@
 #include <optional>
 #include <fstream>
 #include <chrono>
+#include <cstdint>
 #include <filesystem>
+#include <memory>
+#include <vector>
 
 // extern
 #include <glm/ext/vector_float2.hpp>
@@ -23,12 +26,79 @@
 #include "animation/keyframe.hpp"
 #include "config.hpp"
 #include "animation/animation.hpp"
+#include "utils/binary_stream.hpp"
+#include "utils/mapped_file.hpp"
 
 
 
-void serialize_project(const std::filesystem::path& path);
+enum class ProjectFormat
+{
+    // boost text archive, what every project was saved as before the binary format,
+    // still read so they open and are converted on their next save
+    TEXT,
+    BINARY
+};
+
+
+// why the project couldn't be saved, the file that was at "path" is kept in that case
+std::optional<std::string> serialize_project(const std::filesystem::path& path, ProjectFormat format = ProjectFormat::BINARY);
 void unload_project();
-void load_project(const std::filesystem::path& path);
+
+// the format is told apart by the first bytes of the file. why it couldn't be
+// opened, the open project is kept in that case
+std::optional<std::string> load_project(const std::filesystem::path& path);
+std::optional<ProjectFormat> get_project_format(const std::filesystem::path& path);
+
+
+// versioned binary layout of a project, described in serialization.cpp. doubles are
+// copied as they are instead of printed, easings are stored as their index in
+// "easing_ids" and every track is written as one array per field. the tracks are
+// kept apart from the node tree, which is all that's read when a project is opened,
+// each track is read from the mapped file the first time it's used
+class BinaryProjectFormat
+{
+    public:
+
+        static inline const char MAGIC[8] = {'L', 'E', 'A', 'F', 'P', 'R', 'O', 'J'};
+        static const uint32_t VERSION = 2;
+
+        // easing of the instants that have none
+        static const uint8_t NO_EASING = 0xff;
+
+        // the current project, node tree and animation data. "file" is what the reader
+        // reads from, the tracks left in it keep it mapped
+        static void save(BinaryWriter& writer);
+        static std::optional<std::string> load(BinaryReader& reader, std::shared_ptr<const MappedFile> file);
+
+        // "count" instants, without the count in front of them
+        template <typename Instant>
+        static void write_track_columns(BinaryWriter& writer, const std::vector<Instant>& instants);
+
+        template <typename Instant>
+        static void read_track_columns(BinaryReader& reader, uint64_t count, std::vector<Instant>& instants);
+
+    private:
+
+        // where the tracks of the nodes being read are, no file for version 1 where
+        // each track follows its node
+        struct TrackRegion
+        {
+            std::shared_ptr<const MappedFile> file;
+            uint64_t offset;
+        };
+
+        static void write_node(BinaryWriter& writer, BinaryWriter& track_writer, const Node& node);
+        static std::shared_ptr<Node> read_node(BinaryReader& reader, const TrackRegion& region, std::shared_ptr<Node> parent, size_t index);
+
+        static void write_keyframe(BinaryWriter& writer, BinaryWriter& track_writer, const KeyFrame& keyframe);
+        static void read_keyframe(BinaryReader& reader, const TrackRegion& region, KeyFrame& keyframe);
+
+        template <typename Instant>
+        static void write_track(BinaryWriter& writer, BinaryWriter& track_writer, const std::vector<Instant>& instants, const std::optional<PendingTrack>& pending);
+
+        template <typename Instant>
+        static void read_track(BinaryReader& reader, const TrackRegion& region, std::vector<Instant>& instants, std::optional<PendingTrack>& pending);
+};
 
 
 namespace boost::serialization {
@@ -0,0 +1,71 @@
+// header
+#include "thread_pool.hpp"
+
+// builtin
+#include <algorithm>
+
+
+
+ThreadPool::ThreadPool(size_t thread_count)
+{
+    for (size_t i = 0; i < std::max<size_t>(thread_count, 1); ++i)
+        this->workers.emplace_back([this](){ this->work(); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock{this->mutex};
+        this->stopping = true;
+    }
+
+    this->condition.notify_all();
+
+    for (auto& worker: this->workers)
+        worker.join();
+}
+
+
+size_t ThreadPool::get_thread_count()
+{
+    return this->workers.size();
+}
+
+size_t ThreadPool::default_thread_count()
+{
+    // leave one core to the ui thread
+    auto hardware_threads = (size_t)std::thread::hardware_concurrency();
+    return std::max<size_t>(hardware_threads, 2) - 1;
+}
+
+
+void ThreadPool::push(std::function<void(void)> task)
+{
+    {
+        std::lock_guard lock{this->mutex};
+        this->tasks.push(std::move(task));
+    }
+
+    this->condition.notify_one();
+}
+
+void ThreadPool::work()
+{
+    while (true)
+    {
+        std::function<void(void)> task;
+
+        {
+            std::unique_lock lock{this->mutex};
+            this->condition.wait(lock, [this](){ return this->stopping || !this->tasks.empty(); });
+
+            if (this->stopping && this->tasks.empty())
+                return;
+
+            task = std::move(this->tasks.front());
+            this->tasks.pop();
+        }
+
+        task();
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+
+// builtin
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+
+// fixed set of worker threads consuming a FIFO of tasks
+class ThreadPool
+{
+    private:
+
+        std::vector<std::thread> workers;
+        std::queue<std::function<void(void)>> tasks;
+        std::mutex mutex;
+        std::condition_variable condition;
+        bool stopping = false;
+
+    public:
+
+        ThreadPool(size_t thread_count = ThreadPool::default_thread_count());
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+        ~ThreadPool();
+
+        template <typename F, typename R = std::invoke_result_t<F>>
+        std::future<R> submit(F&& function)
+        {
+            auto task = std::make_shared<std::packaged_task<R(void)>>(std::forward<F>(function));
+            auto future = task->get_future();
+
+            this->push([task](){ (*task)(); });
+            return future;
+        }
+
+        size_t get_thread_count();
+
+        static size_t default_thread_count();
+
+    private:
+
+        void push(std::function<void(void)> task);
+        void work();
+};
+
+inline ThreadPool thread_pool;